@@ -0,0 +1,59 @@
+#version 460
+
+layout(local_size_x = 64) in;
+
+// One entry per drawn instance, in render queue order
+struct CullObject {
+	vec4 sphere; // World space center (xyz) and radius (w)
+	uint batch;
+	uint objectIndex; // Index in the object buffer
+	uint padding_0;
+	uint padding_1;
+};
+
+// Matches VkDrawIndexedIndirectCommand
+struct DrawCommand {
+	uint indexCount;
+	uint instanceCount;
+	uint firstIndex;
+	int  vertexOffset;
+	uint firstInstance;
+};
+
+layout(std430, binding = 0) readonly buffer CullObjectBuffer {
+	CullObject objects[];
+} cullObjects;
+
+layout(std430, binding = 1) buffer DrawCommandBuffer {
+	DrawCommand commands[];
+} drawCommands;
+
+layout(std430, binding = 2) writeonly buffer DrawCountBuffer {
+	uint counts[];
+} drawCounts;
+
+layout(std430, binding = 3) writeonly buffer InstanceBuffer {
+	uint ids[];
+} instanceBuffer;
+
+layout(binding = 4) uniform CullingUniformBuffer {
+	vec4 frustumPlanes[6];
+	uint objectCount;
+} culling;
+
+void main() {
+	uint instanceId = gl_GlobalInvocationID.x;
+	if (instanceId >= culling.objectCount)
+		return;
+
+	CullObject object = cullObjects.objects[instanceId];
+	for (int i = 0; i < 6; ++i) {
+		if (dot(culling.frustumPlanes[i].xyz, object.sphere.xyz) + culling.frustumPlanes[i].w < -object.sphere.w)
+			return;
+	}
+
+	// Visible instances of a batch are compacted from the batch's firstInstance
+	uint slot = atomicAdd(drawCommands.commands[object.batch].instanceCount, 1);
+	instanceBuffer.ids[drawCommands.commands[object.batch].firstInstance + slot] = object.objectIndex;
+	drawCounts.counts[object.batch] = 1;
+}
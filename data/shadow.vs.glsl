@@ -0,0 +1,52 @@
+#version 460
+
+// Depth only pass of one shadow cascade
+
+// IN
+layout(location = 0) in vec4 pos;
+
+// UNIFORM BUFFER
+layout(binding = 2) uniform GlobalCameraUniformBuffer {
+    mat4 worldProjection;
+    mat4 viewMatrix;
+	vec3 cameraLocation;
+	float interpolationAlpha;
+} ubo;
+
+layout(binding = 3) uniform ShadowUniformBuffer {
+	mat4 cascadeViewProjection[4];
+	vec4 cascadeSplits;
+	vec4 sunDirection;
+	uint cascadeCount;
+} shadow;
+
+struct ObjectData{
+	mat4 model;
+	mat4 previousModel; // Model at the start of the last simulation step
+	vec4 positionScale; // Dequantization of the mesh positions
+	vec4 positionOffset;
+};
+
+layout(std140, binding = 0) readonly buffer ObjectBuffer{
+	ObjectData objects[];
+} objectBuffer;
+
+// Instance index to object index, each cascade has its own range
+layout(std430, binding = 1) readonly buffer ShadowInstanceBuffer{
+	uint ids[];
+} instanceBuffer;
+
+layout(push_constant) uniform CascadeConstant {
+	uint cascade;
+} push;
+
+out gl_PerVertex {
+    vec4 gl_Position;
+};
+
+void main() {
+	ObjectData object = objectBuffer.objects[instanceBuffer.ids[gl_InstanceIndex]];
+	mat4 model = object.previousModel + (object.model - object.previousModel) * ubo.interpolationAlpha;
+	vec3 localPosition = pos.xyz * object.positionScale.xyz + object.positionOffset.xyz;
+	gl_Position = shadow.cascadeViewProjection[push.cascade] * model * vec4(localPosition, 1.0);
+}
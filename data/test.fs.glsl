@@ -3,6 +3,7 @@
 
 layout (location = 8) in vec3 position;
 layout (location = 9) in vec3 normal;
+layout (location = 10) in vec3 worldPosition;
 layout (location = 0) in vec2 texCoords;
 
 layout(location = 0) out vec4 outColor;
@@ -12,19 +13,40 @@ layout(binding = 5) uniform GlobalCameraUniformBuffer {
     mat4 worldProjection;
     mat4 viewMatrix;
 	vec3 cameraLocation;
+	float interpolationAlpha;
 } ubo;
 
+layout(binding = 10) uniform ShadowUniformBuffer {
+	mat4 cascadeViewProjection[4];
+	vec4 cascadeSplits; // View depth where each cascade ends
+	vec4 sunDirection;
+	uint cascadeCount;
+} shadow;
+
 // SAMPLERS
 //layout (binding = 6) uniform sampler2D image;
-//layout (binding = 7) uniform sampler2D shadowMap;
-
+layout (binding = 7) uniform sampler2DArrayShadow shadowMap;
+
+// 1 when lit. Fragments beyond the last cascade are lit.
+float sample_shadow() {
+	float viewDepth = -(ubo.viewMatrix * vec4(worldPosition, 1.0)).z;
+	uint cascade = 0;
+	while (cascade < shadow.cascadeCount && viewDepth > shadow.cascadeSplits[cascade])
+		cascade++;
+	if (cascade >= shadow.cascadeCount)
+		return 1.0;
+
+	vec4 lightPosition = shadow.cascadeViewProjection[cascade] * vec4(worldPosition, 1.0);
+	vec2 shadowUv = lightPosition.xy * 0.5 + 0.5;
+	return texture(shadowMap, vec4(shadowUv, float(cascade), lightPosition.z - 0.0005));
+}
 
 void main() {
-	vec3 sun = normalize(vec3(-1.0, 1.0, 1.0));
+	vec3 sun = normalize(shadow.sunDirection.xyz);
 
 	float ambiant = 0.1;
 
-	float light_power = max(0, dot(sun, normal)) * (1 - ambiant) + ambiant;
+	float light_power = max(0, dot(sun, normalize(normal))) * sample_shadow() * (1 - ambiant) + ambiant;
 
 	outColor = vec4(light_power, light_power, light_power, 0); //vec4(mod(position.x / 20, 1), mod(position.y / 20, 1), mod(position.z / 20, 1), 0);//texture(colorMap, texCoords);	
 }
\ No newline at end of file
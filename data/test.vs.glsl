@@ -1,45 +1,60 @@
 #version 460
 
 // IN
-layout(location = 0) in vec3 pos;
+// Default VertexLayout : positions relative to the mesh bounds, octahedral normals
+layout(location = 0) in vec4 pos;
 layout(location = 1) in vec2 uv;
-layout(location = 2) in vec4 col;
-layout(location = 3) in vec3 norm;
-layout(location = 4) in vec3 tang;
-layout(location = 5) in vec3 bitang;
+layout(location = 3) in vec2 norm;
 
 layout (location = 8) out vec3 position;
 layout (location = 9) out vec3 normal;
+layout (location = 10) out vec3 worldPosition;
 
 // UNIFORM BUFFER
 layout(binding = 9) uniform GlobalCameraUniformBuffer {
     mat4 worldProjection;
     mat4 viewMatrix;
 	vec3 cameraLocation;
+	float interpolationAlpha;
 } ubo;
 
-// SAMPLERS
-//layout (binding = 6) uniform sampler2D image;
-//layout (binding = 7) uniform sampler2D shadowMap;
-
-
 struct ObjectData{
 	mat4 model;
+	mat4 previousModel; // Model at the start of the last simulation step
+	vec4 positionScale; // Dequantization of the mesh positions
+	vec4 positionOffset;
 };
 
 layout(std140, binding = 0) readonly buffer ObjectBuffer{
 	ObjectData objects[];
 } objectBuffer;
 
+// Instance index to object index (filled by the gpu culling pass or by the cpu)
+layout(std430, binding = 1) readonly buffer InstanceBuffer{
+	uint ids[];
+} instanceBuffer;
+
 // OUT
 layout (location = 0) out vec2 texCoords;
 
+// The depth pre-pass and the color pass must compute bit identical depths for the equal depth test
 out gl_PerVertex {
-    vec4 gl_Position;
+    invariant vec4 gl_Position;
 };
 
+vec3 decodeOctahedral(vec2 e) {
+	vec3 v = vec3(e, 1.0 - abs(e.x) - abs(e.y));
+	if (v.z < 0.0)
+		v.xy = (1.0 - abs(v.yx)) * vec2(v.x >= 0.0 ? 1.0 : -1.0, v.y >= 0.0 ? 1.0 : -1.0);
+	return normalize(v);
+}
+
 void main() {
-	position = pos;
-	normal = norm;
-	gl_Position = ubo.worldProjection * ubo.viewMatrix * objectBuffer.objects[gl_BaseInstance].model * vec4(pos.xyz, 1.0);
+	ObjectData object = objectBuffer.objects[instanceBuffer.ids[gl_InstanceIndex]];
+	position = pos.xyz * object.positionScale.xyz + object.positionOffset.xyz;
+	texCoords = uv;
+	mat4 model = object.previousModel + (object.model - object.previousModel) * ubo.interpolationAlpha;
+	normal = normalize(mat3(model) * decodeOctahedral(norm));
+	worldPosition = (model * vec4(position, 1.0)).xyz;
+	gl_Position = ubo.worldProjection * ubo.viewMatrix * vec4(worldPosition, 1.0);
 }
\ No newline at end of file
@@ -31,6 +31,33 @@ namespace config {
 	inline const uint32_t max_descriptor_per_pool = 64;
 	inline const uint32_t max_descriptor_per_type = 128;
 
+	/**
+	 * Simulation
+	 */
+
+	inline const double simulation_rate = 120.0;
+	inline const uint32_t max_simulation_steps_per_frame = 8;
+
+	/**
+	 * Occlusion culling
+	 */
+
+	inline const uint32_t occlusion_buffer_width = 256;
+	inline const uint32_t occlusion_buffer_height = 128;
+	inline const uint32_t max_occluders = 32;
+	inline const float min_occluder_screen_size = 0.1f; // Bounding radius over distance
+
+	/**
+	 * Shadows
+	 */
+
+	inline const uint32_t shadow_cascade_count = 4; // At most 4
+	inline const uint32_t shadow_map_resolution = 2048;
+	inline const float shadow_distance = 500.f; // View depth where the last cascade ends
+	inline const float shadow_split_lambda = 0.75f; // Blend between uniform (0) and logarithmic (1) cascade splits
+	inline const float shadow_caster_distance = 1000.f; // Casters further toward the sun are clipped
+	inline const float shadow_update_margin = 0.1f; // Cascades are fitted this much larger, the camera can move by this ratio of their radius before a refit
+
 	/**
 	 * Engine
 	 */
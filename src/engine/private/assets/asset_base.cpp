@@ -2,33 +2,255 @@
 
 #include "assets/asset_base.h"
 
+#include "assets/asset_uploader.h"
+#include "assets/geometry_pool.h"
+#include "engine_interface.h"
+#include "jobSystem/job_system.h"
+#include "rendering/window.h"
+
+AssetManager::AssetManager(IEngineInterface* in_engine_interface) : engine_interface(in_engine_interface)
+{
+    uploader      = std::make_unique<AssetUploader>(engine_interface->get_gfx_context());
+    geometry_pool = std::make_unique<GeometryPool>(engine_interface->get_gfx_context(), uploader.get(), engine_interface->get_window());
+}
+
 AssetManager::~AssetManager()
 {
-    std::lock_guard<std::mutex> lock(register_lock);
-    for (auto& item : assets) delete item.second;
+    // Loading jobs still construct assets and request uploads
+    std::vector<std::shared_ptr<job_system::IJobTask>> jobs;
+    {
+        std::lock_guard<std::mutex> lock(loading_lock);
+        for (const auto& loading : loading_assets)
+            jobs.emplace_back(loading->job);
+    }
+    for (const auto& job : jobs)
+        job->wait();
+
+    // The device is idle : the unloaded assets can be destroyed now
+    b_shutting_down = true;
+    engine_interface->get_window()->flush_deferred_destructions();
+
+    uploader = nullptr;
+
+    // Newest first : an asset is destroyed before the assets it was created from
+    std::vector<AssetBase*> assets;
+    registry.for_each([&](const AssetSlot* slot) {
+        if (AssetBase* asset = slot->asset.load())
+            assets.emplace_back(asset);
+    });
+    for (auto it = assets.rbegin(); it != assets.rend(); ++it)
+        delete *it;
+
+    {
+        std::lock_guard<std::mutex> lock(loading_lock);
+        for (const auto& loading : loading_assets) delete loading->asset.load();
+    }
+
+    // After the meshes, which free their range on destruction
+    geometry_pool = nullptr;
+}
+
+void AssetBase::release_ref()
+{
+    if (ref_count.fetch_sub(1, std::memory_order_acq_rel) != 1)
+        return;
+    // Null while the manager is destroyed
+    if (AssetManager* asset_manager = engine_interface->get_asset_manager())
+        asset_manager->release(this);
+}
+
+void AssetManager::release(AssetBase* asset)
+{
+    std::lock_guard<std::mutex> lock(memory_lock);
+
+    // Referenced again meanwhile, already unreferenced, or still loading
+    if (b_shutting_down || asset->ref_count.load(std::memory_order_acquire) != 0 || asset->b_unreferenced || !asset->b_resident)
+        return;
+
+    asset->b_unreferenced = true;
+    unreferenced.emplace_back(asset);
+    get_class_stats(typeid(*asset)).unreferenced_count++;
+}
+
+void AssetManager::evict_unreferenced()
+{
+    if (unreferenced.empty())
+        return;
+
+    // Assets referenced again stay resident
+    std::erase_if(unreferenced, [this](AssetBase* asset) {
+        if (asset->ref_count.load(std::memory_order_acquire) == 0)
+            return false;
+        asset->b_unreferenced = false;
+        get_class_stats(typeid(*asset)).unreferenced_count--;
+        return true;
+    });
+
+    // Least recently used first
+    std::sort(unreferenced.begin(), unreferenced.end(), [](const AssetBase* a, const AssetBase* b) { return a->get_last_used_frame() < b->get_last_used_frame(); });
+
+    // Classes without a budget keep their unreferenced assets cached
+    std::erase_if(unreferenced, [this](AssetBase* asset) {
+        const AssetClassStats& stats = get_class_stats(typeid(*asset));
+        if (!stats.b_budgeted || (stats.cpu_bytes <= stats.budget.cpu_bytes && stats.gpu_bytes <= stats.budget.gpu_bytes))
+            return false;
+        unload(asset);
+        return true;
+    });
+}
+
+void AssetManager::unload(AssetBase* asset)
+{
+    AssetClassStats& stats = get_class_stats(typeid(*asset));
+    stats.asset_count--;
+    stats.unreferenced_count--;
+    stats.cpu_bytes -= asset->tracked_cpu_bytes;
+    stats.gpu_bytes -= asset->tracked_gpu_bytes;
+    stats.evicted_count++;
+
+    asset->b_resident     = false;
+    asset->b_unreferenced = false;
+    if (AssetSlot* slot = registry.find(asset->get_id()); slot && slot->asset.load(std::memory_order_acquire) == asset)
+        AssetRegistry::release(slot);
+    engine_interface->get_window()->defer_destruction([this, asset] { destroy_unloaded(asset); });
+}
+
+void AssetManager::destroy_unloaded(AssetBase* asset)
+{
+    // A pointer that was resolving when the asset was unloaded may still hold it
+    if (asset->ref_count.load(std::memory_order_acquire) != 0 && !b_shutting_down)
+    {
+        engine_interface->get_window()->defer_destruction([this, asset] { destroy_unloaded(asset); });
+        return;
+    }
+    delete asset;
+}
+
+void AssetManager::track(AssetBase* asset)
+{
+    std::lock_guard<std::mutex> lock(memory_lock);
+    asset->tracked_cpu_bytes = asset->get_cpu_bytes();
+    asset->tracked_gpu_bytes = asset->get_gpu_bytes();
+
+    AssetClassStats& stats = get_class_stats(typeid(*asset));
+    stats.asset_count++;
+    stats.cpu_bytes += asset->tracked_cpu_bytes;
+    stats.gpu_bytes += asset->tracked_gpu_bytes;
+}
+
+AssetClassStats& AssetManager::get_class_stats(const std::type_index& asset_class)
+{
+    auto [it, b_inserted] = class_stats.try_emplace(asset_class);
+    if (b_inserted)
+        it->second.name = asset_class.name();
+    return it->second;
+}
+
+std::vector<AssetClassStats> AssetManager::get_memory_stats()
+{
+    std::lock_guard<std::mutex>  lock(memory_lock);
+    std::vector<AssetClassStats> stats;
+    stats.reserve(class_stats.size());
+    for (const auto& item : class_stats)
+        stats.emplace_back(item.second);
+    std::sort(stats.begin(), stats.end(), [](const AssetClassStats& a, const AssetClassStats& b) { return a.gpu_bytes + a.cpu_bytes > b.gpu_bytes + b.cpu_bytes; });
+    return stats;
 }
 
-AssetBase* AssetManager::find(const AssetId& id)
+void AssetManager::update()
 {
-    std::lock_guard<std::mutex> lock(register_lock);
-    auto                        asset = assets.find(id);
-    if (asset == assets.end()) return nullptr;
-    return asset->second;
+    frame.fetch_add(1, std::memory_order_relaxed);
+    uploader->flush();
+
+    {
+        std::lock_guard<std::mutex> lock(loading_lock);
+        for (size_t i = 0; i < loading_assets.size();)
+        {
+            AssetBase* asset = loading_assets[i]->asset.load(std::memory_order_acquire);
+            if (!asset || !uploader->is_complete(asset->upload_ticket))
+            {
+                ++i;
+                continue;
+            }
+            track(asset);
+            asset->b_resident = true;
+            AssetRegistry::publish(loading_assets[i]->slot, asset);
+            loading_assets[i] = std::move(loading_assets.back());
+            loading_assets.pop_back();
+        }
+    }
+
+    std::lock_guard<std::mutex> lock(memory_lock);
+    evict_unreferenced();
+}
+
+AssetSlot* AssetManager::reserve(const AssetId& asset_id)
+{
+    if (!asset_id.register_name())
+    {
+        LOG_ERROR("Cannot create asset %s : its id collides with another asset name", asset_id.to_string().c_str());
+        return nullptr;
+    }
+
+    AssetSlot* slot = registry.reserve(asset_id);
+    if (!slot)
+        LOG_ERROR("Cannot create two asset with the same id : %s", asset_id.to_string().c_str());
+    return slot;
+}
+
+void AssetManager::make_resident(AssetSlot* slot, AssetBase* asset)
+{
+    uploader->wait(asset->upload_ticket);
+    track(asset);
+    asset->b_resident = true;
+    AssetRegistry::publish(slot, asset);
+}
+
+bool AssetManager::load_async(const AssetId& asset_id, std::function<AssetBase*()> load)
+{
+    AssetSlot* slot = reserve(asset_id);
+    if (!slot)
+        return false;
+
+    // Only removed by update() once the job set its asset : the entry outlives the job
+    auto          entry   = std::make_unique<LoadingAsset>();
+    LoadingAsset* loading = entry.get();
+    loading->slot         = slot;
+
+    std::lock_guard<std::mutex> lock(loading_lock);
+    loading->job = job_system::new_job([loading, load = std::move(load)] { loading->asset.store(load(), std::memory_order_release); }, true);
+    loading_assets.emplace_back(std::move(entry));
+    return true;
 }
 
 std::unordered_map<AssetId, AssetBase*> AssetManager::get_assets()
 {
-    std::lock_guard<std::mutex> lock(register_lock);
+    std::unordered_map<AssetId, AssetBase*> assets;
+    registry.for_each([&](const AssetSlot* slot) {
+        if (AssetBase* asset = slot->asset.load(std::memory_order_acquire))
+            assets.emplace(AssetId(slot->id), asset);
+    });
     return assets;
 }
 
+std::vector<AssetId> AssetManager::get_loading_assets()
+{
+    std::lock_guard<std::mutex> lock(loading_lock);
+    std::vector<AssetId>        ids;
+    ids.reserve(loading_assets.size());
+    for (const auto& loading : loading_assets)
+        ids.emplace_back(AssetId(loading->slot->id));
+    return ids;
+}
+
 AssetId AssetManager::find_valid_asset_id(const std::string& asset_name)
 {
-    if (!find(asset_name))
+    // Probed by hash : the candidate names are not copied
+    if (!exists(AssetId::hash_name(asset_name)))
         return asset_name;
 
     int asset_index = 1;
-    while (find(asset_name + "_" + std::to_string(asset_index)))
+    while (exists(AssetId::hash_name(asset_name + "_" + std::to_string(asset_index))))
     {
         asset_index++;
     }    
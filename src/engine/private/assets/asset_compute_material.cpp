@@ -0,0 +1,204 @@
+
+
+#include "assets/asset_compute_material.h"
+
+#include "assets/asset_shader.h"
+#include "assets/asset_uniform_buffer.h"
+#include "engine_interface.h"
+
+ComputeMaterial::ComputeMaterial(const ShaderStageData& in_compute_stage) : compute_stage(in_compute_stage)
+{
+    if (!compute_stage.shader)
+        return;
+    create_descriptor_sets(make_layout_bindings());
+    create_pipeline();
+}
+
+ComputeMaterial::~ComputeMaterial()
+{
+    destroy_resources();
+}
+
+void ComputeMaterial::destroy_resources()
+{
+    if (compute_pipeline != VK_NULL_HANDLE)
+        vkDestroyPipeline(get_engine_interface()->get_gfx_context()->logical_device, compute_pipeline, vulkan_common::allocation_callback);
+    if (pipeline_layout != VK_NULL_HANDLE)
+        vkDestroyPipelineLayout(get_engine_interface()->get_gfx_context()->logical_device, pipeline_layout, vulkan_common::allocation_callback);
+    if (descriptor_set_layout != VK_NULL_HANDLE)
+        vkDestroyDescriptorSetLayout(get_engine_interface()->get_gfx_context()->logical_device, descriptor_set_layout, vulkan_common::allocation_callback);
+    compute_pipeline      = VK_NULL_HANDLE;
+    pipeline_layout       = VK_NULL_HANDLE;
+    descriptor_set_layout = VK_NULL_HANDLE;
+}
+
+std::vector<VkDescriptorSetLayoutBinding> ComputeMaterial::make_layout_bindings()
+{
+    uniform_bindings.clear();
+    ssbo_bindings.clear();
+
+    std::vector<VkDescriptorSetLayoutBinding> result_bindings;
+
+    std::unordered_map<std::string, ShaderProperty> uniform_buffers;
+    std::unordered_map<std::string, ShaderProperty> storage_buffers;
+
+    for (const auto& param : compute_stage.shader->get_uniform_buffers())
+    {
+        uniform_buffers[param.property_name] = param;
+    }
+
+    for (const auto& uniform : compute_stage.uniform_buffer)
+    {
+        if (const auto found_buffer = uniform_buffers.find(uniform->get_name()); found_buffer != uniform_buffers.end())
+        {
+            result_bindings.emplace_back(VkDescriptorSetLayoutBinding{
+                .binding            = found_buffer->second.location,
+                .descriptorType     = VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER,
+                .descriptorCount    = 1,
+                .stageFlags         = VK_SHADER_STAGE_COMPUTE_BIT,
+                .pImmutableSamplers = nullptr,
+            });
+            uniform_bindings[found_buffer->second.property_name] = found_buffer->second.location;
+        }
+        else
+        {
+            LOG_ERROR("specified uniform buffer named %s that doesn't exist in compute stage", uniform->get_name().c_str());
+        }
+    }
+
+    for (const auto& param : compute_stage.shader->get_storage_buffers())
+    {
+        storage_buffers[param.property_name] = param;
+    }
+
+    for (const auto& ssbo : compute_stage.storage_buffers)
+    {
+        if (const auto found_buffer = storage_buffers.find(ssbo->get_name()); found_buffer != storage_buffers.end())
+        {
+            result_bindings.emplace_back(VkDescriptorSetLayoutBinding{
+                .binding            = found_buffer->second.location,
+                .descriptorType     = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER,
+                .descriptorCount    = 1,
+                .stageFlags         = VK_SHADER_STAGE_COMPUTE_BIT,
+                .pImmutableSamplers = nullptr,
+            });
+            ssbo_bindings[found_buffer->second.property_name] = found_buffer->second.location;
+        }
+        else
+        {
+            LOG_ERROR("specified storage buffer named %s that doesn't exist in compute stage", ssbo->get_name().c_str());
+        }
+    }
+
+    return result_bindings;
+}
+
+void ComputeMaterial::create_pipeline()
+{
+    VK_CHECK(descriptor_set_layout, "Descriptor set layout should be initialized before compute pipeline");
+
+    VkPipelineShaderStageCreateInfo compute_stage_info{};
+    compute_stage_info.sType  = VK_STRUCTURE_TYPE_PIPELINE_SHADER_STAGE_CREATE_INFO;
+    compute_stage_info.stage  = VK_SHADER_STAGE_COMPUTE_BIT;
+    compute_stage_info.module = compute_stage.shader->get_shader_module();
+    compute_stage_info.pName  = "main";
+
+    VkPipelineLayoutCreateInfo pipeline_layout_info{};
+    pipeline_layout_info.sType                  = VK_STRUCTURE_TYPE_PIPELINE_LAYOUT_CREATE_INFO;
+    pipeline_layout_info.setLayoutCount         = 1;
+    pipeline_layout_info.pSetLayouts            = &descriptor_set_layout;
+    pipeline_layout_info.pushConstantRangeCount = 0;
+    pipeline_layout_info.pPushConstantRanges    = nullptr;
+    VK_ENSURE(vkCreatePipelineLayout(get_engine_interface()->get_gfx_context()->logical_device, &pipeline_layout_info, vulkan_common::allocation_callback, &pipeline_layout), "Failed to create compute pipeline layout");
+
+    VkComputePipelineCreateInfo pipeline_info{};
+    pipeline_info.sType              = VK_STRUCTURE_TYPE_COMPUTE_PIPELINE_CREATE_INFO;
+    pipeline_info.stage              = compute_stage_info;
+    pipeline_info.layout             = pipeline_layout;
+    pipeline_info.basePipelineHandle = VK_NULL_HANDLE;
+    pipeline_info.basePipelineIndex  = -1;
+    VK_ENSURE(vkCreateComputePipelines(get_engine_interface()->get_gfx_context()->logical_device, VK_NULL_HANDLE, 1, &pipeline_info, vulkan_common::allocation_callback, &compute_pipeline),
+              "Failed to create compute pipeline");
+}
+
+void ComputeMaterial::create_descriptor_sets(const std::vector<VkDescriptorSetLayoutBinding>& layout_bindings)
+{
+    /** Create descriptor set layout */
+    VkDescriptorSetLayoutCreateInfo layout_info{};
+    layout_info.sType        = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_LAYOUT_CREATE_INFO;
+    layout_info.bindingCount = static_cast<uint32_t>(layout_bindings.size());
+    layout_info.pBindings    = layout_bindings.data();
+    VK_ENSURE(vkCreateDescriptorSetLayout(get_engine_interface()->get_gfx_context()->logical_device, &layout_info, vulkan_common::allocation_callback, &descriptor_set_layout),
+              "Failed to create compute descriptor set layout");
+
+    /** Allocate descriptor set */
+    std::vector<VkDescriptorSetLayout> layouts(get_engine_interface()->get_window()->get_image_count(), descriptor_set_layout);
+    descriptor_sets.resize(get_engine_interface()->get_window()->get_image_count());
+    VkDescriptorSetAllocateInfo alloc_info{};
+    alloc_info.sType              = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_ALLOCATE_INFO;
+    alloc_info.descriptorSetCount = get_engine_interface()->get_window()->get_image_count();
+    alloc_info.pSetLayouts        = layouts.data();
+    alloc_info.descriptorPool     = VK_NULL_HANDLE;
+    get_engine_interface()->get_window()->get_descriptor_pool()->alloc_memory(alloc_info);
+    VK_ENSURE(vkAllocateDescriptorSets(get_engine_interface()->get_gfx_context()->logical_device, &alloc_info, descriptor_sets.data()), "Failed to allocate compute descriptor sets");
+}
+
+void ComputeMaterial::update_descriptor_sets(size_t image_index)
+{
+    std::vector<VkWriteDescriptorSet> write_descriptor_sets = {};
+
+    for (const auto& uniform : compute_stage.uniform_buffer)
+    {
+        if (auto binding = uniform_bindings.find(uniform->get_name()); binding != uniform_bindings.end())
+        {
+            write_descriptor_sets.emplace_back(VkWriteDescriptorSet{
+                .sType            = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET,
+                .pNext            = nullptr,
+                .dstSet           = descriptor_sets[image_index],
+                .dstBinding       = binding->second,
+                .dstArrayElement  = 0,
+                .descriptorCount  = 1,
+                .descriptorType   = VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER,
+                .pImageInfo       = nullptr,
+                .pBufferInfo      = uniform->get_descriptor_buffer_info(static_cast<uint32_t>(image_index)),
+                .pTexelBufferView = nullptr,
+            });
+        }
+        else
+        {
+            LOG_ERROR("failed to find binding for uniform buffer");
+        }
+    }
+
+    for (const auto& ssbo : compute_stage.storage_buffers)
+    {
+        if (auto binding = ssbo_bindings.find(ssbo->get_name()); binding != ssbo_bindings.end())
+        {
+            write_descriptor_sets.emplace_back(VkWriteDescriptorSet{
+                .sType            = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET,
+                .pNext            = nullptr,
+                .dstSet           = descriptor_sets[image_index],
+                .dstBinding       = binding->second,
+                .dstArrayElement  = 0,
+                .descriptorCount  = 1,
+                .descriptorType   = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER,
+                .pImageInfo       = nullptr,
+                .pBufferInfo      = ssbo->get_descriptor_buffer_info(static_cast<uint32_t>(image_index)),
+                .pTexelBufferView = nullptr,
+            });
+        }
+        else
+        {
+            LOG_ERROR("failed to find binding for ssbo buffer");
+        }
+    }
+
+    vkUpdateDescriptorSets(get_engine_interface()->get_gfx_context()->logical_device, static_cast<uint32_t>(write_descriptor_sets.size()), write_descriptor_sets.data(), 0, nullptr);
+}
+
+void ComputeMaterial::dispatch(VkCommandBuffer command_buffer, uint32_t image_index, uint32_t group_count_x, uint32_t group_count_y, uint32_t group_count_z) const
+{
+    vkCmdBindPipeline(command_buffer, VK_PIPELINE_BIND_POINT_COMPUTE, compute_pipeline);
+    vkCmdBindDescriptorSets(command_buffer, VK_PIPELINE_BIND_POINT_COMPUTE, pipeline_layout, 0, 1, &descriptor_sets[image_index], 0, nullptr);
+    vkCmdDispatch(command_buffer, group_count_x, group_count_y, group_count_z);
+}
@@ -1,44 +1,70 @@
 
 #include "assets/asset_id.h"
 
-#include "jobSystem/job.h"
+#include <cpputils/logger.hpp>
+#include <mutex>
+#include <unordered_map>
+#include <unordered_set>
 
-std::size_t std::hash<AssetId>::operator()(const AssetId& other) const noexcept
+namespace
+{
+// Never released : the registered names are views on literals or on the interned names
+struct NameTable
 {
-    using std::hash;
-    using std::size_t;
-    using std::string;
+    std::mutex                              lock;
+    std::unordered_set<std::string>         interned;
+    std::unordered_map<size_t, std::string_view> registered;
+};
 
-    return hash<size_t>()(other.id);
+NameTable& get_name_table()
+{
+    static NameTable table;
+    return table;
 }
+} // namespace
 
-AssetId::AssetId(const size_t id_val) : id(id_val) {}
-
-AssetId::AssetId(const AssetId& other) : AssetId(other.id)
+std::size_t std::hash<AssetId>::operator()(const AssetId& other) const noexcept
 {
-#ifdef _DEBUG
-    asset_name = other.asset_name;
-#endif
+    return other.id;
 }
 
-AssetId::AssetId(const AssetId&& other) noexcept : AssetId(other.id)
+AssetId::AssetId(std::string in_name) : id(hash_name(in_name)), runtime_name(new RuntimeName{.value = std::move(in_name)})
 {
-#ifdef _DEBUG
-    asset_name = other.asset_name;
-#endif
 }
-AssetId::AssetId(const std::string& name) : AssetId(std::hash<std::string>{}(name))
+
+bool AssetId::register_name() const
 {
-#ifdef _DEBUG
-    asset_name = name;
-#endif
+    if (name.empty() && !runtime_name)
+        return true;
+
+    NameTable&                  table = get_name_table();
+    std::lock_guard<std::mutex> lock(table.lock);
+
+    const auto registered = table.registered.find(id);
+    if (registered != table.registered.end())
+    {
+        const std::string_view own_name = runtime_name ? std::string_view(runtime_name->value) : name;
+        if (registered->second == own_name)
+            return true;
+        LOG_ERROR("asset id collision : '%s' and '%s' have the same id %zu", std::string(registered->second).c_str(), std::string(own_name).c_str(), id);
+        return false;
+    }
+
+    // Only the names of created assets are interned
+    table.registered.emplace(id, runtime_name ? std::string_view(*table.interned.emplace(runtime_name->value).first) : name);
+    return true;
 }
 
 std::string AssetId::to_string() const
 {
-#ifdef _DEBUG
-    return asset_name;
-#else
+    if (!name.empty())
+        return std::string(name);
+    if (runtime_name)
+        return runtime_name->value;
+
+    NameTable&                  table = get_name_table();
+    std::lock_guard<std::mutex> lock(table.lock);
+    if (const auto registered = table.registered.find(id); registered != table.registered.end())
+        return std::string(registered->second);
     return std::to_string(id);
-#endif
 }
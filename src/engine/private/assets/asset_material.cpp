@@ -8,6 +8,10 @@
 #include "engine_interface.h"
 #include "magic_enum/magic_enum.h"
 
+#include <atomic>
+
+static std::atomic_uint32_t material_render_id_counter = 0;
+
 /*
 VkWriteDescriptorSet StructShaderParameter::generate_write_descriptor_sets()
 {
@@ -25,8 +29,8 @@ VkWriteDescriptorSet StructShaderParameter::generate_write_descriptor_sets()
 }
 */
 
-Material::Material(const ShaderStageData& in_vertex_stage, const ShaderStageData& in_fragment_stage, const std::shared_ptr<PushConstant>& in_push_constant)
-    : vertex_stage(in_vertex_stage), fragment_stage(in_fragment_stage), push_constant(in_push_constant)
+Material::Material(const ShaderStageData& in_vertex_stage, const ShaderStageData& in_fragment_stage, const std::shared_ptr<PushConstant>& in_push_constant, const VertexLayout& in_vertex_layout)
+    : vertex_stage(in_vertex_stage), fragment_stage(in_fragment_stage), push_constant(in_push_constant), vertex_layout(in_vertex_layout), render_id(material_render_id_counter++)
 {
     destroy_resources();
     if (!vertex_stage.shader || !fragment_stage.shader)
@@ -53,13 +57,16 @@ void Material::update_push_constants(VkCommandBuffer& command_buffer)
 
 void Material::destroy_resources()
 {
-    if (shader_pipeline != VK_NULL_HANDLE)
-        vkDestroyPipeline(get_engine_interface()->get_gfx_context()->logical_device, shader_pipeline, vulkan_common::allocation_callback);
+    for (VkPipeline& pipeline : pipelines)
+    {
+        if (pipeline != VK_NULL_HANDLE)
+            vkDestroyPipeline(get_engine_interface()->get_gfx_context()->logical_device, pipeline, vulkan_common::allocation_callback);
+        pipeline = VK_NULL_HANDLE;
+    }
     if (pipeline_layout != VK_NULL_HANDLE)
         vkDestroyPipelineLayout(get_engine_interface()->get_gfx_context()->logical_device, pipeline_layout, vulkan_common::allocation_callback);
     if (descriptor_set_layout != VK_NULL_HANDLE)
         vkDestroyDescriptorSetLayout(get_engine_interface()->get_gfx_context()->logical_device, descriptor_set_layout, vulkan_common::allocation_callback);
-    shader_pipeline       = VK_NULL_HANDLE;
     pipeline_layout       = VK_NULL_HANDLE;
     descriptor_set_layout = VK_NULL_HANDLE;
 }
@@ -70,6 +77,8 @@ std::vector<VkDescriptorSetLayoutBinding> Material::make_layout_bindings()
     fragment_uniform_bindings.clear();
     vertex_ssbo_bindings.clear();
     fragment_ssbo_bindings.clear();
+    vertex_image_bindings.clear();
+    fragment_image_bindings.clear();
 
     std::vector<VkDescriptorSetLayoutBinding> result_bindings;
 
@@ -190,6 +199,37 @@ std::vector<VkDescriptorSetLayoutBinding> Material::make_layout_bindings()
 
     uniform_buffers.clear();
 
+    // SAMPLED IMAGES
+
+    const auto add_image_bindings = [&](const ShaderStageData& stage, VkShaderStageFlags stage_flags, std::unordered_map<std::string, uint32_t>& image_bindings) {
+        std::unordered_map<std::string, ShaderProperty> sampled_images;
+        for (const auto& param : stage.shader->get_sampled_images())
+        {
+            sampled_images[param.property_name] = param;
+        }
+
+        for (const auto& image : stage.sampled_images)
+        {
+            if (const auto found_image = sampled_images.find(image.name); found_image != sampled_images.end())
+            {
+                result_bindings.emplace_back(VkDescriptorSetLayoutBinding{
+                    .binding            = found_image->second.location,
+                    .descriptorType     = VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER,
+                    .descriptorCount    = 1,
+                    .stageFlags         = stage_flags,
+                    .pImmutableSamplers = nullptr,
+                });
+                image_bindings[found_image->second.property_name] = found_image->second.location;
+            }
+            else
+            {
+                LOG_ERROR("specified sampled image named %s that doesn't exist in shader stage", image.name.c_str());
+            }
+        }
+    };
+    add_image_bindings(vertex_stage, VK_SHADER_STAGE_VERTEX_BIT, vertex_image_bindings);
+    add_image_bindings(fragment_stage, VK_SHADER_STAGE_FRAGMENT_BIT, fragment_image_bindings);
+
     return result_bindings;
 }
 
@@ -197,8 +237,9 @@ void Material::create_pipeline()
 {
     if (pipeline_layout != VK_NULL_HANDLE)
         vkDestroyPipelineLayout(get_engine_interface()->get_gfx_context()->logical_device, pipeline_layout, vulkan_common::allocation_callback);
-    if (shader_pipeline != VK_NULL_HANDLE)
-        vkDestroyPipeline(get_engine_interface()->get_gfx_context()->logical_device, shader_pipeline, vulkan_common::allocation_callback);
+    for (const VkPipeline pipeline : pipelines)
+        if (pipeline != VK_NULL_HANDLE)
+            vkDestroyPipeline(get_engine_interface()->get_gfx_context()->logical_device, pipeline, vulkan_common::allocation_callback);
 
     VK_CHECK(descriptor_set_layout, "Descriptor set layout should be initialized before graphic pipeline");
     VK_CHECK(get_engine_interface()->get_window()->get_render_pass(), "Render pass should be initialized before graphic pipeline");
@@ -252,14 +293,14 @@ void Material::create_pipeline()
 
     VkPipelineShaderStageCreateInfo shaderStages[] = {vertShaderStageInfo, fragShaderStageInfo};
 
-    auto bindingDescription    = Vertex::get_binding_description();
-    auto attributeDescriptions = Vertex::get_attribute_descriptions();
+    const auto bindingDescriptions   = vertex_layout.get_binding_descriptions();
+    const auto attributeDescriptions = vertex_layout.get_attribute_descriptions();
 
     VkPipelineVertexInputStateCreateInfo vertexInputInfo{};
     vertexInputInfo.sType                           = VK_STRUCTURE_TYPE_PIPELINE_VERTEX_INPUT_STATE_CREATE_INFO;
-    vertexInputInfo.vertexBindingDescriptionCount   = 1;
+    vertexInputInfo.vertexBindingDescriptionCount   = static_cast<uint32_t>(bindingDescriptions.size());
     vertexInputInfo.vertexAttributeDescriptionCount = static_cast<uint32_t>(attributeDescriptions.size());
-    vertexInputInfo.pVertexBindingDescriptions      = &bindingDescription;
+    vertexInputInfo.pVertexBindingDescriptions      = bindingDescriptions.data();
     vertexInputInfo.pVertexAttributeDescriptions    = attributeDescriptions.data();
 
     VkPipelineInputAssemblyStateCreateInfo inputAssembly{};
@@ -347,12 +388,25 @@ void Material::create_pipeline()
     pipelineInfo.pDynamicState       = &dynamicState; // Optional
     pipelineInfo.layout              = pipeline_layout;
     pipelineInfo.renderPass          = get_engine_interface()->get_window()->get_render_pass();
-    pipelineInfo.subpass             = 0;
+    pipelineInfo.subpass             = Window::color_subpass;
     pipelineInfo.basePipelineHandle  = VK_NULL_HANDLE; // Optional
     pipelineInfo.basePipelineIndex   = -1;             // Optional
     pipelineInfo.pDepthStencilState  = &depthStencil;
-    VK_ENSURE(vkCreateGraphicsPipelines(get_engine_interface()->get_gfx_context()->logical_device, VK_NULL_HANDLE, 1, &pipelineInfo, vulkan_common::allocation_callback, &shader_pipeline),
-              "Failed to create material graphic pipeline");
+
+    // The passes only differ by their subpass, depth test and fragment stage. The pre-pass has no fragment stage : materials can't discard fragments.
+    for (size_t pass = 0; pass < pipelines.size(); ++pass)
+    {
+        const bool b_depth_prepass = static_cast<EMaterialPass>(pass) == EMaterialPass::DepthPrepass;
+        const bool b_after_prepass = static_cast<EMaterialPass>(pass) == EMaterialPass::ColorAfterDepthPrepass;
+
+        depthStencil.depthWriteEnable = b_after_prepass ? VK_FALSE : VK_TRUE;
+        depthStencil.depthCompareOp   = b_after_prepass ? VK_COMPARE_OP_EQUAL : VK_COMPARE_OP_LESS;
+        colorBlending.attachmentCount = b_depth_prepass ? 0 : 1;
+        pipelineInfo.stageCount       = b_depth_prepass ? 1 : 2;
+        pipelineInfo.subpass          = b_depth_prepass ? Window::depth_prepass_subpass : Window::color_subpass;
+        VK_ENSURE(vkCreateGraphicsPipelines(get_engine_interface()->get_gfx_context()->logical_device, VK_NULL_HANDLE, 1, &pipelineInfo, vulkan_common::allocation_callback, &pipelines[pass]),
+                  "Failed to create material graphic pipeline");
+    }
 }
 
 void Material::create_descriptor_sets(std::vector<VkDescriptorSetLayoutBinding> layoutBindings)
@@ -472,28 +526,32 @@ void Material::update_descriptor_sets(size_t imageIndex)
         }
     }
 
-    /*
-    std::vector<VkDescriptorImageInfo> vertexImageInfos(descriptor_sets.size());
-    for (uint32_t i = 0; i < vertexImageInfos.size(); ++i)
-    {
-        vertexImageInfos[i].imageLayout = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL;
-        vertexImageInfos[i].imageView   = dynamicMaterialProperties.vertexTextures2D[i]->GetImageView();
-        vertexImageInfos[i].sampler     = dynamicMaterialProperties.vertexTextures2D[i]->GetSampler();
-
-        VkWriteDescriptorSet imgWDescSet{};
-        imgWDescSet.sType           = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
-        imgWDescSet.dstSet          = descriptor_sets[iIndex];
-        imgWDescSet.dstBinding      = currentBinding;
-        imgWDescSet.dstArrayElement = 0;
-        imgWDescSet.descriptorType  = VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER;
-        imgWDescSet.descriptorCount = 1;
-        imgWDescSet.pImageInfo      = &vertexImageInfos[i];
-        imgWDescSet.pBufferInfo     = nullptr;
-        imgWDescSet.pNext           = nullptr;
-        newDescSets.push_back(imgWDescSet);
-        currentBinding++;
-    }
-    */
+    const auto write_images = [&](const ShaderStageData& stage, const std::unordered_map<std::string, uint32_t>& image_bindings) {
+        for (const auto& image : stage.sampled_images)
+        {
+            if (auto binding = image_bindings.find(image.name); binding != image_bindings.end())
+            {
+                write_descriptor_sets.emplace_back(VkWriteDescriptorSet{
+                    .sType            = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET,
+                    .pNext            = nullptr,
+                    .dstSet           = descriptor_sets[imageIndex],
+                    .dstBinding       = binding->second,
+                    .dstArrayElement  = 0,
+                    .descriptorCount  = 1,
+                    .descriptorType   = VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER,
+                    .pImageInfo       = &image.image_info,
+                    .pBufferInfo      = nullptr,
+                    .pTexelBufferView = nullptr,
+                });
+            }
+            else
+            {
+                LOG_ERROR("failed to find binding for sampled image");
+            }
+        }
+    };
+    write_images(vertex_stage, vertex_image_bindings);
+    write_images(fragment_stage, fragment_image_bindings);
 
     vkUpdateDescriptorSets(get_engine_interface()->get_gfx_context()->logical_device, static_cast<uint32_t>(write_descriptor_sets.size()), write_descriptor_sets.data(), 0, nullptr);
 }
\ No newline at end of file
@@ -3,80 +3,116 @@
 
 #include <string.h>
 
+#include "assets/asset_uploader.h"
 #include "engine_interface.h"
-#include "rendering/vulkan/common.h"
-#include "rendering/vulkan/utils.h"
 #include "statsRecorder.h"
 
-VkVertexInputBindingDescription Vertex::get_binding_description()
+#include <algorithm>
+#include <atomic>
+#include <mutex>
+
+static std::atomic_size_t released_cpu_bytes = 0;
+
+namespace
+{
+// Render ids of the destroyed meshes are reused : ids stay lower than the peak mesh count, which the sort keys of the render queue rely on
+struct RenderIdAllocator
 {
-    VkVertexInputBindingDescription binding_description{};
-    binding_description.binding   = 0;
-    binding_description.stride    = sizeof(Vertex);
-    binding_description.inputRate = VK_VERTEX_INPUT_RATE_VERTEX;
+    std::mutex            lock;
+    std::vector<uint32_t> free_ids;
+    uint32_t              next_id = 0;
+};
+
+RenderIdAllocator& get_render_id_allocator()
+{
+    static RenderIdAllocator allocator;
+    return allocator;
+}
 
-    return binding_description;
+uint32_t acquire_render_id()
+{
+    RenderIdAllocator&          allocator = get_render_id_allocator();
+    std::lock_guard<std::mutex> lock(allocator.lock);
+    if (allocator.free_ids.empty())
+        return allocator.next_id++;
+    const uint32_t id = allocator.free_ids.back();
+    allocator.free_ids.pop_back();
+    return id;
 }
 
-std::vector<VkVertexInputAttributeDescription> Vertex::get_attribute_descriptions()
+void release_render_id(uint32_t id)
 {
-    std::vector<VkVertexInputAttributeDescription> attribute_description{};
-
-    VkVertexInputAttributeDescription new_attribute;
-    uint8_t                           currentLocation = 0;
-
-    new_attribute.binding  = 0;
-    new_attribute.location = currentLocation++;
-    new_attribute.format   = VK_FORMAT_R32G32B32_SFLOAT;
-    new_attribute.offset   = offsetof(Vertex, pos);
-    attribute_description.push_back(new_attribute);
-
-    new_attribute.binding  = 0;
-    new_attribute.location = currentLocation++;
-    new_attribute.format   = VK_FORMAT_R32G32_SFLOAT;
-    new_attribute.offset   = offsetof(Vertex, uv);
-    attribute_description.push_back(new_attribute);
-
-    new_attribute.binding  = 0;
-    new_attribute.location = currentLocation++;
-    new_attribute.format   = VK_FORMAT_R32G32B32_SFLOAT;
-    new_attribute.offset   = offsetof(Vertex, col);
-    attribute_description.push_back(new_attribute);
-
-    new_attribute.binding  = 0;
-    new_attribute.location = currentLocation++;
-    new_attribute.format   = VK_FORMAT_R32G32B32_SFLOAT;
-    new_attribute.offset   = offsetof(Vertex, norm);
-    attribute_description.push_back(new_attribute);
-
-    new_attribute.binding  = 0;
-    new_attribute.location = currentLocation++;
-    new_attribute.format   = VK_FORMAT_R32G32B32_SFLOAT;
-    new_attribute.offset   = offsetof(Vertex, tang);
-    attribute_description.push_back(new_attribute);
-
-    new_attribute.binding  = 0;
-    new_attribute.location = currentLocation++;
-    new_attribute.format   = VK_FORMAT_R32G32B32_SFLOAT;
-    new_attribute.offset   = offsetof(Vertex, bitang);
-    attribute_description.push_back(new_attribute);
-
-    return attribute_description;
+    RenderIdAllocator&          allocator = get_render_id_allocator();
+    std::lock_guard<std::mutex> lock(allocator.lock);
+    allocator.free_ids.emplace_back(id);
 }
+} // namespace
 
-MeshData::MeshData(std::vector<Vertex> in_vertices, std::vector<uint32_t> in_indices) : vertices(std::move(in_vertices)), indices(std::move(in_indices))
+MeshData::MeshData(std::vector<Vertex> in_vertices, std::vector<uint32_t> in_indices, std::vector<MeshLod> in_lods, EMeshCpuResidency in_cpu_residency, const VertexLayout& in_vertex_layout)
+    : vertices(std::move(in_vertices)), indices(std::move(in_indices)), lods(std::move(in_lods)), vertex_count(static_cast<uint32_t>(vertices.size())), index_count(static_cast<uint32_t>(indices.size())),
+      cpu_residency(in_cpu_residency), vertex_layout(in_vertex_layout), render_id(acquire_render_id())
 {
+    if (lods.empty())
+        lods.emplace_back(MeshLod{.first_index = 0, .index_count = index_count, .error = 0.f});
     set_mesh_data(vertices, indices);
+    release_cpu_data();
+}
+
+uint32_t MeshData::select_lod(float pixels_per_unit, float max_pixel_error, float hysteresis, uint32_t current_lod) const
+{
+    const auto coarsest_lod_under = [&](float pixel_error) {
+        uint32_t lod = 0;
+        while (lod + 1 < lods.size() && lods[lod + 1].error * pixels_per_unit <= pixel_error)
+            ++lod;
+        return lod;
+    };
+
+    current_lod = std::min(current_lod, get_lod_count() - 1);
+
+    // Coarser : only once the error is comfortably under the limit
+    const uint32_t coarser_lod = coarsest_lod_under(max_pixel_error * (1.f - hysteresis));
+    if (coarser_lod > current_lod)
+        return coarser_lod;
+
+    // Finer : as soon as the current lod exceeds the limit
+    if (lods[current_lod].error * pixels_per_unit > max_pixel_error)
+        return coarsest_lod_under(max_pixel_error);
+
+    return current_lod;
 }
 
 MeshData::~MeshData()
 {
-    if (vertex_buffer != VK_NULL_HANDLE)
-        vmaDestroyBuffer(get_engine_interface()->get_gfx_context()->vulkan_memory_allocator, vertex_buffer, vertex_buffer_allocation);
-    if (index_buffer != VK_NULL_HANDLE)
-        vmaDestroyBuffer(get_engine_interface()->get_gfx_context()->vulkan_memory_allocator, index_buffer, index_buffer_allocation);
-    vertex_buffer = VK_NULL_HANDLE;
-    index_buffer  = VK_NULL_HANDLE;
+    // Destroyed once the frames in flight are complete : the range can be reused right away
+    if (geometry.pool)
+        geometry.pool->free(geometry);
+    release_render_id(render_id);
+}
+
+size_t MeshData::get_cpu_bytes() const
+{
+    return vertices.capacity() * sizeof(Vertex) + indices.capacity() * sizeof(uint32_t) + lods.size() * sizeof(MeshLod) + occluder_triangles.size() * sizeof(glm::vec3) + bvh.get_memory_bytes();
+}
+
+size_t MeshData::get_gpu_bytes() const
+{
+    return geometry.pool ? static_cast<size_t>(vertex_count) * geometry.vertex_block->element_size + index_count * get_index_size() : 0;
+}
+
+size_t MeshData::get_released_cpu_bytes()
+{
+    return released_cpu_bytes.load(std::memory_order_relaxed);
+}
+
+void MeshData::release_cpu_data()
+{
+    if (cpu_residency == EMeshCpuResidency::Full)
+        return;
+
+    // The uploader copied them to its staging buffers
+    released_cpu_bytes += vertices.capacity() * sizeof(Vertex) + indices.capacity() * sizeof(uint32_t);
+    vertices = {};
+    indices  = {};
 }
 
 void MeshData::set_mesh_data(const std::vector<Vertex>& in_vertices, const std::vector<uint32_t>& in_indices)
@@ -95,43 +131,59 @@ void MeshData::set_mesh_data(const std::vector<Vertex>& in_vertices, const std::
     LOG_INFO("create static mesh %s", get_id().to_string().c_str());
     BEGIN_NAMED_RECORD(CREATE_MESH);
 
-    void*          data;
-    VkBuffer       staging_buffer;
-    VkDeviceMemory staging_buffer_memory;
-
-    const VkDeviceSize vertex_buffer_size = sizeof(Vertex) * in_vertices.size();
-    const VkDeviceSize index_buffer_size  = sizeof(uint32_t) * indices.size();
-
-    /* Copy vertices */
-
-    vulkan_utils::create_buffer(get_engine_interface()->get_gfx_context(), vertex_buffer_size, VK_BUFFER_USAGE_TRANSFER_SRC_BIT, VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT, staging_buffer,
-                                staging_buffer_memory);
-
-    vkMapMemory(get_engine_interface()->get_gfx_context()->logical_device, staging_buffer_memory, 0, vertex_buffer_size, 0, &data);
-    memcpy(data, in_vertices.data(), static_cast<size_t>(vertex_buffer_size));
-    vkUnmapMemory(get_engine_interface()->get_gfx_context()->logical_device, staging_buffer_memory);
-
-    vulkan_utils::create_vma_buffer(get_engine_interface()->get_window(), vertex_buffer_size, VK_BUFFER_USAGE_TRANSFER_DST_BIT | VK_BUFFER_USAGE_VERTEX_BUFFER_BIT, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, vertex_buffer,
-                                    vertex_buffer_allocation, vertex_buffer_alloc_info);
-
-    vulkan_utils::copy_buffer(get_engine_interface()->get_window(), staging_buffer, vertex_buffer, vertex_buffer_size);
-
-    vkDestroyBuffer(get_engine_interface()->get_gfx_context()->logical_device, staging_buffer, vulkan_common::allocation_callback);
-    vkFreeMemory(get_engine_interface()->get_gfx_context()->logical_device, staging_buffer_memory, vulkan_common::allocation_callback);
-
-    vulkan_utils::create_buffer(get_engine_interface()->get_gfx_context(), index_buffer_size, VK_BUFFER_USAGE_TRANSFER_SRC_BIT, VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT, staging_buffer,
-                                staging_buffer_memory);
-
-    /* Copy indices */
-
-    vkMapMemory(get_engine_interface()->get_gfx_context()->logical_device, staging_buffer_memory, 0, index_buffer_size, 0, &data);
-    memcpy(data, indices.data(), static_cast<size_t>(index_buffer_size));
-    vkUnmapMemory(get_engine_interface()->get_gfx_context()->logical_device, staging_buffer_memory);
-
-    vulkan_utils::create_vma_buffer(get_engine_interface()->get_window(), index_buffer_size, VK_BUFFER_USAGE_TRANSFER_DST_BIT | VK_BUFFER_USAGE_INDEX_BUFFER_BIT, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, index_buffer,
-                                    index_buffer_allocation, index_buffer_alloc_info);
-    vulkan_utils::copy_buffer(get_engine_interface()->get_window(), staging_buffer, index_buffer, index_buffer_size);
+    // Bounding sphere centered on the bounding box
+    glm::vec3 min_bound = in_vertices[0].pos;
+    glm::vec3 max_bound = in_vertices[0].pos;
+    for (const auto& vertex : in_vertices)
+    {
+        min_bound = glm::min(min_bound, vertex.pos);
+        max_bound = glm::max(max_bound, vertex.pos);
+    }
+    const glm::vec3 center = (min_bound + max_bound) * 0.5f;
+    float           radius = 0.f;
+    for (const auto& vertex : in_vertices)
+        radius = glm::max(radius, glm::length(vertex.pos - center));
+    bounding_sphere = glm::vec4(center, radius);
+    bounds          = Aabb{.min = min_bound, .max = max_bound};
+
+    if (cpu_residency != EMeshCpuResidency::Released)
+    {
+        std::vector<glm::vec3> positions(in_vertices.size());
+        for (size_t i = 0; i < in_vertices.size(); ++i)
+            positions[i] = in_vertices[i].pos;
+        const auto first_index = in_indices.begin() + lods[0].first_index;
+        bvh.build(std::move(positions), std::vector<uint32_t>(first_index, first_index + lods[0].index_count));
+    }
 
-    vkDestroyBuffer(get_engine_interface()->get_gfx_context()->logical_device, staging_buffer, vulkan_common::allocation_callback);
-    vkFreeMemory(get_engine_interface()->get_gfx_context()->logical_device, staging_buffer_memory, vulkan_common::allocation_callback);
+    const MeshLod& coarsest_lod = lods.back();
+    occluder_triangles.resize(coarsest_lod.index_count);
+    for (uint32_t i = 0; i < coarsest_lod.index_count; ++i)
+        occluder_triangles[i] = in_vertices[in_indices[coarsest_lod.first_index + i]].pos;
+
+    std::vector<uint8_t> positions;
+    std::vector<uint8_t> attributes;
+    vertex_layout.encode(in_vertices, bounds, positions, attributes);
+
+    // Indices stay relative to the mesh, the draws offset them by the first vertex of its range
+    AssetManager* asset_manager = get_engine_interface()->get_asset_manager();
+    index_type                  = in_vertices.size() <= 65536 ? VK_INDEX_TYPE_UINT16 : VK_INDEX_TYPE_UINT32;
+    geometry                    = asset_manager->get_geometry_pool()->allocate(vertex_layout, vertex_count, index_type, index_count);
+
+    // Staged by the calling thread, copied by the next batch of the transfer queue
+    AssetUploader*       uploader     = asset_manager->get_uploader();
+    const GeometryBlock& vertex_block = *geometry.vertex_block;
+    const VkDeviceSize   first_vertex = geometry.first_vertex;
+    set_upload_ticket(uploader->upload_buffer(vertex_block.buffer, positions.data(), positions.size(), first_vertex * vertex_layout.get_position_stride()));
+    if (!attributes.empty())
+        set_upload_ticket(uploader->upload_buffer(vertex_block.buffer, attributes.data(), attributes.size(), vertex_block.attribute_offset + first_vertex * vertex_layout.get_attribute_stride()));
+
+    const VkDeviceSize index_buffer_size   = get_index_size() * in_indices.size();
+    const VkDeviceSize index_buffer_offset = get_index_size() * static_cast<VkDeviceSize>(geometry.first_index);
+    if (index_type == VK_INDEX_TYPE_UINT16)
+    {
+        const std::vector<uint16_t> narrow_indices(in_indices.begin(), in_indices.end());
+        set_upload_ticket(uploader->upload_buffer(geometry.index_block->buffer, narrow_indices.data(), index_buffer_size, index_buffer_offset));
+    }
+    else
+        set_upload_ticket(uploader->upload_buffer(geometry.index_block->buffer, in_indices.data(), index_buffer_size, index_buffer_offset));
 }
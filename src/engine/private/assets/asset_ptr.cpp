@@ -20,6 +20,49 @@ IAssetPtr::IAssetPtr(AssetBase* in_asset)
     set(in_asset);
 }
 
+IAssetPtr::IAssetPtr(const IAssetPtr& other) : asset_manager(other.asset_manager), asset_id(other.asset_id), asset(other.asset), slot(other.slot), generation(other.generation)
+{
+    if (asset)
+        asset->add_ref();
+}
+
+IAssetPtr::IAssetPtr(IAssetPtr&& other) noexcept : asset_manager(other.asset_manager), asset_id(other.asset_id), asset(other.asset), slot(other.slot), generation(other.generation)
+{
+    other.asset = nullptr;
+    other.clear();
+}
+
+IAssetPtr& IAssetPtr::operator=(const IAssetPtr& other)
+{
+    if (this == &other)
+        return *this;
+    // Referenced first : other may be the last holder of our asset
+    if (other.asset)
+        other.asset->add_ref();
+    release_asset();
+    asset_manager = other.asset_manager;
+    asset_id      = other.asset_id;
+    asset         = other.asset;
+    slot          = other.slot;
+    generation    = other.generation;
+    return *this;
+}
+
+IAssetPtr& IAssetPtr::operator=(IAssetPtr&& other) noexcept
+{
+    if (this == &other)
+        return *this;
+    release_asset();
+    asset_manager = other.asset_manager;
+    asset_id      = other.asset_id;
+    asset         = other.asset;
+    slot          = other.slot;
+    generation    = other.generation;
+    other.asset   = nullptr;
+    other.clear();
+    return *this;
+}
+
 void IAssetPtr::set(AssetBase* in_asset)
 {
     if (in_asset == asset)
@@ -27,9 +70,12 @@ void IAssetPtr::set(AssetBase* in_asset)
     clear();
     if (!in_asset)
         return;
-    asset_id      = std::make_shared<AssetId>(in_asset->get_id());
+    asset_id      = in_asset->get_id();
+    asset_manager = in_asset->get_engine_interface()->get_asset_manager();
+    slot          = asset_manager->find_slot(*asset_id);
+    generation    = slot ? slot->generation.load(std::memory_order_acquire) : 0;
     asset         = in_asset;
-    asset_manager = asset->get_engine_interface()->get_asset_manager();
+    asset->add_ref();
 }
 
 void IAssetPtr::set(AssetManager* in_asset_manager, const AssetId& in_asset_id)
@@ -37,46 +83,74 @@ void IAssetPtr::set(AssetManager* in_asset_manager, const AssetId& in_asset_id)
     if (asset_id && in_asset_id == *asset_id)
         return;
     clear();
-    asset_id      = std::make_shared<AssetId>(in_asset_id);
+    asset_id      = in_asset_id;
     asset_manager = in_asset_manager;
-    asset         = asset_manager->find(*asset_id);
+    resolve();
 }
 
 void IAssetPtr::clear()
 {
+    release_asset();
     asset_manager = nullptr;
-    asset         = nullptr;
-    asset_id      = nullptr;
+    asset_id      = std::nullopt;
+    slot          = nullptr;
+    generation    = 0;
 }
 
 AssetBase* IAssetPtr::get()
 {
-    if (!asset_manager)
-        return nullptr;
-    if (!asset_id)
-        return nullptr;
-    if (!asset)
-        asset = asset_manager->find(*asset_id);
-    if (asset)
+    if (asset && slot && slot->generation.load(std::memory_order_acquire) == generation)
     {
+        asset->touch(asset_manager->get_frame());
         return asset;
     }
-    return nullptr;
+    return resolve();
 }
 
 AssetBase* IAssetPtr::get_const() const
 {
-    if (!asset_manager)
+    if (asset && slot && slot->generation.load(std::memory_order_acquire) == generation)
+        return asset;
+    return nullptr;
+}
+
+AssetBase* IAssetPtr::resolve()
+{
+    release_asset();
+    if (!asset_manager || !asset_id)
         return nullptr;
-    if (!asset_id)
+    if (!slot)
+        slot = asset_manager->find_slot(*asset_id);
+    if (!slot)
         return nullptr;
-    if (asset)
+
+    // Generation first : if the asset is released meanwhile, the cached one is detected as outdated
+    generation                = slot->generation.load(std::memory_order_acquire);
+    AssetBase* resolved_asset = slot->asset.load(std::memory_order_acquire);
+    if (!resolved_asset)
+        return nullptr;
+
+    // Its destruction is deferred by a frame at least : it is still valid if it was unloaded since the slot was read
+    resolved_asset->add_ref();
+    if (slot->generation.load(std::memory_order_acquire) != generation)
     {
-        return asset;
+        resolved_asset->release_ref();
+        return nullptr;
     }
-    return nullptr;
+    asset = resolved_asset;
+    asset->touch(asset_manager->get_frame());
+    return asset;
+}
+
+void IAssetPtr::release_asset()
+{
+    AssetBase* released_asset = asset;
+    asset                     = nullptr;
+    if (released_asset)
+        released_asset->release_ref();
 }
 
 IAssetPtr::~IAssetPtr()
 {
+    release_asset();
 }
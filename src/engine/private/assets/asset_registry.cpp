@@ -0,0 +1,90 @@
+
+
+#include "assets/asset_registry.h"
+
+#include <cpputils/logger.hpp>
+
+AssetRegistry::AssetRegistry()
+{
+    tables.emplace_back(std::make_unique<Table>(256));
+    table.store(tables.back().get(), std::memory_order_release);
+}
+
+AssetRegistry::~AssetRegistry()
+{
+    for (auto& chunk : chunks)
+        delete[] chunk.load();
+}
+
+AssetSlot* AssetRegistry::find(const AssetId& id) const
+{
+    const Table* current = table.load(std::memory_order_acquire);
+    const size_t key     = id();
+    for (size_t bucket = bucket_of(key, current->capacity);; bucket = (bucket + 1) & (current->capacity - 1))
+    {
+        const uint32_t slot_index = current->buckets[bucket].load(std::memory_order_acquire);
+        if (slot_index == 0)
+            return nullptr;
+        AssetSlot* slot = get_slot(slot_index - 1);
+        if (slot->id == key)
+            return slot;
+    }
+}
+
+AssetSlot* AssetRegistry::reserve(const AssetId& id)
+{
+    std::lock_guard<std::mutex> lock(write_lock);
+
+    // Released ids keep their slot
+    if (AssetSlot* slot = find(id))
+    {
+        if (slot->b_reserved.exchange(true, std::memory_order_acq_rel))
+            return nullptr;
+        return slot;
+    }
+
+    const uint32_t slot_index = slot_count.load(std::memory_order_relaxed);
+    if (slot_index / chunk_size >= max_chunks)
+        LOG_FATAL("asset registry is full (%u assets)", slot_index);
+    if (slot_index % chunk_size == 0)
+        chunks[slot_index / chunk_size].store(new AssetSlot[chunk_size], std::memory_order_release);
+
+    AssetSlot* slot = get_slot(slot_index);
+    slot->id        = id();
+    slot->b_reserved.store(true, std::memory_order_relaxed);
+    slot_count.store(slot_index + 1, std::memory_order_release);
+
+    // Keep the load factor under one half : probes stay short
+    if ((slot_index + 1) * 2 > table.load(std::memory_order_relaxed)->capacity)
+        grow();
+    else
+        insert(*table.load(std::memory_order_relaxed), slot->id, slot_index);
+    return slot;
+}
+
+void AssetRegistry::release(AssetSlot* slot)
+{
+    slot->asset.store(nullptr, std::memory_order_release);
+    slot->generation.fetch_add(1, std::memory_order_acq_rel);
+    slot->b_reserved.store(false, std::memory_order_release);
+}
+
+void AssetRegistry::insert(Table& table, size_t id, uint32_t slot_index)
+{
+    size_t bucket = bucket_of(id, table.capacity);
+    while (table.buckets[bucket].load(std::memory_order_relaxed) != 0)
+        bucket = (bucket + 1) & (table.capacity - 1);
+    table.buckets[bucket].store(slot_index + 1, std::memory_order_release);
+}
+
+void AssetRegistry::grow()
+{
+    // Filled before being published : readers see either table complete
+    const uint32_t count     = slot_count.load(std::memory_order_relaxed);
+    auto           new_table = std::make_unique<Table>(table.load(std::memory_order_relaxed)->capacity * 2);
+    for (uint32_t i = 0; i < count; ++i)
+        insert(*new_table, get_slot(i)->id, i);
+
+    table.store(new_table.get(), std::memory_order_release);
+    tables.emplace_back(std::move(new_table));
+}
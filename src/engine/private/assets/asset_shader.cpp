@@ -190,6 +190,9 @@ std::optional<std::vector<uint32_t>> Shader::compile_module(const std::string& f
     case EShaderStage::GeometryShader:
         shader_stage = GLSLANG_STAGE_GEOMETRY;
         break;
+    case EShaderStage::ComputeShader:
+        shader_stage = GLSLANG_STAGE_COMPUTE;
+        break;
     default:
         LOG_FATAL("unhandled shader kind");
     }
@@ -0,0 +1,298 @@
+
+
+#include "assets/asset_shadow_material.h"
+
+#include "assets/asset_shader.h"
+#include "assets/asset_uniform_buffer.h"
+#include "engine_interface.h"
+
+ShadowMaterial::ShadowMaterial(const ShaderStageData& in_vertex_stage, VkRenderPass in_render_pass) : vertex_stage(in_vertex_stage)
+{
+    if (!vertex_stage.shader)
+        return;
+    create_descriptor_sets(make_layout_bindings());
+    create_pipeline(in_render_pass);
+}
+
+ShadowMaterial::~ShadowMaterial()
+{
+    destroy_resources();
+}
+
+void ShadowMaterial::destroy_resources()
+{
+    for (VkPipeline& pipeline : shadow_pipelines)
+    {
+        if (pipeline != VK_NULL_HANDLE)
+            vkDestroyPipeline(get_engine_interface()->get_gfx_context()->logical_device, pipeline, vulkan_common::allocation_callback);
+        pipeline = VK_NULL_HANDLE;
+    }
+    if (pipeline_layout != VK_NULL_HANDLE)
+        vkDestroyPipelineLayout(get_engine_interface()->get_gfx_context()->logical_device, pipeline_layout, vulkan_common::allocation_callback);
+    if (descriptor_set_layout != VK_NULL_HANDLE)
+        vkDestroyDescriptorSetLayout(get_engine_interface()->get_gfx_context()->logical_device, descriptor_set_layout, vulkan_common::allocation_callback);
+    pipeline_layout       = VK_NULL_HANDLE;
+    descriptor_set_layout = VK_NULL_HANDLE;
+}
+
+std::vector<VkDescriptorSetLayoutBinding> ShadowMaterial::make_layout_bindings()
+{
+    uniform_bindings.clear();
+    ssbo_bindings.clear();
+
+    std::vector<VkDescriptorSetLayoutBinding> result_bindings;
+
+    std::unordered_map<std::string, ShaderProperty> uniform_buffers;
+    std::unordered_map<std::string, ShaderProperty> storage_buffers;
+
+    for (const auto& param : vertex_stage.shader->get_uniform_buffers())
+    {
+        uniform_buffers[param.property_name] = param;
+    }
+
+    for (const auto& uniform : vertex_stage.uniform_buffer)
+    {
+        if (const auto found_buffer = uniform_buffers.find(uniform->get_name()); found_buffer != uniform_buffers.end())
+        {
+            result_bindings.emplace_back(VkDescriptorSetLayoutBinding{
+                .binding            = found_buffer->second.location,
+                .descriptorType     = VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER,
+                .descriptorCount    = 1,
+                .stageFlags         = VK_SHADER_STAGE_VERTEX_BIT,
+                .pImmutableSamplers = nullptr,
+            });
+            uniform_bindings[found_buffer->second.property_name] = found_buffer->second.location;
+        }
+        else
+        {
+            LOG_ERROR("specified uniform buffer named %s that doesn't exist in shadow vertex stage", uniform->get_name().c_str());
+        }
+    }
+
+    for (const auto& param : vertex_stage.shader->get_storage_buffers())
+    {
+        storage_buffers[param.property_name] = param;
+    }
+
+    for (const auto& ssbo : vertex_stage.storage_buffers)
+    {
+        if (const auto found_buffer = storage_buffers.find(ssbo->get_name()); found_buffer != storage_buffers.end())
+        {
+            result_bindings.emplace_back(VkDescriptorSetLayoutBinding{
+                .binding            = found_buffer->second.location,
+                .descriptorType     = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER,
+                .descriptorCount    = 1,
+                .stageFlags         = VK_SHADER_STAGE_VERTEX_BIT,
+                .pImmutableSamplers = nullptr,
+            });
+            ssbo_bindings[found_buffer->second.property_name] = found_buffer->second.location;
+        }
+        else
+        {
+            LOG_ERROR("specified storage buffer named %s that doesn't exist in shadow vertex stage", ssbo->get_name().c_str());
+        }
+    }
+
+    return result_bindings;
+}
+
+void ShadowMaterial::create_pipeline(VkRenderPass render_pass)
+{
+    VK_CHECK(descriptor_set_layout, "Descriptor set layout should be initialized before shadow pipeline");
+    VK_CHECK(render_pass, "Shadow render pass should be initialized before shadow pipeline");
+
+    VkPipelineShaderStageCreateInfo vertex_stage_info{};
+    vertex_stage_info.sType  = VK_STRUCTURE_TYPE_PIPELINE_SHADER_STAGE_CREATE_INFO;
+    vertex_stage_info.stage  = VK_SHADER_STAGE_VERTEX_BIT;
+    vertex_stage_info.module = vertex_stage.shader->get_shader_module();
+    vertex_stage_info.pName  = "main";
+
+    VkPushConstantRange cascade_range{};
+    cascade_range.stageFlags = VK_SHADER_STAGE_VERTEX_BIT;
+    cascade_range.offset     = 0;
+    cascade_range.size       = sizeof(uint32_t);
+
+    VkPipelineLayoutCreateInfo pipeline_layout_info{};
+    pipeline_layout_info.sType                  = VK_STRUCTURE_TYPE_PIPELINE_LAYOUT_CREATE_INFO;
+    pipeline_layout_info.setLayoutCount         = 1;
+    pipeline_layout_info.pSetLayouts            = &descriptor_set_layout;
+    pipeline_layout_info.pushConstantRangeCount = 1;
+    pipeline_layout_info.pPushConstantRanges    = &cascade_range;
+    VK_ENSURE(vkCreatePipelineLayout(get_engine_interface()->get_gfx_context()->logical_device, &pipeline_layout_info, vulkan_common::allocation_callback, &pipeline_layout), "Failed to create shadow pipeline layout");
+
+    // Only the position stream is read, one pipeline per position format
+    constexpr size_t                                               format_count = static_cast<size_t>(EVertexPositionFormat::Count);
+    std::array<VkVertexInputBindingDescription, format_count>      binding_descriptions;
+    std::array<VkVertexInputAttributeDescription, format_count>    position_attributes;
+    std::array<VkPipelineVertexInputStateCreateInfo, format_count> vertex_input_infos{};
+    for (size_t format = 0; format < format_count; ++format)
+    {
+        const VertexLayout layout{.position_format = static_cast<EVertexPositionFormat>(format)};
+        binding_descriptions[format] = layout.get_binding_descriptions(true)[0];
+        position_attributes[format]  = layout.get_attribute_descriptions(true)[0];
+
+        vertex_input_infos[format].sType                           = VK_STRUCTURE_TYPE_PIPELINE_VERTEX_INPUT_STATE_CREATE_INFO;
+        vertex_input_infos[format].vertexBindingDescriptionCount   = 1;
+        vertex_input_infos[format].pVertexBindingDescriptions      = &binding_descriptions[format];
+        vertex_input_infos[format].vertexAttributeDescriptionCount = 1;
+        vertex_input_infos[format].pVertexAttributeDescriptions    = &position_attributes[format];
+    }
+
+    VkPipelineInputAssemblyStateCreateInfo input_assembly{};
+    input_assembly.sType                  = VK_STRUCTURE_TYPE_PIPELINE_INPUT_ASSEMBLY_STATE_CREATE_INFO;
+    input_assembly.topology               = VK_PRIMITIVE_TOPOLOGY_TRIANGLE_LIST;
+    input_assembly.primitiveRestartEnable = VK_FALSE;
+
+    VkPipelineViewportStateCreateInfo viewport_state{};
+    viewport_state.sType         = VK_STRUCTURE_TYPE_PIPELINE_VIEWPORT_STATE_CREATE_INFO;
+    viewport_state.viewportCount = 1;
+    viewport_state.scissorCount  = 1;
+
+    // Both faces cast shadows (open meshes), the bias removes the self shadowing acne
+    VkPipelineRasterizationStateCreateInfo rasterizer{};
+    rasterizer.sType                   = VK_STRUCTURE_TYPE_PIPELINE_RASTERIZATION_STATE_CREATE_INFO;
+    rasterizer.depthClampEnable        = VK_FALSE;
+    rasterizer.rasterizerDiscardEnable = VK_FALSE;
+    rasterizer.polygonMode             = VK_POLYGON_MODE_FILL;
+    rasterizer.lineWidth               = 1.0f;
+    rasterizer.cullMode                = VK_CULL_MODE_NONE;
+    rasterizer.frontFace               = VK_FRONT_FACE_COUNTER_CLOCKWISE;
+    rasterizer.depthBiasEnable         = VK_TRUE;
+    rasterizer.depthBiasConstantFactor = 1.25f;
+    rasterizer.depthBiasClamp          = 0.0f;
+    rasterizer.depthBiasSlopeFactor    = 1.75f;
+
+    VkPipelineMultisampleStateCreateInfo multisampling{};
+    multisampling.sType                = VK_STRUCTURE_TYPE_PIPELINE_MULTISAMPLE_STATE_CREATE_INFO;
+    multisampling.rasterizationSamples = VK_SAMPLE_COUNT_1_BIT;
+    multisampling.sampleShadingEnable  = VK_FALSE;
+
+    VkPipelineDepthStencilStateCreateInfo depth_stencil{};
+    depth_stencil.sType                 = VK_STRUCTURE_TYPE_PIPELINE_DEPTH_STENCIL_STATE_CREATE_INFO;
+    depth_stencil.depthTestEnable       = VK_TRUE;
+    depth_stencil.depthWriteEnable      = VK_TRUE;
+    depth_stencil.depthCompareOp        = VK_COMPARE_OP_LESS;
+    depth_stencil.depthBoundsTestEnable = VK_FALSE;
+    depth_stencil.stencilTestEnable     = VK_FALSE;
+
+    // No color attachment
+    VkPipelineColorBlendStateCreateInfo color_blending{};
+    color_blending.sType           = VK_STRUCTURE_TYPE_PIPELINE_COLOR_BLEND_STATE_CREATE_INFO;
+    color_blending.attachmentCount = 0;
+
+    VkDynamicState dynamic_states[] = {VK_DYNAMIC_STATE_SCISSOR, VK_DYNAMIC_STATE_VIEWPORT};
+
+    VkPipelineDynamicStateCreateInfo dynamic_state{};
+    dynamic_state.sType             = VK_STRUCTURE_TYPE_PIPELINE_DYNAMIC_STATE_CREATE_INFO;
+    dynamic_state.dynamicStateCount = 2;
+    dynamic_state.pDynamicStates    = dynamic_states;
+
+    VkGraphicsPipelineCreateInfo pipeline_info{};
+    pipeline_info.sType               = VK_STRUCTURE_TYPE_GRAPHICS_PIPELINE_CREATE_INFO;
+    pipeline_info.stageCount          = 1;
+    pipeline_info.pStages             = &vertex_stage_info;
+    pipeline_info.pVertexInputState   = nullptr; // Set per position format
+    pipeline_info.pInputAssemblyState = &input_assembly;
+    pipeline_info.pViewportState      = &viewport_state;
+    pipeline_info.pRasterizationState = &rasterizer;
+    pipeline_info.pMultisampleState   = &multisampling;
+    pipeline_info.pDepthStencilState  = &depth_stencil;
+    pipeline_info.pColorBlendState    = &color_blending;
+    pipeline_info.pDynamicState       = &dynamic_state;
+    pipeline_info.layout              = pipeline_layout;
+    pipeline_info.renderPass          = render_pass;
+    pipeline_info.subpass             = 0;
+    pipeline_info.basePipelineHandle  = VK_NULL_HANDLE;
+    pipeline_info.basePipelineIndex   = -1;
+    std::array<VkGraphicsPipelineCreateInfo, format_count> pipeline_infos;
+    for (size_t format = 0; format < format_count; ++format)
+    {
+        pipeline_infos[format]                   = pipeline_info;
+        pipeline_infos[format].pVertexInputState = &vertex_input_infos[format];
+    }
+    VK_ENSURE(vkCreateGraphicsPipelines(get_engine_interface()->get_gfx_context()->logical_device, VK_NULL_HANDLE, static_cast<uint32_t>(format_count), pipeline_infos.data(), vulkan_common::allocation_callback,
+                                        shadow_pipelines.data()),
+              "Failed to create shadow pipelines");
+}
+
+void ShadowMaterial::create_descriptor_sets(const std::vector<VkDescriptorSetLayoutBinding>& layout_bindings)
+{
+    /** Create descriptor set layout */
+    VkDescriptorSetLayoutCreateInfo layout_info{};
+    layout_info.sType        = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_LAYOUT_CREATE_INFO;
+    layout_info.bindingCount = static_cast<uint32_t>(layout_bindings.size());
+    layout_info.pBindings    = layout_bindings.data();
+    VK_ENSURE(vkCreateDescriptorSetLayout(get_engine_interface()->get_gfx_context()->logical_device, &layout_info, vulkan_common::allocation_callback, &descriptor_set_layout),
+              "Failed to create shadow descriptor set layout");
+
+    /** Allocate descriptor set */
+    std::vector<VkDescriptorSetLayout> layouts(get_engine_interface()->get_window()->get_image_count(), descriptor_set_layout);
+    descriptor_sets.resize(get_engine_interface()->get_window()->get_image_count());
+    VkDescriptorSetAllocateInfo alloc_info{};
+    alloc_info.sType              = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_ALLOCATE_INFO;
+    alloc_info.descriptorSetCount = get_engine_interface()->get_window()->get_image_count();
+    alloc_info.pSetLayouts        = layouts.data();
+    alloc_info.descriptorPool     = VK_NULL_HANDLE;
+    get_engine_interface()->get_window()->get_descriptor_pool()->alloc_memory(alloc_info);
+    VK_ENSURE(vkAllocateDescriptorSets(get_engine_interface()->get_gfx_context()->logical_device, &alloc_info, descriptor_sets.data()), "Failed to allocate shadow descriptor sets");
+}
+
+void ShadowMaterial::update_descriptor_sets(size_t image_index)
+{
+    std::vector<VkWriteDescriptorSet> write_descriptor_sets = {};
+
+    for (const auto& uniform : vertex_stage.uniform_buffer)
+    {
+        if (auto binding = uniform_bindings.find(uniform->get_name()); binding != uniform_bindings.end())
+        {
+            write_descriptor_sets.emplace_back(VkWriteDescriptorSet{
+                .sType            = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET,
+                .pNext            = nullptr,
+                .dstSet           = descriptor_sets[image_index],
+                .dstBinding       = binding->second,
+                .dstArrayElement  = 0,
+                .descriptorCount  = 1,
+                .descriptorType   = VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER,
+                .pImageInfo       = nullptr,
+                .pBufferInfo      = uniform->get_descriptor_buffer_info(static_cast<uint32_t>(image_index)),
+                .pTexelBufferView = nullptr,
+            });
+        }
+        else
+        {
+            LOG_ERROR("failed to find binding for uniform buffer");
+        }
+    }
+
+    for (const auto& ssbo : vertex_stage.storage_buffers)
+    {
+        if (auto binding = ssbo_bindings.find(ssbo->get_name()); binding != ssbo_bindings.end())
+        {
+            write_descriptor_sets.emplace_back(VkWriteDescriptorSet{
+                .sType            = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET,
+                .pNext            = nullptr,
+                .dstSet           = descriptor_sets[image_index],
+                .dstBinding       = binding->second,
+                .dstArrayElement  = 0,
+                .descriptorCount  = 1,
+                .descriptorType   = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER,
+                .pImageInfo       = nullptr,
+                .pBufferInfo      = ssbo->get_descriptor_buffer_info(static_cast<uint32_t>(image_index)),
+                .pTexelBufferView = nullptr,
+            });
+        }
+        else
+        {
+            LOG_ERROR("failed to find binding for ssbo buffer");
+        }
+    }
+
+    vkUpdateDescriptorSets(get_engine_interface()->get_gfx_context()->logical_device, static_cast<uint32_t>(write_descriptor_sets.size()), write_descriptor_sets.data(), 0, nullptr);
+}
+
+void ShadowMaterial::bind(VkCommandBuffer command_buffer, uint32_t image_index, uint32_t cascade, EVertexPositionFormat position_format) const
+{
+    vkCmdBindPipeline(command_buffer, VK_PIPELINE_BIND_POINT_GRAPHICS, get_pipeline(position_format));
+    vkCmdBindDescriptorSets(command_buffer, VK_PIPELINE_BIND_POINT_GRAPHICS, pipeline_layout, 0, 1, &descriptor_sets[image_index], 0, nullptr);
+    vkCmdPushConstants(command_buffer, pipeline_layout, VK_SHADER_STAGE_VERTEX_BIT, 0, sizeof(uint32_t), &cascade);
+}
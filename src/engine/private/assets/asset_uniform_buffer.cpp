@@ -8,10 +8,7 @@
 ShaderBuffer::~ShaderBuffer()
 {
     for (size_t i = 0; i < buffer.size(); i++)
-    {
-        vkDestroyBuffer(get_engine_interface()->get_gfx_context()->logical_device, buffer[i], vulkan_common::allocation_callback);
-        vkFreeMemory(get_engine_interface()->get_gfx_context()->logical_device, buffer_memory[i], vulkan_common::allocation_callback);
-    }
+        destroy_gpu_buffer(i);
 }
 
 VkDescriptorBufferInfo* ShaderBuffer::get_descriptor_buffer_info(uint32_t image_index)
@@ -19,31 +16,54 @@ VkDescriptorBufferInfo* ShaderBuffer::get_descriptor_buffer_info(uint32_t image_
     // Create missing buffers for current image
     if (image_index >= descriptor_buffer_info.size())
     {
-        buffer.resize(image_index + 1);
-        buffer_memory.resize(image_index + 1);
+        const size_t first_missing_buffer = descriptor_buffer_info.size();
+        buffer.resize(image_index + 1, VK_NULL_HANDLE);
+        buffer_memory.resize(image_index + 1, VK_NULL_HANDLE);
         descriptor_buffer_info.resize(image_index + 1);
-        dirty_buffers.resize(image_index + 1);
-
-        for (size_t i = descriptor_buffer_info.size() - 1; i <= image_index; ++i)
-        {
-            vulkan_utils::create_buffer(get_engine_interface()->get_gfx_context(), data_size, buffer_usage, VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT, buffer[i], buffer_memory[i]);
-
-            descriptor_buffer_info[i].buffer = buffer[i];
-            descriptor_buffer_info[i].offset = 0;
-            descriptor_buffer_info[i].range  = data_size;
+        dirty_ranges.resize(image_index + 1);
 
-            dirty_buffers[i] = true;
-        }
+        for (size_t i = first_missing_buffer; i <= image_index; ++i)
+            create_gpu_buffer(i);
+    }
+    // The buffer was resized since this image was last used : the previous frame using it is complete, so it can be recreated
+    else if (descriptor_buffer_info[image_index].range != data_size)
+    {
+        destroy_gpu_buffer(image_index);
+        create_gpu_buffer(image_index);
     }
 
-    if (dirty_buffers[image_index])
+    DirtyRange&  dirty_range = dirty_ranges[image_index];
+    const size_t upload_end  = std::min(dirty_range.end, data_size);
+    if (dirty_range.begin < upload_end)
     {
         void* memory_data;
-        vkMapMemory(get_engine_interface()->get_gfx_context()->logical_device, buffer_memory[image_index], 0, data_size, 0, &memory_data);
-        memcpy(memory_data, data, data_size);
+        vkMapMemory(get_engine_interface()->get_gfx_context()->logical_device, buffer_memory[image_index], dirty_range.begin, upload_end - dirty_range.begin, 0, &memory_data);
+        memcpy(memory_data, static_cast<char*>(data) + dirty_range.begin, upload_end - dirty_range.begin);
         vkUnmapMemory(get_engine_interface()->get_gfx_context()->logical_device, buffer_memory[image_index]);
-        dirty_buffers[image_index] = false;
     }
+    dirty_range = DirtyRange{};
 
     return &descriptor_buffer_info[image_index];
 }
+
+void ShaderBuffer::create_gpu_buffer(size_t image_index)
+{
+    vulkan_utils::create_buffer(get_engine_interface()->get_gfx_context(), data_size, buffer_usage, VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT, buffer[image_index],
+                                buffer_memory[image_index]);
+
+    descriptor_buffer_info[image_index].buffer = buffer[image_index];
+    descriptor_buffer_info[image_index].offset = 0;
+    descriptor_buffer_info[image_index].range  = data_size;
+
+    dirty_ranges[image_index] = DirtyRange{.begin = 0, .end = data_size};
+}
+
+void ShaderBuffer::destroy_gpu_buffer(size_t image_index)
+{
+    if (buffer[image_index] != VK_NULL_HANDLE)
+        vkDestroyBuffer(get_engine_interface()->get_gfx_context()->logical_device, buffer[image_index], vulkan_common::allocation_callback);
+    if (buffer_memory[image_index] != VK_NULL_HANDLE)
+        vkFreeMemory(get_engine_interface()->get_gfx_context()->logical_device, buffer_memory[image_index], vulkan_common::allocation_callback);
+    buffer[image_index]        = VK_NULL_HANDLE;
+    buffer_memory[image_index] = VK_NULL_HANDLE;
+}
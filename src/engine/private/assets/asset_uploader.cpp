@@ -0,0 +1,195 @@
+
+
+#include "assets/asset_uploader.h"
+
+#include "rendering/gfx_context.h"
+#include "rendering/vulkan/common.h"
+
+#include <cstring>
+
+AssetUploader::AssetUploader(GfxContext* in_gfx_context) : gfx_context(in_gfx_context)
+{
+    const vulkan_utils::QueueFamilyIndices& families = gfx_context->queue_families;
+
+    VkCommandPoolCreateInfo pool_info{};
+    pool_info.sType            = VK_STRUCTURE_TYPE_COMMAND_POOL_CREATE_INFO;
+    pool_info.queueFamilyIndex = families.transfert_family.value_or(families.graphic_family.value());
+    pool_info.flags            = VK_COMMAND_POOL_CREATE_RESET_COMMAND_BUFFER_BIT | VK_COMMAND_POOL_CREATE_TRANSIENT_BIT;
+    VK_ENSURE(vkCreateCommandPool(gfx_context->logical_device, &pool_info, vulkan_common::allocation_callback, &command_pool), "Failed to create upload command pool");
+}
+
+AssetUploader::~AssetUploader()
+{
+    std::lock_guard<std::mutex> lock(upload_lock);
+
+    for (Batch& batch : in_flight)
+    {
+        VK_ENSURE(vkWaitForFences(gfx_context->logical_device, 1, &batch.fence, VK_TRUE, UINT64_MAX), "Failed to wait upload fence");
+        release_batch(batch);
+        free_fences.emplace_back(batch.fence);
+    }
+    in_flight.clear();
+
+    // Never submitted : their destination may already be destroyed
+    for (const PendingCopy& copy : pending_copies)
+        vmaDestroyBuffer(gfx_context->vulkan_memory_allocator, copy.staging.buffer, copy.staging.allocation);
+    pending_copies.clear();
+
+    for (const VkFence fence : free_fences)
+        vkDestroyFence(gfx_context->logical_device, fence, vulkan_common::allocation_callback);
+    vkDestroyCommandPool(gfx_context->logical_device, command_pool, vulkan_common::allocation_callback);
+}
+
+void AssetUploader::create_buffer(VkDeviceSize size, VkBufferUsageFlags usage, VkBuffer& buffer, VmaAllocation& allocation) const
+{
+    const vulkan_utils::QueueFamilyIndices& families            = gfx_context->queue_families;
+    const uint32_t                          queue_families[]    = {families.graphic_family.value(), families.transfert_family.value_or(families.graphic_family.value())};
+    const bool                              b_separate_families = queue_families[0] != queue_families[1];
+
+    // Shared by both families : no ownership transfer is needed between the upload and the draws
+    VkBufferCreateInfo buffer_info{};
+    buffer_info.sType                 = VK_STRUCTURE_TYPE_BUFFER_CREATE_INFO;
+    buffer_info.size                  = size;
+    buffer_info.usage                 = usage | VK_BUFFER_USAGE_TRANSFER_DST_BIT;
+    buffer_info.sharingMode           = b_separate_families ? VK_SHARING_MODE_CONCURRENT : VK_SHARING_MODE_EXCLUSIVE;
+    buffer_info.queueFamilyIndexCount = b_separate_families ? 2 : 0;
+    buffer_info.pQueueFamilyIndices   = b_separate_families ? queue_families : nullptr;
+
+    VmaAllocationCreateInfo allocation_info{};
+    allocation_info.usage = VMA_MEMORY_USAGE_GPU_ONLY;
+    VK_ENSURE(vmaCreateBuffer(gfx_context->vulkan_memory_allocator, &buffer_info, &allocation_info, &buffer, &allocation, nullptr), "Failed to create device buffer");
+}
+
+uint64_t AssetUploader::upload_buffer(VkBuffer destination, const void* data, VkDeviceSize size, VkDeviceSize destination_offset)
+{
+    if (size == 0)
+        return 0;
+
+    // Filled by the calling thread : only the copy command is deferred
+    VkBufferCreateInfo buffer_info{};
+    buffer_info.sType       = VK_STRUCTURE_TYPE_BUFFER_CREATE_INFO;
+    buffer_info.size        = size;
+    buffer_info.usage       = VK_BUFFER_USAGE_TRANSFER_SRC_BIT;
+    buffer_info.sharingMode = VK_SHARING_MODE_EXCLUSIVE;
+
+    VmaAllocationCreateInfo allocation_create_info{};
+    allocation_create_info.usage = VMA_MEMORY_USAGE_CPU_ONLY;
+    allocation_create_info.flags = VMA_ALLOCATION_CREATE_MAPPED_BIT;
+
+    PendingCopy       copy{.staging = {.size = size}, .destination = destination, .destination_offset = destination_offset};
+    VmaAllocationInfo allocation_info{};
+    VK_ENSURE(vmaCreateBuffer(gfx_context->vulkan_memory_allocator, &buffer_info, &allocation_create_info, &copy.staging.buffer, &copy.staging.allocation, &allocation_info), "Failed to create staging buffer");
+    memcpy(allocation_info.pMappedData, data, static_cast<size_t>(size));
+    vmaFlushAllocation(gfx_context->vulkan_memory_allocator, copy.staging.allocation, 0, VK_WHOLE_SIZE);
+
+    pending_bytes += size;
+
+    std::lock_guard<std::mutex> lock(upload_lock);
+    pending_copies.emplace_back(copy);
+    return pending_ticket;
+}
+
+void AssetUploader::flush()
+{
+    std::lock_guard<std::mutex> lock(upload_lock);
+    release_completed();
+    submit_pending();
+}
+
+void AssetUploader::wait(uint64_t ticket)
+{
+    std::lock_guard<std::mutex> lock(upload_lock);
+    if (ticket >= pending_ticket)
+        submit_pending();
+
+    for (const Batch& batch : in_flight)
+    {
+        if (batch.ticket > ticket)
+            break;
+        VK_ENSURE(vkWaitForFences(gfx_context->logical_device, 1, &batch.fence, VK_TRUE, UINT64_MAX), "Failed to wait upload fence");
+    }
+    release_completed();
+}
+
+void AssetUploader::submit_pending()
+{
+    if (pending_copies.empty())
+        return;
+
+    Batch batch{.ticket = pending_ticket++};
+
+    if (free_commands.empty())
+    {
+        VkCommandBufferAllocateInfo alloc_info{};
+        alloc_info.sType              = VK_STRUCTURE_TYPE_COMMAND_BUFFER_ALLOCATE_INFO;
+        alloc_info.commandPool        = command_pool;
+        alloc_info.level              = VK_COMMAND_BUFFER_LEVEL_PRIMARY;
+        alloc_info.commandBufferCount = 1;
+        VK_ENSURE(vkAllocateCommandBuffers(gfx_context->logical_device, &alloc_info, &batch.command_buffer), "Failed to allocate upload command buffer");
+    }
+    else
+    {
+        batch.command_buffer = free_commands.back();
+        free_commands.pop_back();
+    }
+
+    if (free_fences.empty())
+    {
+        VkFenceCreateInfo fence_info{};
+        fence_info.sType = VK_STRUCTURE_TYPE_FENCE_CREATE_INFO;
+        VK_ENSURE(vkCreateFence(gfx_context->logical_device, &fence_info, vulkan_common::allocation_callback, &batch.fence), "Failed to create upload fence");
+    }
+    else
+    {
+        batch.fence = free_fences.back();
+        free_fences.pop_back();
+        VK_ENSURE(vkResetFences(gfx_context->logical_device, 1, &batch.fence), "Failed to reset upload fence");
+    }
+
+    VkCommandBufferBeginInfo begin_info{};
+    begin_info.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO;
+    begin_info.flags = VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT;
+    VK_ENSURE(vkBeginCommandBuffer(batch.command_buffer, &begin_info), "Failed to begin upload command buffer");
+
+    batch.staging_buffers.reserve(pending_copies.size());
+    for (const PendingCopy& copy : pending_copies)
+    {
+        const VkBufferCopy region{.srcOffset = 0, .dstOffset = copy.destination_offset, .size = copy.staging.size};
+        vkCmdCopyBuffer(batch.command_buffer, copy.staging.buffer, copy.destination, 1, &region);
+        batch.staging_buffers.emplace_back(copy.staging);
+    }
+    pending_copies.clear();
+
+    VK_ENSURE(vkEndCommandBuffer(batch.command_buffer), "Failed to end upload command buffer");
+
+    VkSubmitInfo submit_info{};
+    submit_info.sType              = VK_STRUCTURE_TYPE_SUBMIT_INFO;
+    submit_info.commandBufferCount = 1;
+    submit_info.pCommandBuffers    = &batch.command_buffer;
+    gfx_context->submit_transfert_queue(submit_info, batch.fence);
+
+    in_flight.emplace_back(std::move(batch));
+}
+
+void AssetUploader::release_completed()
+{
+    while (!in_flight.empty() && vkGetFenceStatus(gfx_context->logical_device, in_flight.front().fence) == VK_SUCCESS)
+    {
+        Batch& batch = in_flight.front();
+        release_batch(batch);
+        completed_ticket = batch.ticket;
+        free_commands.emplace_back(batch.command_buffer);
+        free_fences.emplace_back(batch.fence);
+        in_flight.pop_front();
+    }
+}
+
+void AssetUploader::release_batch(Batch& batch)
+{
+    for (const StagingBuffer& staging : batch.staging_buffers)
+    {
+        vmaDestroyBuffer(gfx_context->vulkan_memory_allocator, staging.buffer, staging.allocation);
+        pending_bytes -= staging.size;
+    }
+    batch.staging_buffers.clear();
+}
@@ -0,0 +1,165 @@
+
+
+#include "assets/geometry_pool.h"
+
+#include "assets/asset_uploader.h"
+#include "rendering/gfx_context.h"
+#include "rendering/vulkan/utils.h"
+#include "rendering/window.h"
+
+#include <algorithm>
+#include <cpputils/logger.hpp>
+
+namespace
+{
+uint32_t index_size(VkIndexType index_type)
+{
+    return index_type == VK_INDEX_TYPE_UINT16 ? sizeof(uint16_t) : sizeof(uint32_t);
+}
+
+void destroy_block(VmaAllocator allocator, GeometryBlock& block)
+{
+    vmaClearVirtualBlock(block.virtual_block);
+    vmaDestroyVirtualBlock(block.virtual_block);
+    vmaDestroyBuffer(allocator, block.buffer, block.allocation);
+}
+} // namespace
+
+void GeometryBlock::bind_vertex_buffers(VkCommandBuffer command_buffer, bool b_position_only) const
+{
+    const VkBuffer     buffers[] = {buffer, buffer};
+    const VkDeviceSize offsets[] = {0, attribute_offset};
+    vkCmdBindVertexBuffers(command_buffer, 0, b_position_only || vertex_layout.get_attribute_stride() == 0 ? 1 : 2, buffers, offsets);
+}
+
+void GeometryBlock::bind_index_buffer(VkCommandBuffer command_buffer) const
+{
+    vkCmdBindIndexBuffer(command_buffer, buffer, 0, index_type);
+}
+
+GeometryPool::~GeometryPool()
+{
+    // The meshes are destroyed first : anything left is released with its block
+    for (auto* blocks : {&vertex_blocks, &index_blocks})
+    {
+        for (const auto& block : *blocks)
+            destroy_block(gfx_context->vulkan_memory_allocator, *block);
+    }
+}
+
+GeometryAllocation GeometryPool::allocate(const VertexLayout& vertex_layout, uint32_t vertex_count, VkIndexType index_type, uint32_t index_count)
+{
+    std::lock_guard<std::mutex> lock(pool_lock);
+
+    GeometryAllocation allocation{.pool = this, .vertex_count = vertex_count, .index_count = index_count};
+    allocation.vertex_block = allocate_range(vertex_blocks, &vertex_layout, index_type, vertex_count, allocation.vertex_allocation, allocation.first_vertex);
+    allocation.index_block  = allocate_range(index_blocks, nullptr, index_type, index_count, allocation.index_allocation, allocation.first_index);
+
+    ++allocation_count;
+    used_bytes += static_cast<size_t>(vertex_count) * allocation.vertex_block->element_size + static_cast<size_t>(index_count) * allocation.index_block->element_size;
+    return allocation;
+}
+
+void GeometryPool::free(GeometryAllocation& allocation)
+{
+    if (!allocation.pool)
+        return;
+
+    std::lock_guard<std::mutex> lock(pool_lock);
+    vmaVirtualFree(allocation.vertex_block->virtual_block, allocation.vertex_allocation);
+    vmaVirtualFree(allocation.index_block->virtual_block, allocation.index_allocation);
+
+    --allocation_count;
+    used_bytes -= static_cast<size_t>(allocation.vertex_count) * allocation.vertex_block->element_size + static_cast<size_t>(allocation.index_count) * allocation.index_block->element_size;
+    release_if_empty(vertex_blocks, allocation.vertex_block);
+    release_if_empty(index_blocks, allocation.index_block);
+    allocation = {};
+}
+
+GeometryPoolStats GeometryPool::get_stats() const
+{
+    std::lock_guard<std::mutex> lock(pool_lock);
+
+    GeometryPoolStats stats{.block_count = vertex_blocks.size() + index_blocks.size(), .allocation_count = allocation_count, .used_bytes = used_bytes};
+    for (auto* blocks : {&vertex_blocks, &index_blocks})
+        for (const auto& block : *blocks)
+            stats.reserved_bytes += static_cast<size_t>(block->capacity) * block->element_size;
+    return stats;
+}
+
+GeometryBlock* GeometryPool::allocate_range(std::vector<std::unique_ptr<GeometryBlock>>& blocks, const VertexLayout* vertex_layout, VkIndexType index_type, uint32_t count,
+                                            VmaVirtualAllocation& out_allocation, uint32_t& out_first)
+{
+    // Sizes and offsets of the virtual blocks are in elements
+    const VmaVirtualAllocationCreateInfo allocation_info{.size = count, .alignment = 1};
+
+    for (const auto& block : blocks)
+    {
+        if (vertex_layout ? block->vertex_layout != *vertex_layout : block->index_type != index_type)
+            continue;
+
+        VkDeviceSize first = 0;
+        if (vmaVirtualAllocate(block->virtual_block, &allocation_info, &out_allocation, &first) == VK_SUCCESS)
+        {
+            out_first = static_cast<uint32_t>(first);
+            return block.get();
+        }
+    }
+
+    const uint32_t capacity = std::max(count, vertex_layout ? vertex_block_capacity : index_block_capacity);
+    blocks.emplace_back(create_block(vertex_layout, index_type, capacity));
+    GeometryBlock* block = blocks.back().get();
+
+    VkDeviceSize first = 0;
+    if (vmaVirtualAllocate(block->virtual_block, &allocation_info, &out_allocation, &first) != VK_SUCCESS)
+        LOG_FATAL("failed to allocate %u elements in a new geometry block", count);
+    out_first = static_cast<uint32_t>(first);
+    return block;
+}
+
+void GeometryPool::release_if_empty(std::vector<std::unique_ptr<GeometryBlock>>& blocks, GeometryBlock* block)
+{
+    if (vmaIsVirtualBlockEmpty(block->virtual_block) == VK_FALSE)
+        return;
+
+    const auto it = std::find_if(blocks.begin(), blocks.end(), [block](const std::unique_ptr<GeometryBlock>& other) { return other.get() == block; });
+    if (it == blocks.end())
+        return;
+
+    // Draws recorded before the last range was freed may still read the buffer. The callback outlives the pool if it is destroyed meanwhile.
+    std::shared_ptr<GeometryBlock> released = std::move(*it);
+    blocks.erase(it);
+    window->defer_destruction([allocator = gfx_context->vulkan_memory_allocator, released] { destroy_block(allocator, *released); });
+    LOG_INFO("release empty geometry block : %u elements", released->capacity);
+}
+
+std::unique_ptr<GeometryBlock> GeometryPool::create_block(const VertexLayout* vertex_layout, VkIndexType index_type, uint32_t capacity)
+{
+    auto block      = std::make_unique<GeometryBlock>();
+    block->capacity = capacity;
+
+    VkDeviceSize       size  = 0;
+    VkBufferUsageFlags usage = 0;
+    if (vertex_layout)
+    {
+        block->vertex_layout    = *vertex_layout;
+        block->element_size     = vertex_layout->get_position_stride() + vertex_layout->get_attribute_stride();
+        block->attribute_offset = (static_cast<VkDeviceSize>(capacity) * vertex_layout->get_position_stride() + 15) & ~VkDeviceSize(15);
+        size                    = block->attribute_offset + static_cast<VkDeviceSize>(capacity) * vertex_layout->get_attribute_stride();
+        usage                   = VK_BUFFER_USAGE_VERTEX_BUFFER_BIT;
+    }
+    else
+    {
+        block->index_type   = index_type;
+        block->element_size = index_size(index_type);
+        size                = static_cast<VkDeviceSize>(capacity) * block->element_size;
+        usage               = VK_BUFFER_USAGE_INDEX_BUFFER_BIT;
+    }
+    uploader->create_buffer(size, usage, block->buffer, block->allocation);
+
+    const VmaVirtualBlockCreateInfo virtual_block_info{.size = capacity};
+    VK_ENSURE(vmaCreateVirtualBlock(&virtual_block_info, &block->virtual_block), "Failed to create geometry virtual block");
+
+    LOG_INFO("create %s geometry block : %u elements, %llu KB", vertex_layout ? "vertex" : "index", capacity, static_cast<unsigned long long>(size / 1024));
+    return block;
+}
@@ -0,0 +1,136 @@
+
+
+#include "assets/vertex_layout.h"
+
+#include <array>
+#include <cmath>
+#include <cstring>
+
+namespace
+{
+enum EVertexLocation : uint32_t
+{
+    Position = 0,
+    Uv       = 1,
+    Color    = 2,
+    Normal   = 3,
+    Tangent  = 4,
+};
+
+// Octahedral projection of a unit vector, in [-1, 1]^2
+glm::vec2 encode_octahedral(glm::vec3 direction)
+{
+    const float length = std::abs(direction.x) + std::abs(direction.y) + std::abs(direction.z);
+    if (length <= 0.f)
+        return glm::vec2(0.f);
+    direction /= length;
+    if (direction.z >= 0.f)
+        return glm::vec2(direction);
+    return glm::vec2((1.f - std::abs(direction.y)) * (direction.x >= 0.f ? 1.f : -1.f), (1.f - std::abs(direction.x)) * (direction.y >= 0.f ? 1.f : -1.f));
+}
+
+uint16_t to_unorm16(float value)
+{
+    return static_cast<uint16_t>(std::round(glm::clamp(value, 0.f, 1.f) * 65535.f));
+}
+
+template <typename Value> void write(uint8_t*& cursor, const Value& value)
+{
+    memcpy(cursor, &value, sizeof(Value));
+    cursor += sizeof(Value);
+}
+} // namespace
+
+uint32_t VertexLayout::get_position_stride() const
+{
+    return position_format == EVertexPositionFormat::Float ? 3 * sizeof(float) : 4 * sizeof(uint16_t);
+}
+
+uint32_t VertexLayout::get_attribute_stride() const
+{
+    return (b_uv ? 4 : 0) + (b_color ? 4 : 0) + (b_normal ? 4 : 0) + (b_tangent ? 4 : 0);
+}
+
+std::vector<VkVertexInputBindingDescription> VertexLayout::get_binding_descriptions(bool b_position_only) const
+{
+    std::vector<VkVertexInputBindingDescription> bindings = {{.binding = 0, .stride = get_position_stride(), .inputRate = VK_VERTEX_INPUT_RATE_VERTEX}};
+    if (!b_position_only && get_attribute_stride() > 0)
+        bindings.emplace_back(VkVertexInputBindingDescription{.binding = 1, .stride = get_attribute_stride(), .inputRate = VK_VERTEX_INPUT_RATE_VERTEX});
+    return bindings;
+}
+
+std::vector<VkVertexInputAttributeDescription> VertexLayout::get_attribute_descriptions(bool b_position_only) const
+{
+    std::vector<VkVertexInputAttributeDescription> attributes = {{
+        .location = Position,
+        .binding  = 0,
+        .format   = position_format == EVertexPositionFormat::Float ? VK_FORMAT_R32G32B32_SFLOAT : VK_FORMAT_R16G16B16A16_UNORM,
+        .offset   = 0,
+    }};
+    if (b_position_only)
+        return attributes;
+
+    // Same order as encode()
+    uint32_t   offset    = 0;
+    const auto add_input = [&](bool b_enabled, uint32_t location, VkFormat format) {
+        if (!b_enabled)
+            return;
+        attributes.emplace_back(VkVertexInputAttributeDescription{.location = location, .binding = 1, .format = format, .offset = offset});
+        offset += 4;
+    };
+    add_input(b_uv, Uv, VK_FORMAT_R16G16_SFLOAT);
+    add_input(b_color, Color, VK_FORMAT_R8G8B8A8_UNORM);
+    add_input(b_normal, Normal, VK_FORMAT_R16G16_SNORM);
+    add_input(b_tangent, Tangent, VK_FORMAT_R16G16_SNORM);
+    return attributes;
+}
+
+glm::vec4 VertexLayout::get_position_scale(const Aabb& bounds) const
+{
+    if (position_format == EVertexPositionFormat::Float || !bounds.is_valid())
+        return glm::vec4(1.f);
+    return glm::vec4(bounds.max - bounds.min, 1.f);
+}
+
+glm::vec4 VertexLayout::get_position_offset(const Aabb& bounds) const
+{
+    if (position_format == EVertexPositionFormat::Float || !bounds.is_valid())
+        return glm::vec4(0.f);
+    return glm::vec4(bounds.min, 0.f);
+}
+
+void VertexLayout::encode(const std::vector<Vertex>& vertices, const Aabb& bounds, std::vector<uint8_t>& out_positions, std::vector<uint8_t>& out_attributes) const
+{
+    out_positions.resize(vertices.size() * get_position_stride());
+    out_attributes.resize(vertices.size() * get_attribute_stride());
+
+    const glm::vec3 offset           = glm::vec3(get_position_offset(bounds));
+    const glm::vec3 scale            = glm::vec3(get_position_scale(bounds));
+    const glm::vec3 inverse_scale    = glm::vec3(scale.x > 0.f ? 1.f / scale.x : 0.f, scale.y > 0.f ? 1.f / scale.y : 0.f, scale.z > 0.f ? 1.f / scale.z : 0.f);
+    uint8_t*        position_cursor  = out_positions.data();
+    uint8_t*        attribute_cursor = out_attributes.data();
+    for (const Vertex& vertex : vertices)
+    {
+        if (position_format == EVertexPositionFormat::Float)
+            write(position_cursor, vertex.pos);
+        else
+        {
+            const glm::vec3 normalized = (vertex.pos - offset) * inverse_scale;
+            write(position_cursor, std::array<uint16_t, 4>{to_unorm16(normalized.x), to_unorm16(normalized.y), to_unorm16(normalized.z), 0});
+        }
+
+        if (b_uv)
+            write(attribute_cursor, glm::packHalf2x16(vertex.uv));
+        if (b_color)
+            write(attribute_cursor, glm::packUnorm4x8(vertex.col));
+        if (b_normal)
+            write(attribute_cursor, glm::packSnorm2x16(encode_octahedral(vertex.norm)));
+        if (b_tangent)
+        {
+            // y is remapped to ]0, 1] and carries the sign of the bitangent : 15 bits of precision are left for it
+            const glm::vec2 tangent = encode_octahedral(vertex.tang);
+            const float     sign    = glm::dot(glm::cross(vertex.norm, vertex.tang), vertex.bitang) < 0.f ? -1.f : 1.f;
+            write(attribute_cursor, glm::packSnorm2x16(glm::vec2(tangent.x, glm::max(tangent.y * 0.5f + 0.5f, 1.f / 32767.f) * sign)));
+        }
+    }
+}
@@ -4,8 +4,12 @@
 
 #include "assets/asset_base.h"
 #include "imgui.h"
+#include "jobSystem/job_system.h"
+#include "scene/scene.h"
 #include "statsRecorder.h"
 
+#include <algorithm>
+
 AssetManager* IEngineInterface::get_asset_manager()
 {
     return asset_manager.get();
@@ -16,10 +20,59 @@ void IEngineInterface::close()
     glfwSetWindowShouldClose(get_window()->get_handle(), true);
 }
 
+void IEngineInterface::register_scene(Scene* scene)
+{
+    scenes.emplace_back(scene);
+}
+
+void IEngineInterface::unregister_scene(Scene* scene)
+{
+    std::erase(scenes, scene);
+}
+
 IEngineInterface::IEngineInterface() : last_delta_second_time(std::chrono::steady_clock::now())
 {
 }
 
+void IEngineInterface::start_simulation()
+{
+    // Slow frames slow the simulation down instead of requesting more and more steps
+    const double fixed_delta_second = get_fixed_delta_second();
+    simulation_accumulator          = std::min(simulation_accumulator + delta_second, fixed_delta_second * config::max_simulation_steps_per_frame);
+
+    const auto steps = static_cast<uint32_t>(simulation_accumulator / fixed_delta_second);
+    simulation_accumulator -= steps * fixed_delta_second;
+
+    // Used once these steps are published
+    pending_simulation_steps = steps;
+    pending_simulation_alpha = simulation_accumulator / fixed_delta_second;
+
+    if (steps == 0)
+        return;
+
+    simulation_job = job_system::new_job(
+        [this, steps, fixed_delta_second] {
+            BEGIN_NAMED_RECORD(SIMULATION);
+            for (uint32_t i = 0; i < steps; ++i)
+                simulation_tick(fixed_delta_second);
+            END_NAMED_RECORD(SIMULATION);
+        },
+        true);
+}
+
+void IEngineInterface::wait_simulation()
+{
+    if (simulation_job)
+    {
+        BEGIN_NAMED_RECORD(WAIT_SIMULATION);
+        simulation_job->wait();
+        simulation_job = nullptr;
+        END_NAMED_RECORD(WAIT_SIMULATION);
+    }
+    simulation_steps = pending_simulation_steps;
+    simulation_alpha = pending_simulation_alpha;
+}
+
 void IEngineInterface::run_main_task(WindowParameters window_parameters)
 {
     game_window    = std::make_unique<Window>(window_parameters);
@@ -33,18 +86,29 @@ void IEngineInterface::run_main_task(WindowParameters window_parameters)
 
     while (game_window->begin_frame())
     {
-        input_manager->poll_events(get_delta_second());
-
         const auto now         = std::chrono::steady_clock::now();
         delta_second           = static_cast<double>(std::chrono::duration_cast<std::chrono::nanoseconds>(now - last_delta_second_time).count()) / 1000000000.0;
         last_delta_second_time = now;
 
         BEGIN_NAMED_RECORD(DRAW_FRAME);
         game_window->wait_init_idle();
-        BEGIN_NAMED_RECORD(PRE_DRAW);
-        END_NAMED_RECORD(PRE_DRAW);
+
+        // Submit the asset uploads requested since the last frame and publish the loaded assets
+        BEGIN_NAMED_RECORD(UPDATE_ASSETS);
+        asset_manager->update();
+        END_NAMED_RECORD(UPDATE_ASSETS);
         auto render_context = game_window->prepare_frame();
+
+        // The simulation steps of this frame run on workers while the previous state is rendered.
+        // Input callbacks modify the scene : they are only dispatched while the simulation is not running.
+        wait_simulation();
+        input_manager->poll_events(get_delta_second());
+        BEGIN_NAMED_RECORD(PRE_DRAW);
         pre_draw();
+        END_NAMED_RECORD(PRE_DRAW);
+        for (Scene* scene : scenes)
+            scene->publish_render_records();
+        start_simulation();
         if (render_context.is_valid)
         {
             BEGIN_NAMED_RECORD(RENDER_SCENE);
@@ -81,6 +145,7 @@ void IEngineInterface::run_main_task(WindowParameters window_parameters)
         game_window->end_frame();
         END_NAMED_RECORD(DRAW_FRAME);
     }
+    wait_simulation();
     vkDeviceWaitIdle(get_window()->get_gfx_context()->logical_device);
 
     unload_resources();
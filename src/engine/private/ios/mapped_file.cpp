@@ -0,0 +1,81 @@
+
+
+#include "ios/mapped_file.h"
+
+#include <cpputils/logger.hpp>
+
+#if _WIN32
+#include <windows.h>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+#if _WIN32
+MappedFile::MappedFile(const std::filesystem::path& file_path)
+{
+    file_handle = CreateFileW(file_path.c_str(), GENERIC_READ, FILE_SHARE_READ, nullptr, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, nullptr);
+    if (file_handle == INVALID_HANDLE_VALUE)
+    {
+        file_handle = nullptr;
+        LOG_ERROR("failed to open %s", file_path.string().c_str());
+        return;
+    }
+
+    LARGE_INTEGER file_size;
+    if (!GetFileSizeEx(file_handle, &file_size) || file_size.QuadPart == 0)
+        return;
+    size = static_cast<size_t>(file_size.QuadPart);
+
+    mapping_handle = CreateFileMappingW(file_handle, nullptr, PAGE_READONLY, 0, 0, nullptr);
+    if (!mapping_handle)
+    {
+        LOG_ERROR("failed to map %s", file_path.string().c_str());
+        return;
+    }
+    data = static_cast<const uint8_t*>(MapViewOfFile(mapping_handle, FILE_MAP_READ, 0, 0, 0));
+}
+
+MappedFile::~MappedFile()
+{
+    if (data)
+        UnmapViewOfFile(data);
+    if (mapping_handle)
+        CloseHandle(mapping_handle);
+    if (file_handle)
+        CloseHandle(file_handle);
+}
+#else
+MappedFile::MappedFile(const std::filesystem::path& file_path)
+{
+    file_descriptor = open(file_path.c_str(), O_RDONLY);
+    if (file_descriptor < 0)
+    {
+        LOG_ERROR("failed to open %s", file_path.string().c_str());
+        return;
+    }
+
+    struct stat file_stat;
+    if (fstat(file_descriptor, &file_stat) != 0 || file_stat.st_size == 0)
+        return;
+    size = static_cast<size_t>(file_stat.st_size);
+
+    void* mapping = mmap(nullptr, size, PROT_READ, MAP_PRIVATE, file_descriptor, 0);
+    if (mapping == MAP_FAILED)
+    {
+        LOG_ERROR("failed to map %s", file_path.string().c_str());
+        return;
+    }
+    data = static_cast<const uint8_t*>(mapping);
+}
+
+MappedFile::~MappedFile()
+{
+    if (data)
+        munmap(const_cast<uint8_t*>(data), size);
+    if (file_descriptor >= 0)
+        close(file_descriptor);
+}
+#endif
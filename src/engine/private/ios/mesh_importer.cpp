@@ -3,6 +3,8 @@
 
 
 #include "assets/asset_mesh_data.h"
+#include "ios/mesh_optimizer.h"
+#include "ios/mesh_simplifier.h"
 #include "assimp/postprocess.h"
 #include "assimp/scene.h"
 
@@ -24,7 +26,7 @@ TAssetPtr<MeshData> MeshImporter::import_mesh(const std::filesystem::path& file_
     }
 
     int asset_index = 0;
-    while (asset_manager->find((asset_name + "_(" + std::to_string(asset_index) + ")").c_str()))
+    while (asset_manager->exists(asset_name + "_(" + std::to_string(asset_index) + ")"))
     {
         asset_index++;
     }
@@ -68,7 +70,7 @@ std::vector<std::string> MeshImporter::get_mesh_list(const std::filesystem::path
 }
 
 
-TAssetPtr<MeshData> MeshImporter::process_mesh(const AssetId& asset_id, AssetManager* asset_manager, aiMesh* mesh, size_t id)
+std::tuple<std::vector<Vertex>, std::vector<uint32_t>, std::vector<MeshLod>> MeshImporter::decode_mesh(const aiMesh* mesh)
 {
     std::vector<Vertex> vertex_group;
 
@@ -107,5 +109,23 @@ TAssetPtr<MeshData> MeshImporter::process_mesh(const AssetId& asset_id, AssetMan
         triangles[face_index + 2] = mesh->mFaces[i].mIndices[2];
     }
 
-    return asset_manager->create<MeshData>(asset_id, vertex_group, triangles);
+    // Lower lods are appended to the index buffer
+    std::vector<MeshLod> lods = mesh_simplifier::build_lod_chain(vertex_group, triangles, max_lod_count);
+
+    // Triangles reordered for the post transform cache and overdraw, then vertices for fetch locality
+    const mesh_optimizer::MeshOptimizationStats optimization = mesh_optimizer::optimize_mesh(vertex_group, triangles, lods);
+    LOG_INFO("optimized mesh %s : ACMR %.3f -> %.3f, ATVR %.3f -> %.3f", mesh->mName.C_Str(), optimization.before.acmr, optimization.after.acmr, optimization.before.atvr, optimization.after.atvr);
+
+    return {std::move(vertex_group), std::move(triangles), std::move(lods)};
+}
+
+TAssetPtr<MeshData> MeshImporter::process_mesh(const AssetId& asset_id, AssetManager* asset_manager, aiMesh* mesh, size_t id)
+{
+    auto [vertex_group, triangles, lods] = decode_mesh(mesh);
+    return asset_manager->create<MeshData>(asset_id, std::move(vertex_group), std::move(triangles), std::move(lods));
+}
+
+TAssetPtr<MeshData> MeshImporter::process_mesh_async(const AssetId& asset_id, AssetManager* asset_manager, const std::shared_ptr<Assimp::Importer>& owner, aiMesh* mesh)
+{
+    return asset_manager->create_async<MeshData>(asset_id, [owner, mesh] { return decode_mesh(mesh); });
 }
\ No newline at end of file
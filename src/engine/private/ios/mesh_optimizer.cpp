@@ -0,0 +1,318 @@
+
+
+#include "ios/mesh_optimizer.h"
+
+#include "assets/asset_mesh_data.h"
+
+#include <algorithm>
+#include <glm/glm.hpp>
+
+namespace
+{
+// FIFO post transform cache : a vertex is cached if less than cache_size misses happened since it was inserted
+struct FifoCache
+{
+    FifoCache(size_t vertex_count, uint32_t in_cache_size) : timestamps(vertex_count, 0), cache_size(in_cache_size), time(in_cache_size + 1)
+    {
+    }
+
+    [[nodiscard]] bool contains(uint32_t vertex) const
+    {
+        return time - timestamps[vertex] <= cache_size;
+    }
+
+    // Returns true on a miss
+    bool access(uint32_t vertex)
+    {
+        if (contains(vertex))
+            return false;
+        timestamps[vertex] = time++;
+        return true;
+    }
+
+    void flush()
+    {
+        time += cache_size + 1;
+    }
+
+    std::vector<uint32_t> timestamps;
+    uint32_t              cache_size;
+    uint32_t              time;
+};
+
+// Triangles around each vertex, stored contiguously (offsets[v] .. offsets[v + 1])
+struct Adjacency
+{
+    std::vector<uint32_t> offsets;
+    std::vector<uint32_t> triangles;
+
+    void build(const std::vector<uint32_t>& indices, size_t vertex_count)
+    {
+        offsets.assign(vertex_count + 1, 0);
+        for (const uint32_t index : indices)
+            ++offsets[index + 1];
+        for (size_t i = 1; i < offsets.size(); ++i)
+            offsets[i] += offsets[i - 1];
+
+        triangles.resize(indices.size());
+        std::vector<uint32_t> cursors(offsets.begin(), offsets.end() - 1);
+        for (size_t i = 0; i < indices.size(); ++i)
+            triangles[cursors[indices[i]]++] = static_cast<uint32_t>(i / 3);
+    }
+};
+
+struct Cluster
+{
+    uint32_t first_triangle = 0;
+    uint32_t end_triangle   = 0;
+    float    sort_key       = 0.f;
+};
+} // namespace
+
+namespace mesh_optimizer
+{
+VertexCacheStats analyze_vertex_cache(const std::vector<uint32_t>& indices, size_t vertex_count, uint32_t cache_size)
+{
+    if (indices.empty())
+        return {};
+
+    FifoCache         cache(vertex_count, cache_size);
+    std::vector<bool> referenced(vertex_count, false);
+    size_t            misses           = 0;
+    size_t            referenced_count = 0;
+    for (const uint32_t index : indices)
+    {
+        misses += cache.access(index) ? 1 : 0;
+        if (!referenced[index])
+        {
+            referenced[index] = true;
+            ++referenced_count;
+        }
+    }
+    return VertexCacheStats{
+        .acmr = static_cast<float>(misses) / static_cast<float>(indices.size() / 3),
+        .atvr = static_cast<float>(misses) / static_cast<float>(referenced_count),
+    };
+}
+
+std::vector<uint32_t> optimize_vertex_cache(const std::vector<uint32_t>& indices, size_t vertex_count, std::vector<uint32_t>& out_clusters, uint32_t cache_size)
+{
+    out_clusters.clear();
+    const size_t triangle_count = indices.size() / 3;
+    if (triangle_count == 0)
+        return indices;
+
+    Adjacency adjacency;
+    adjacency.build(indices, vertex_count);
+
+    // Triangles left to emit around each vertex
+    std::vector<uint32_t> live_triangles(vertex_count);
+    for (size_t v = 0; v < vertex_count; ++v)
+        live_triangles[v] = adjacency.offsets[v + 1] - adjacency.offsets[v];
+
+    std::vector<uint32_t> timestamps(vertex_count, 0);
+    uint32_t              time = cache_size + 1;
+    std::vector<bool>     emitted(triangle_count, false);
+    std::vector<uint32_t> dead_ends;  // Recently emitted vertices, to restart from when a fan has no neighbour left
+    std::vector<uint32_t> candidates; // Vertices of the last fan
+    uint32_t              cursor = 0; // Input order fallback once the dead end stack is exhausted
+
+    const auto skip_dead_end = [&]() -> int64_t {
+        while (!dead_ends.empty())
+        {
+            const uint32_t vertex = dead_ends.back();
+            dead_ends.pop_back();
+            if (live_triangles[vertex] > 0)
+                return vertex;
+        }
+        for (; cursor < vertex_count; ++cursor)
+            if (live_triangles[cursor] > 0)
+                return cursor;
+        return -1;
+    };
+
+    std::vector<uint32_t> result;
+    result.reserve(triangle_count * 3);
+    out_clusters.emplace_back(0);
+
+    int64_t fan = indices[0];
+    while (fan >= 0)
+    {
+        // Emit every triangle left around the fan vertex
+        candidates.clear();
+        for (uint32_t i = adjacency.offsets[fan]; i < adjacency.offsets[fan + 1]; ++i)
+        {
+            const uint32_t triangle = adjacency.triangles[i];
+            if (emitted[triangle])
+                continue;
+            emitted[triangle] = true;
+            for (int c = 0; c < 3; ++c)
+            {
+                const uint32_t vertex = indices[triangle * 3 + c];
+                result.emplace_back(vertex);
+                dead_ends.emplace_back(vertex);
+                candidates.emplace_back(vertex);
+                --live_triangles[vertex];
+                if (time - timestamps[vertex] > cache_size)
+                    timestamps[vertex] = time++;
+            }
+        }
+
+        // Next fan : the candidate that will stay in the cache the longest once its own triangles are emitted
+        int64_t next          = -1;
+        int64_t best_priority = -1;
+        for (const uint32_t vertex : candidates)
+        {
+            if (live_triangles[vertex] == 0)
+                continue;
+            int64_t priority = 0;
+            if (time - timestamps[vertex] + 2 * live_triangles[vertex] <= cache_size)
+                priority = time - timestamps[vertex];
+            if (priority > best_priority)
+            {
+                best_priority = priority;
+                next          = vertex;
+            }
+        }
+
+        // Dead end : the cache content is lost, the next run is a new cluster
+        if (next < 0)
+        {
+            next = skip_dead_end();
+            if (next >= 0)
+                out_clusters.emplace_back(static_cast<uint32_t>(result.size() / 3));
+        }
+        fan = next;
+    }
+
+    return result;
+}
+
+std::vector<uint32_t> optimize_overdraw(const std::vector<uint32_t>& indices, const std::vector<Vertex>& vertices, const std::vector<uint32_t>& clusters, float threshold, uint32_t cache_size)
+{
+    const auto triangle_count = static_cast<uint32_t>(indices.size() / 3);
+    if (triangle_count == 0 || clusters.empty())
+        return indices;
+
+    // Split the clusters where the next triangle misses every vertex anyway, if the part so far keeps a good enough ACMR
+    std::vector<Cluster> split_clusters;
+    FifoCache            cache(vertices.size(), cache_size);
+    for (size_t c = 0; c < clusters.size(); ++c)
+    {
+        const uint32_t first = clusters[c];
+        const uint32_t end   = c + 1 < clusters.size() ? clusters[c + 1] : triangle_count;
+
+        cache.flush();
+        size_t cluster_misses = 0;
+        for (uint32_t t = first * 3; t < end * 3; ++t)
+            cluster_misses += cache.access(indices[t]) ? 1 : 0;
+        const float max_misses_per_triangle = threshold * static_cast<float>(cluster_misses) / static_cast<float>(end - first);
+
+        cache.flush();
+        split_clusters.emplace_back(Cluster{.first_triangle = first, .end_triangle = end});
+        size_t split_misses = 0;
+        for (uint32_t t = first; t < end; ++t)
+        {
+            for (int i = 0; i < 3; ++i)
+                split_misses += cache.access(indices[t * 3 + i]) ? 1 : 0;
+            if (t + 1 == end || static_cast<float>(split_misses) > max_misses_per_triangle * static_cast<float>(t + 1 - split_clusters.back().first_triangle))
+                continue;
+            if (cache.contains(indices[t * 3 + 3]) || cache.contains(indices[t * 3 + 4]) || cache.contains(indices[t * 3 + 5]))
+                continue;
+
+            split_clusters.back().end_triangle = t + 1;
+            split_clusters.emplace_back(Cluster{.first_triangle = t + 1, .end_triangle = end});
+            split_misses = 0;
+            cache.flush();
+        }
+    }
+
+    // Area weighted centers and normals
+    const auto triangle_cross = [&](uint32_t t) {
+        const glm::vec3& a = vertices[indices[t * 3]].pos;
+        return glm::cross(vertices[indices[t * 3 + 1]].pos - a, vertices[indices[t * 3 + 2]].pos - a);
+    };
+    const auto triangle_center = [&](uint32_t t) {
+        return (vertices[indices[t * 3]].pos + vertices[indices[t * 3 + 1]].pos + vertices[indices[t * 3 + 2]].pos) / 3.f;
+    };
+
+    glm::vec3 mesh_center = glm::vec3(0.f);
+    float     mesh_area   = 0.f;
+    for (uint32_t t = 0; t < triangle_count; ++t)
+    {
+        const float area = glm::length(triangle_cross(t));
+        mesh_center += triangle_center(t) * area;
+        mesh_area += area;
+    }
+    if (mesh_area <= 0.f)
+        return indices;
+    mesh_center /= mesh_area;
+
+    // Clusters facing away from the center are in front of the others from most points of view
+    for (Cluster& cluster : split_clusters)
+    {
+        glm::vec3 center = glm::vec3(0.f);
+        glm::vec3 normal = glm::vec3(0.f);
+        float     area   = 0.f;
+        for (uint32_t t = cluster.first_triangle; t < cluster.end_triangle; ++t)
+        {
+            const glm::vec3 cross         = triangle_cross(t);
+            const float     triangle_area = glm::length(cross);
+            center += triangle_center(t) * triangle_area;
+            normal += cross;
+            area += triangle_area;
+        }
+        const float normal_length = glm::length(normal);
+        if (area > 0.f && normal_length > 0.f)
+            cluster.sort_key = glm::dot(center / area - mesh_center, normal / normal_length);
+    }
+    std::stable_sort(split_clusters.begin(), split_clusters.end(), [](const Cluster& left, const Cluster& right) { return left.sort_key > right.sort_key; });
+
+    std::vector<uint32_t> result;
+    result.reserve(indices.size());
+    for (const Cluster& cluster : split_clusters)
+        result.insert(result.end(), indices.begin() + cluster.first_triangle * 3, indices.begin() + cluster.end_triangle * 3);
+    return result;
+}
+
+void optimize_vertex_fetch(std::vector<Vertex>& vertices, std::vector<uint32_t>& indices)
+{
+    std::vector<uint32_t> remap(vertices.size(), UINT32_MAX);
+    std::vector<Vertex>   reordered;
+    reordered.reserve(vertices.size());
+    for (uint32_t& index : indices)
+    {
+        if (remap[index] == UINT32_MAX)
+        {
+            remap[index] = static_cast<uint32_t>(reordered.size());
+            reordered.emplace_back(vertices[index]);
+        }
+        index = remap[index];
+    }
+    vertices = std::move(reordered);
+}
+
+MeshOptimizationStats optimize_mesh(std::vector<Vertex>& vertices, std::vector<uint32_t>& indices, const std::vector<MeshLod>& lods)
+{
+    MeshOptimizationStats stats;
+    for (size_t l = 0; l < lods.size(); ++l)
+    {
+        const auto            lod_begin = indices.begin() + lods[l].first_index;
+        std::vector<uint32_t> lod_indices(lod_begin, lod_begin + lods[l].index_count);
+        if (l == 0)
+            stats.before = analyze_vertex_cache(lod_indices, vertices.size());
+
+        std::vector<uint32_t> clusters;
+        lod_indices = optimize_vertex_cache(lod_indices, vertices.size(), clusters);
+        lod_indices = optimize_overdraw(lod_indices, vertices, clusters);
+        std::copy(lod_indices.begin(), lod_indices.end(), lod_begin);
+
+        if (l == 0)
+            stats.after = analyze_vertex_cache(lod_indices, vertices.size());
+    }
+
+    // Lod 0 comes first in the index buffer : its vertices are the most fetched and get the lowest indices
+    optimize_vertex_fetch(vertices, indices);
+    return stats;
+}
+} // namespace mesh_optimizer
@@ -0,0 +1,325 @@
+
+
+#include "ios/mesh_simplifier.h"
+
+#include "assets/asset_mesh_data.h"
+
+#include <algorithm>
+#include <cfloat>
+#include <cmath>
+#include <cpputils/logger.hpp>
+#include <cstring>
+#include <glm/glm.hpp>
+#include <unordered_map>
+
+namespace
+{
+// Symmetric 4x4 matrix of the summed squared distances to a set of planes
+struct Quadric
+{
+    double a2 = 0, ab = 0, ac = 0, ad = 0;
+    double b2 = 0, bc = 0, bd = 0;
+    double c2 = 0, cd = 0;
+    double d2     = 0;
+    double weight = 0;
+
+    void add_plane(const glm::dvec3& normal, double distance, double plane_weight)
+    {
+        a2 += normal.x * normal.x * plane_weight;
+        ab += normal.x * normal.y * plane_weight;
+        ac += normal.x * normal.z * plane_weight;
+        ad += normal.x * distance * plane_weight;
+        b2 += normal.y * normal.y * plane_weight;
+        bc += normal.y * normal.z * plane_weight;
+        bd += normal.y * distance * plane_weight;
+        c2 += normal.z * normal.z * plane_weight;
+        cd += normal.z * distance * plane_weight;
+        d2 += distance * distance * plane_weight;
+        weight += plane_weight;
+    }
+
+    void add(const Quadric& other)
+    {
+        a2 += other.a2;
+        ab += other.ab;
+        ac += other.ac;
+        ad += other.ad;
+        b2 += other.b2;
+        bc += other.bc;
+        bd += other.bd;
+        c2 += other.c2;
+        cd += other.cd;
+        d2 += other.d2;
+        weight += other.weight;
+    }
+
+    // Weighted mean of the squared distances between the point and the planes
+    [[nodiscard]] double evaluate(const glm::dvec3& p) const
+    {
+        const double error = a2 * p.x * p.x + 2 * ab * p.x * p.y + 2 * ac * p.x * p.z + 2 * ad * p.x + b2 * p.y * p.y + 2 * bc * p.y * p.z + 2 * bd * p.y + c2 * p.z * p.z + 2 * cd * p.z + d2;
+        return weight > 0 ? std::abs(error) / weight : 0;
+    }
+};
+
+struct Collapse
+{
+    uint32_t from = 0;
+    uint32_t to   = 0;
+    double   cost = 0;
+};
+
+struct PositionHash
+{
+    size_t operator()(const glm::vec3& position) const
+    {
+        uint32_t bits[3];
+        std::memcpy(bits, &position, sizeof(bits));
+        return (bits[0] * 73856093u) ^ (bits[1] * 19349663u) ^ (bits[2] * 83492791u);
+    }
+};
+
+uint64_t make_edge_key(uint32_t a, uint32_t b)
+{
+    return a < b ? static_cast<uint64_t>(a) << 32 | b : static_cast<uint64_t>(b) << 32 | a;
+}
+
+// Triangles around each vertex, stored contiguously (offsets[v] .. offsets[v + 1])
+struct Adjacency
+{
+    std::vector<uint32_t> offsets;
+    std::vector<uint32_t> triangles;
+
+    void build(const std::vector<uint32_t>& indices, size_t vertex_count)
+    {
+        offsets.assign(vertex_count + 1, 0);
+        for (const uint32_t index : indices)
+            ++offsets[index + 1];
+        for (size_t i = 1; i < offsets.size(); ++i)
+            offsets[i] += offsets[i - 1];
+
+        triangles.resize(indices.size());
+        std::vector<uint32_t> cursors(offsets.begin(), offsets.end() - 1);
+        for (size_t i = 0; i < indices.size(); ++i)
+            triangles[cursors[indices[i]]++] = static_cast<uint32_t>(i / 3);
+    }
+};
+
+// Moving 'from' onto 'to' must not fold any of the remaining triangles around 'from'
+bool collapse_flips_triangles(const std::vector<uint32_t>& indices, const Adjacency& adjacency, const std::vector<glm::dvec3>& positions, uint32_t from, uint32_t to)
+{
+    for (uint32_t i = adjacency.offsets[from]; i < adjacency.offsets[from + 1]; ++i)
+    {
+        const uint32_t* triangle = &indices[adjacency.triangles[i] * 3];
+        if (triangle[0] == to || triangle[1] == to || triangle[2] == to)
+            continue; // Removed by the collapse
+
+        glm::dvec3 corners[3];
+        glm::dvec3 moved[3];
+        for (int c = 0; c < 3; ++c)
+        {
+            corners[c] = positions[triangle[c]];
+            moved[c]   = triangle[c] == from ? positions[to] : corners[c];
+        }
+        const glm::dvec3 normal       = glm::cross(corners[1] - corners[0], corners[2] - corners[0]);
+        const glm::dvec3 moved_normal = glm::cross(moved[1] - moved[0], moved[2] - moved[0]);
+
+        // Reject rotations above ~75 degrees
+        if (glm::dot(normal, moved_normal) < 0.25 * glm::length(normal) * glm::length(moved_normal))
+            return true;
+    }
+    return false;
+}
+} // namespace
+
+namespace mesh_simplifier
+{
+std::vector<uint32_t> simplify(const std::vector<Vertex>& vertices, const std::vector<uint32_t>& indices, size_t target_index_count, float target_error, float& out_error)
+{
+    out_error = 0.f;
+    if (indices.size() <= target_index_count || vertices.empty())
+        return indices;
+
+    // Weld vertices sharing the same position : the simplification works on positions, output indices keep the original attributes
+    std::vector<uint32_t>                                 welded(vertices.size());
+    std::vector<uint32_t>                                 representatives;
+    std::unordered_map<glm::vec3, uint32_t, PositionHash> position_map;
+    for (uint32_t i = 0; i < vertices.size(); ++i)
+    {
+        const auto [it, b_inserted] = position_map.try_emplace(vertices[i].pos, static_cast<uint32_t>(representatives.size()));
+        if (b_inserted)
+            representatives.emplace_back(i);
+        welded[i] = it->second;
+    }
+    const size_t position_count = representatives.size();
+
+    std::vector<glm::dvec3> positions(position_count);
+    for (size_t i = 0; i < position_count; ++i)
+        positions[i] = vertices[representatives[i]].pos;
+
+    std::vector<uint32_t> welded_indices(indices.size());
+    std::vector<uint32_t> output_indices = indices;
+    for (size_t i = 0; i < indices.size(); ++i)
+        welded_indices[i] = welded[indices[i]];
+
+    // Area weighted plane quadrics
+    std::vector<Quadric> quadrics(position_count);
+    for (size_t i = 0; i + 2 < welded_indices.size(); i += 3)
+    {
+        const glm::dvec3& p0     = positions[welded_indices[i]];
+        const glm::dvec3  normal = glm::cross(positions[welded_indices[i + 1]] - p0, positions[welded_indices[i + 2]] - p0);
+        const double      length = glm::length(normal);
+        if (length <= 0.0)
+            continue;
+        const glm::dvec3 unit_normal = normal / length;
+        for (int c = 0; c < 3; ++c)
+            quadrics[welded_indices[i + c]].add_plane(unit_normal, -glm::dot(unit_normal, p0), length * 0.5);
+    }
+
+    // Edges used by a single triangle are on an open border : moving their vertices would open holes
+    std::vector<bool> locked(position_count, false);
+    {
+        std::unordered_map<uint64_t, uint32_t> edge_usage;
+        for (size_t i = 0; i + 2 < welded_indices.size(); i += 3)
+            for (int c = 0; c < 3; ++c)
+                ++edge_usage[make_edge_key(welded_indices[i + c], welded_indices[i + (c + 1) % 3])];
+        for (const auto& [key, usage] : edge_usage)
+        {
+            if (usage == 1)
+            {
+                locked[static_cast<uint32_t>(key >> 32)]        = true;
+                locked[static_cast<uint32_t>(key & 0xFFFFFFFF)] = true;
+            }
+        }
+    }
+
+    const double          max_error_sq = static_cast<double>(target_error) * target_error;
+    double                error_sq     = 0;
+    Adjacency             adjacency;
+    std::vector<Collapse> collapses;
+    std::vector<uint64_t> edges;
+    std::vector<uint32_t> remap(position_count);
+    std::vector<bool>     touched(position_count);
+
+    while (welded_indices.size() > target_index_count)
+    {
+        adjacency.build(welded_indices, position_count);
+
+        edges.clear();
+        for (size_t i = 0; i + 2 < welded_indices.size(); i += 3)
+            for (int c = 0; c < 3; ++c)
+                edges.emplace_back(make_edge_key(welded_indices[i + c], welded_indices[i + (c + 1) % 3]));
+        std::sort(edges.begin(), edges.end());
+        edges.erase(std::unique(edges.begin(), edges.end()), edges.end());
+
+        // Collapse each edge onto its cheapest end
+        collapses.clear();
+        for (const uint64_t edge : edges)
+        {
+            const uint32_t a = static_cast<uint32_t>(edge >> 32);
+            const uint32_t b = static_cast<uint32_t>(edge & 0xFFFFFFFF);
+            if (locked[a] && locked[b])
+                continue;
+
+            Quadric merged = quadrics[a];
+            merged.add(quadrics[b]);
+            const double cost_a_to_b = locked[a] ? DBL_MAX : merged.evaluate(positions[b]);
+            const double cost_b_to_a = locked[b] ? DBL_MAX : merged.evaluate(positions[a]);
+            if (cost_a_to_b <= cost_b_to_a)
+                collapses.emplace_back(Collapse{.from = a, .to = b, .cost = cost_a_to_b});
+            else
+                collapses.emplace_back(Collapse{.from = b, .to = a, .cost = cost_b_to_a});
+        }
+        std::sort(collapses.begin(), collapses.end(), [](const Collapse& left, const Collapse& right) { return left.cost < right.cost; });
+
+        // Independent collapses : a vertex whose triangles changed during this pass is not moved again before the next one
+        for (uint32_t i = 0; i < position_count; ++i)
+            remap[i] = i;
+        std::fill(touched.begin(), touched.end(), false);
+
+        size_t collapse_count        = 0;
+        size_t estimated_index_count = welded_indices.size();
+        for (const Collapse& collapse : collapses)
+        {
+            if (collapse.cost > max_error_sq || estimated_index_count <= target_index_count)
+                break;
+            if (touched[collapse.from] || touched[collapse.to])
+                continue;
+            if (collapse_flips_triangles(welded_indices, adjacency, positions, collapse.from, collapse.to))
+                continue;
+
+            for (uint32_t i = adjacency.offsets[collapse.from]; i < adjacency.offsets[collapse.from + 1]; ++i)
+            {
+                const uint32_t* triangle = &welded_indices[adjacency.triangles[i] * 3];
+                for (int c = 0; c < 3; ++c)
+                    touched[triangle[c]] = true;
+                if (triangle[0] == collapse.to || triangle[1] == collapse.to || triangle[2] == collapse.to)
+                    estimated_index_count -= 3;
+            }
+
+            remap[collapse.from] = collapse.to;
+            quadrics[collapse.to].add(quadrics[collapse.from]);
+            error_sq = std::max(error_sq, collapse.cost);
+            ++collapse_count;
+        }
+
+        if (collapse_count == 0)
+            break;
+
+        // Apply the collapses and drop the degenerated triangles
+        size_t write = 0;
+        for (size_t i = 0; i + 2 < welded_indices.size(); i += 3)
+        {
+            uint32_t triangle[3];
+            for (int c = 0; c < 3; ++c)
+                triangle[c] = remap[welded_indices[i + c]];
+            if (triangle[0] == triangle[1] || triangle[1] == triangle[2] || triangle[0] == triangle[2])
+                continue;
+
+            for (int c = 0; c < 3; ++c)
+            {
+                // Moved corners take the attributes of the vertex they were collapsed on
+                output_indices[write + c] = triangle[c] == welded_indices[i + c] ? output_indices[i + c] : representatives[triangle[c]];
+                welded_indices[write + c] = triangle[c];
+            }
+            write += 3;
+        }
+        welded_indices.resize(write);
+        output_indices.resize(write);
+    }
+
+    out_error = static_cast<float>(std::sqrt(error_sq));
+    return output_indices;
+}
+
+std::vector<MeshLod> build_lod_chain(const std::vector<Vertex>& vertices, std::vector<uint32_t>& indices, size_t max_lod_count)
+{
+    std::vector<MeshLod> lods;
+    lods.emplace_back(MeshLod{.first_index = 0, .index_count = static_cast<uint32_t>(indices.size()), .error = 0.f});
+
+    // Below this amount of triangles, a lower lod doesn't save anything
+    constexpr size_t min_lod_index_count = 64 * 3;
+
+    std::vector<uint32_t> lod_indices(indices);
+    while (lods.size() < max_lod_count && lod_indices.size() > min_lod_index_count)
+    {
+        const size_t target_index_count = lod_indices.size() / 6 * 3;
+
+        float                 lod_error  = 0.f;
+        std::vector<uint32_t> simplified = simplify(vertices, lod_indices, target_index_count, FLT_MAX, lod_error);
+
+        // Locked borders and rejected flips can prevent the simplification from progressing
+        if (simplified.empty() || simplified.size() > lod_indices.size() * 3 / 4)
+            break;
+
+        lods.emplace_back(MeshLod{
+            .first_index = static_cast<uint32_t>(indices.size()),
+            .index_count = static_cast<uint32_t>(simplified.size()),
+            .error       = lods.back().error + lod_error, // Each lod is simplified from the previous one
+        });
+        indices.insert(indices.end(), simplified.begin(), simplified.end());
+        lod_indices = std::move(simplified);
+    }
+
+    return lods;
+}
+} // namespace mesh_simplifier
@@ -17,20 +17,36 @@
 #include "ui/window/windows/profiler.h"
 #include "assets/asset_mesh.h"
 
-std::shared_ptr<Node> SceneImporter::process_node(aiNode* ai_node, const std::shared_ptr<Node>& parent, Scene* context_scene)
+Node* SceneImporter::process_node(aiNode* ai_node, Node* parent, Scene* context_scene)
 {
-    auto base_node = create_node(ai_node, parent, context_scene);
+    // Iterative : deep hierarchies don't grow the call stack
+    std::vector<Node*>    nodes;
+    std::vector<uint32_t> parents;
 
-    for (const auto& ai_child : std::vector<aiNode*>(ai_node->mChildren, ai_node->mChildren + ai_node->mNumChildren))
+    struct PendingNode
     {
-        auto container_node = process_node(ai_child, base_node, context_scene);
-        container_node->attach_to(base_node);
+        aiNode*  ai_node;
+        uint32_t parent;
+    };
+    std::vector<PendingNode> pending = {{ai_node, UINT32_MAX}};
+    while (!pending.empty())
+    {
+        const PendingNode current = pending.back();
+        pending.pop_back();
+
+        const auto index = static_cast<uint32_t>(nodes.size());
+        create_node(current.ai_node, current.parent, nodes, parents, context_scene);
+        for (unsigned int i = 0; i < current.ai_node->mNumChildren; ++i)
+            pending.emplace_back(PendingNode{current.ai_node->mChildren[i], index});
     }
 
-    return base_node;
+    // Validated and attached at once, world transforms are computed once per node
+    if (!context_scene->attach_hierarchy(nodes, parents, parent))
+        return nullptr;
+    return nodes[0];
 }
 
-std::shared_ptr<Node> SceneImporter::create_node(aiNode* context, const std::shared_ptr<Node>& parent, Scene* context_scene)
+void SceneImporter::create_node(aiNode* context, uint32_t parent, std::vector<Node*>& nodes, std::vector<uint32_t>& parents, Scene* context_scene)
 {
     // Extract transformation
     aiVector3t<float> ai_scale;
@@ -38,25 +54,25 @@ std::shared_ptr<Node> SceneImporter::create_node(aiNode* context, const std::sha
     aiQuaternion      ai_rot;
     context->mTransformation.Decompose(ai_scale, ai_rot, ai_pos);
     const glm::dvec3 position(ai_pos.x, ai_pos.y, ai_pos.z);
-    const glm::dquat rotation(ai_rot.x, ai_rot.y, ai_rot.z, ai_rot.w);
+    const glm::dquat rotation(ai_rot.w, ai_rot.x, ai_rot.y, ai_rot.z);
     const glm::dvec3 scale(ai_scale.x, ai_scale.y, ai_scale.z);
 
-    auto node = context_scene->add_node<Node>();
-    if (parent)
-        node->attach_to(parent);
+    const auto node_index = static_cast<uint32_t>(nodes.size());
+    auto       node       = context_scene->add_node<Node>();
+    node->set_relative_transform(position, rotation, scale);
+    nodes.emplace_back(node);
+    parents.emplace_back(parent);
 
     for (size_t i = 0; i < context->mNumMeshes; ++i)
     {
-        auto mesh_node = context_scene->add_node<MeshNode>(meshes_refs[context->mMeshes[i]], TAssetPtr<Material>(asset_manager, "test_material"));
-        mesh_node->attach_to(node);
+        nodes.emplace_back(context_scene->add_node<MeshNode>(meshes_refs[context->mMeshes[i]], material));
+        parents.emplace_back(node_index);
     }
 
     LOG_INFO("meshes : %s / meshes : %d", context->mName.data, context->mNumMeshes);
-
-    return node;
 }
 
-std::shared_ptr<Node> SceneImporter::import_file(const std::filesystem::path& source_file, const std::string& asset_name, Scene* context_scene)
+Node* SceneImporter::import_file(const std::filesystem::path& source_file, const std::string& asset_name, Scene* context_scene)
 {
     BEGIN_NAMED_RECORD(IMPORT_SCENE_DATA);
     if (!exists(source_file) || !is_regular_file(source_file))
@@ -64,6 +80,7 @@ std::shared_ptr<Node> SceneImporter::import_file(const std::filesystem::path& so
         LOG_ERROR("file %s doens't exists", source_file.string().c_str());
         return nullptr;
     }
+    importer             = std::make_shared<Assimp::Importer>();
     const aiScene* scene = importer->ReadFile(source_file.string(), aiProcess_CalcTangentSpace | aiProcess_Triangulate | aiProcess_JoinIdenticalVertices | aiProcess_SortByPType);
 
     if (!scene)
@@ -88,8 +105,11 @@ std::shared_ptr<Node> SceneImporter::import_file(const std::filesystem::path& so
         material_refs[i] = process_material(scene->mMaterials[i], i);
         */
     for (size_t i = 0; i < scene->mNumMeshes; ++i)
-        meshes_refs[i] = MeshImporter::process_mesh(asset_manager->find_valid_asset_id(asset_name + "_" + scene->mMeshes[i]->mName.C_Str()), asset_manager, scene->mMeshes[i], i);
+        meshes_refs[i] = MeshImporter::process_mesh_async(asset_manager->find_valid_asset_id(asset_name + "_" + scene->mMeshes[i]->mName.C_Str()), asset_manager, importer, scene->mMeshes[i]);
+
 
+    // Resolved once for every mesh node
+    material = TAssetPtr<Material>(asset_manager, "test_material"_id);
 
     auto root_node = process_node(scene->mRootNode, nullptr, context_scene);
     return root_node;
@@ -30,6 +30,12 @@ void GfxContext::submit_graphic_queue(const VkSubmitInfo& submit_infos, VkFence
     VK_ENSURE(vkQueueSubmit(graphic_queue, 1, &submit_infos, submit_fence), "Failed to submit graphic queue");
 }
 
+void GfxContext::submit_transfert_queue(const VkSubmitInfo& submit_infos, VkFence submit_fence)
+{
+    std::lock_guard<std::mutex> lock(queue_access_lock);
+    VK_ENSURE(vkQueueSubmit(transfert_queue, 1, &submit_infos, submit_fence), "Failed to submit transfert queue");
+}
+
 VkResult GfxContext::submit_present_queue(const VkPresentInfoKHR& present_infos)
 {
     std::lock_guard<std::mutex> lock(queue_access_lock);
@@ -90,6 +96,8 @@ void GfxContext::create_logical_device(VkSurfaceKHR surface)
 
     std::vector<VkDeviceQueueCreateInfo> queueCreateInfos;
     std::set<uint32_t>                   unique_queue_families = {queue_families.graphic_family.value(), queue_families.present_family.value()};
+    if (queue_families.transfert_family.has_value())
+        unique_queue_families.insert(queue_families.transfert_family.value());
     float                                queue_priorities      = 1.0f;
     for (uint32_t queueFamily : unique_queue_families)
     {
@@ -107,8 +115,31 @@ void GfxContext::create_logical_device(VkSurfaceKHR surface)
     deviceFeatures.fillModeNonSolid  = VK_TRUE; // Wireframe
     deviceFeatures.geometryShader    = VK_TRUE;
 
+    // Optional Vulkan 1.2 features
+    VkPhysicalDeviceVulkan12Features supported_features_12{};
+    supported_features_12.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_VULKAN_1_2_FEATURES;
+    VkPhysicalDeviceFeatures2 supported_features{};
+    supported_features.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_FEATURES_2;
+    supported_features.pNext = &supported_features_12;
+    vkGetPhysicalDeviceFeatures2(physical_device, &supported_features);
+
+    VkPhysicalDeviceVulkan12Features device_features_12{};
+    device_features_12.sType             = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_VULKAN_1_2_FEATURES;
+    device_features_12.drawIndirectCount = supported_features_12.drawIndirectCount;
+    b_supports_draw_indirect_count       = supported_features_12.drawIndirectCount == VK_TRUE;
+    if (!b_supports_draw_indirect_count)
+        LOG_WARNING("drawIndirectCount is not supported : gpu culling will be disabled");
+
+    // Fragment invocations are counted around the main render pass, whose draws are recorded in secondary command buffers
+    deviceFeatures.pipelineStatisticsQuery = supported_features.features.pipelineStatisticsQuery;
+    deviceFeatures.inheritedQueries        = supported_features.features.inheritedQueries;
+    b_supports_pipeline_statistics         = supported_features.features.pipelineStatisticsQuery == VK_TRUE && supported_features.features.inheritedQueries == VK_TRUE;
+    if (!b_supports_pipeline_statistics)
+        LOG_WARNING("pipelineStatisticsQuery or inheritedQueries is not supported : fragment statistics will be disabled");
+
     VkDeviceCreateInfo createInfo{};
     createInfo.sType                   = VK_STRUCTURE_TYPE_DEVICE_CREATE_INFO;
+    createInfo.pNext                   = &device_features_12;
     createInfo.queueCreateInfoCount    = static_cast<uint32_t>(queueCreateInfos.size());
     createInfo.pQueueCreateInfos       = queueCreateInfos.data();
     createInfo.pEnabledFeatures        = &deviceFeatures;
@@ -66,4 +66,60 @@ VkCommandPool& Container::get()
     }
     LOG_FATAL("no command pool is available on current thread");
 }
+
+SecondaryContainer::SecondaryContainer(VkDevice logical_device, uint32_t queue, size_t frame_count) : context_logical_device(logical_device)
+{
+    thread_count = job_system::Worker::get_worker_count() + 1; // One for each worker, plus one for the main thread
+    pools.resize(frame_count * thread_count);
+    for (auto& thread_pool : pools)
+    {
+        VkCommandPoolCreateInfo pool_info{};
+        pool_info.sType            = VK_STRUCTURE_TYPE_COMMAND_POOL_CREATE_INFO;
+        pool_info.queueFamilyIndex = queue;
+        pool_info.flags            = VK_COMMAND_POOL_CREATE_TRANSIENT_BIT; // Command buffers are only released through pool reset
+        VK_ENSURE(vkCreateCommandPool(logical_device, &pool_info, vulkan_common::allocation_callback, &thread_pool.pool), "Failed to create secondary command pool");
+    }
+}
+
+SecondaryContainer::~SecondaryContainer()
+{
+    LOG_INFO("destroy secondary command pools");
+    for (const auto& thread_pool : pools)
+    {
+        vkDestroyCommandPool(context_logical_device, thread_pool.pool, vulkan_common::allocation_callback);
+    }
+}
+
+void SecondaryContainer::reset(size_t frame_id)
+{
+    for (size_t i = frame_id * thread_count; i < (frame_id + 1) * thread_count; ++i)
+    {
+        if (pools[i].used_count == 0)
+            continue;
+        VK_ENSURE(vkResetCommandPool(context_logical_device, pools[i].pool, 0), "Failed to reset secondary command pool");
+        pools[i].used_count = 0;
+    }
+}
+
+VkCommandBuffer SecondaryContainer::allocate(size_t frame_id)
+{
+    const job_system::Worker* worker       = job_system::Worker::get();
+    const size_t              thread_index = worker ? worker->get_worker_id() + 1 : 0;
+    ThreadPool&               thread_pool  = pools[frame_id * thread_count + thread_index];
+
+    if (thread_pool.used_count == thread_pool.command_buffers.size())
+    {
+        VkCommandBufferAllocateInfo alloc_info{};
+        alloc_info.sType              = VK_STRUCTURE_TYPE_COMMAND_BUFFER_ALLOCATE_INFO;
+        alloc_info.commandPool        = thread_pool.pool;
+        alloc_info.level              = VK_COMMAND_BUFFER_LEVEL_SECONDARY;
+        alloc_info.commandBufferCount = 1;
+
+        VkCommandBuffer command_buffer = VK_NULL_HANDLE;
+        VK_ENSURE(vkAllocateCommandBuffers(context_logical_device, &alloc_info, &command_buffer), "Failed to allocate secondary command buffer");
+        thread_pool.command_buffers.emplace_back(command_buffer);
+    }
+
+    return thread_pool.command_buffers[thread_pool.used_count++];
+}
 } // namespace command_pool
\ No newline at end of file
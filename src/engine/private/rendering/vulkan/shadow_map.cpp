@@ -0,0 +1,178 @@
+
+
+#include "rendering/vulkan/shadow_map.h"
+
+#include "rendering/gfx_context.h"
+#include "rendering/vulkan/common.h"
+
+#include <array>
+#include <cpputils/logger.hpp>
+
+ShadowMap::ShadowMap(GfxContext* in_gfx_context, uint32_t in_resolution, uint32_t in_layer_count) : gfx_context(in_gfx_context), resolution(in_resolution), layer_count(in_layer_count)
+{
+    LOG_INFO("create shadow map ( %d x %d, %d layers )", resolution, resolution, layer_count);
+
+    // Both formats are widely supported as sampled depth attachments, 16 bits are enough for orthographic cascades
+    format = vulkan_utils::find_texture_format({VK_FORMAT_D32_SFLOAT, VK_FORMAT_D16_UNORM}, VK_IMAGE_TILING_OPTIMAL, VK_FORMAT_FEATURE_DEPTH_STENCIL_ATTACHMENT_BIT | VK_FORMAT_FEATURE_SAMPLED_IMAGE_BIT,
+                                               gfx_context->physical_device);
+
+    create_render_pass();
+    create_image();
+    create_framebuffers();
+    create_sampler();
+
+    descriptor_image_info = VkDescriptorImageInfo{
+        .sampler     = sampler,
+        .imageView   = array_view,
+        .imageLayout = VK_IMAGE_LAYOUT_DEPTH_STENCIL_READ_ONLY_OPTIMAL,
+    };
+}
+
+ShadowMap::~ShadowMap()
+{
+    LOG_INFO("destroy shadow map");
+    for (const VkFramebuffer framebuffer : framebuffers)
+        vkDestroyFramebuffer(gfx_context->logical_device, framebuffer, vulkan_common::allocation_callback);
+    for (const VkImageView view : layer_views)
+        vkDestroyImageView(gfx_context->logical_device, view, vulkan_common::allocation_callback);
+    vkDestroySampler(gfx_context->logical_device, sampler, vulkan_common::allocation_callback);
+    vkDestroyImageView(gfx_context->logical_device, array_view, vulkan_common::allocation_callback);
+    vkDestroyImage(gfx_context->logical_device, image, vulkan_common::allocation_callback);
+    vkFreeMemory(gfx_context->logical_device, image_memory, vulkan_common::allocation_callback);
+    vkDestroyRenderPass(gfx_context->logical_device, render_pass, vulkan_common::allocation_callback);
+}
+
+void ShadowMap::create_render_pass()
+{
+    // The previous content of the layer is never needed
+    VkAttachmentDescription depth_attachment{};
+    depth_attachment.format         = format;
+    depth_attachment.samples        = VK_SAMPLE_COUNT_1_BIT;
+    depth_attachment.loadOp         = VK_ATTACHMENT_LOAD_OP_CLEAR;
+    depth_attachment.storeOp        = VK_ATTACHMENT_STORE_OP_STORE;
+    depth_attachment.stencilLoadOp  = VK_ATTACHMENT_LOAD_OP_DONT_CARE;
+    depth_attachment.stencilStoreOp = VK_ATTACHMENT_STORE_OP_DONT_CARE;
+    depth_attachment.initialLayout  = VK_IMAGE_LAYOUT_UNDEFINED;
+    depth_attachment.finalLayout    = VK_IMAGE_LAYOUT_DEPTH_STENCIL_READ_ONLY_OPTIMAL;
+
+    VkAttachmentReference depth_attachment_ref{};
+    depth_attachment_ref.attachment = 0;
+    depth_attachment_ref.layout     = VK_IMAGE_LAYOUT_DEPTH_STENCIL_ATTACHMENT_OPTIMAL;
+
+    VkSubpassDescription subpass{};
+    subpass.pipelineBindPoint       = VK_PIPELINE_BIND_POINT_GRAPHICS;
+    subpass.colorAttachmentCount    = 0;
+    subpass.pDepthStencilAttachment = &depth_attachment_ref;
+
+    std::array<VkSubpassDependency, 2> dependencies;
+    dependencies[0].srcSubpass      = VK_SUBPASS_EXTERNAL;                           // Previous frames sampling the layer
+    dependencies[0].dstSubpass      = 0;
+    dependencies[0].srcStageMask    = VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT;
+    dependencies[0].dstStageMask    = VK_PIPELINE_STAGE_EARLY_FRAGMENT_TESTS_BIT;
+    dependencies[0].srcAccessMask   = VK_ACCESS_SHADER_READ_BIT;
+    dependencies[0].dstAccessMask   = VK_ACCESS_DEPTH_STENCIL_ATTACHMENT_WRITE_BIT;
+    dependencies[0].dependencyFlags = 0; // Not by region : the main pass samples any texel of the layer
+
+    dependencies[1].srcSubpass      = 0;                                             // The main pass samples the layer
+    dependencies[1].dstSubpass      = VK_SUBPASS_EXTERNAL;
+    dependencies[1].srcStageMask    = VK_PIPELINE_STAGE_LATE_FRAGMENT_TESTS_BIT;
+    dependencies[1].dstStageMask    = VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT;
+    dependencies[1].srcAccessMask   = VK_ACCESS_DEPTH_STENCIL_ATTACHMENT_WRITE_BIT;
+    dependencies[1].dstAccessMask   = VK_ACCESS_SHADER_READ_BIT;
+    dependencies[1].dependencyFlags = 0;
+
+    VkRenderPassCreateInfo render_pass_info{};
+    render_pass_info.sType           = VK_STRUCTURE_TYPE_RENDER_PASS_CREATE_INFO;
+    render_pass_info.attachmentCount = 1;
+    render_pass_info.pAttachments    = &depth_attachment;
+    render_pass_info.subpassCount    = 1;
+    render_pass_info.pSubpasses      = &subpass;
+    render_pass_info.dependencyCount = static_cast<uint32_t>(dependencies.size());
+    render_pass_info.pDependencies   = dependencies.data();
+    VK_ENSURE(vkCreateRenderPass(gfx_context->logical_device, &render_pass_info, vulkan_common::allocation_callback, &render_pass), "Failed to create shadow render pass");
+}
+
+void ShadowMap::create_image()
+{
+    VkImageCreateInfo image_info{};
+    image_info.sType         = VK_STRUCTURE_TYPE_IMAGE_CREATE_INFO;
+    image_info.imageType     = VK_IMAGE_TYPE_2D;
+    image_info.extent        = VkExtent3D{resolution, resolution, 1};
+    image_info.mipLevels     = 1;
+    image_info.arrayLayers   = layer_count;
+    image_info.format        = format;
+    image_info.tiling        = VK_IMAGE_TILING_OPTIMAL;
+    image_info.initialLayout = VK_IMAGE_LAYOUT_UNDEFINED;
+    image_info.usage         = VK_IMAGE_USAGE_DEPTH_STENCIL_ATTACHMENT_BIT | VK_IMAGE_USAGE_SAMPLED_BIT;
+    image_info.samples       = VK_SAMPLE_COUNT_1_BIT;
+    image_info.sharingMode   = VK_SHARING_MODE_EXCLUSIVE;
+    VK_ENSURE(vkCreateImage(gfx_context->logical_device, &image_info, vulkan_common::allocation_callback, &image), "Failed to create shadow map image");
+
+    VkMemoryRequirements memory_requirements;
+    vkGetImageMemoryRequirements(gfx_context->logical_device, image, &memory_requirements);
+
+    VkMemoryAllocateInfo alloc_info{};
+    alloc_info.sType           = VK_STRUCTURE_TYPE_MEMORY_ALLOCATE_INFO;
+    alloc_info.allocationSize  = memory_requirements.size;
+    alloc_info.memoryTypeIndex = vulkan_utils::find_memory_type(gfx_context->physical_device, memory_requirements.memoryTypeBits, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT);
+    VK_ENSURE(vkAllocateMemory(gfx_context->logical_device, &alloc_info, vulkan_common::allocation_callback, &image_memory), "Failed to allocate shadow map memory");
+    vkBindImageMemory(gfx_context->logical_device, image, image_memory, 0);
+
+    VkImageViewCreateInfo view_info{};
+    view_info.sType                           = VK_STRUCTURE_TYPE_IMAGE_VIEW_CREATE_INFO;
+    view_info.image                           = image;
+    view_info.viewType                        = VK_IMAGE_VIEW_TYPE_2D_ARRAY;
+    view_info.format                          = format;
+    view_info.subresourceRange.aspectMask     = VK_IMAGE_ASPECT_DEPTH_BIT;
+    view_info.subresourceRange.baseMipLevel   = 0;
+    view_info.subresourceRange.levelCount     = 1;
+    view_info.subresourceRange.baseArrayLayer = 0;
+    view_info.subresourceRange.layerCount     = layer_count;
+    VK_ENSURE(vkCreateImageView(gfx_context->logical_device, &view_info, vulkan_common::allocation_callback, &array_view), "Failed to create shadow map view");
+
+    // One attachment view per cascade
+    layer_views.resize(layer_count);
+    view_info.viewType                    = VK_IMAGE_VIEW_TYPE_2D;
+    view_info.subresourceRange.layerCount = 1;
+    for (uint32_t layer = 0; layer < layer_count; ++layer)
+    {
+        view_info.subresourceRange.baseArrayLayer = layer;
+        VK_ENSURE(vkCreateImageView(gfx_context->logical_device, &view_info, vulkan_common::allocation_callback, &layer_views[layer]), "Failed to create shadow map layer view");
+    }
+}
+
+void ShadowMap::create_framebuffers()
+{
+    framebuffers.resize(layer_count);
+    for (uint32_t layer = 0; layer < layer_count; ++layer)
+    {
+        VkFramebufferCreateInfo framebuffer_info{};
+        framebuffer_info.sType           = VK_STRUCTURE_TYPE_FRAMEBUFFER_CREATE_INFO;
+        framebuffer_info.renderPass      = render_pass;
+        framebuffer_info.attachmentCount = 1;
+        framebuffer_info.pAttachments    = &layer_views[layer];
+        framebuffer_info.width           = resolution;
+        framebuffer_info.height          = resolution;
+        framebuffer_info.layers          = 1;
+        VK_ENSURE(vkCreateFramebuffer(gfx_context->logical_device, &framebuffer_info, vulkan_common::allocation_callback, &framebuffers[layer]), "Failed to create shadow map framebuffer");
+    }
+}
+
+void ShadowMap::create_sampler()
+{
+    // Linear filtering of the comparison results gives 2x2 pcf for free. Outside of the map is lit.
+    VkSamplerCreateInfo sampler_info{};
+    sampler_info.sType         = VK_STRUCTURE_TYPE_SAMPLER_CREATE_INFO;
+    sampler_info.magFilter     = VK_FILTER_LINEAR;
+    sampler_info.minFilter     = VK_FILTER_LINEAR;
+    sampler_info.mipmapMode    = VK_SAMPLER_MIPMAP_MODE_NEAREST;
+    sampler_info.addressModeU  = VK_SAMPLER_ADDRESS_MODE_CLAMP_TO_BORDER;
+    sampler_info.addressModeV  = VK_SAMPLER_ADDRESS_MODE_CLAMP_TO_BORDER;
+    sampler_info.addressModeW  = VK_SAMPLER_ADDRESS_MODE_CLAMP_TO_BORDER;
+    sampler_info.borderColor   = VK_BORDER_COLOR_FLOAT_OPAQUE_WHITE;
+    sampler_info.compareEnable = VK_TRUE;
+    sampler_info.compareOp     = VK_COMPARE_OP_LESS_OR_EQUAL;
+    sampler_info.minLod        = 0.f;
+    sampler_info.maxLod        = 1.f;
+    VK_ENSURE(vkCreateSampler(gfx_context->logical_device, &sampler_info, vulkan_common::allocation_callback, &sampler), "Failed to create shadow map sampler");
+}
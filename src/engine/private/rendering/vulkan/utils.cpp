@@ -70,24 +70,27 @@ namespace vulkan_utils
 		vkGetPhysicalDeviceQueueFamilyProperties(device, &queueFamilyCount, queueFamilies.data());
 
 		int i = 0;
+		bool b_dedicated_transfert = false;
 		for (const auto& queueFamily : queueFamilies) {
-			if (queueFamily.queueFlags & VK_QUEUE_GRAPHICS_BIT) {
+			if (!indices.graphic_family.has_value() && queueFamily.queueFlags & VK_QUEUE_GRAPHICS_BIT) {
 				indices.graphic_family = i;
 			}
 			if (!indices.transfert_family.has_value() && queueFamily.queueFlags & VK_QUEUE_TRANSFER_BIT) {
 				indices.transfert_family = i;
 			}
 
-			if (queueFamily.queueFlags == VK_QUEUE_TRANSFER_BIT) {
+			// Prefer a transfer only family (dma engine) : asset uploads then run beside the rendering
+			if (!b_dedicated_transfert && queueFamily.queueFlags & VK_QUEUE_TRANSFER_BIT && !(queueFamily.queueFlags & (VK_QUEUE_GRAPHICS_BIT | VK_QUEUE_COMPUTE_BIT))) {
 				indices.transfert_family = i;
+				b_dedicated_transfert = true;
 			}
 			VkBool32 presentSupport = false;
 			VK_ENSURE(vkGetPhysicalDeviceSurfaceSupportKHR(device, i, surface, &presentSupport), "failed to get physical device present support");
-			if (presentSupport) {
+			if (!indices.present_family.has_value() && presentSupport) {
 				indices.present_family = i;
 			}
 
-			if (indices.is_complete()) {
+			if (indices.is_complete() && b_dedicated_transfert) {
 				break;
 			}
 
@@ -51,7 +51,8 @@ Window::Window(WindowParameters window_parameters) : window_width(window_paramet
     gfx_context = std::make_unique<GfxContext>(surface);
 
     // Create window vulkan objects
-    command_pool = new command_pool::Container(gfx_context->logical_device, gfx_context->queue_families.graphic_family.value());
+    command_pool           = new command_pool::Container(gfx_context->logical_device, gfx_context->queue_families.graphic_family.value());
+    secondary_command_pool = new command_pool::SecondaryContainer(gfx_context->logical_device, gfx_context->queue_families.graphic_family.value(), config::max_frame_in_flight);
     LOG_INFO("finished window creation");
     setup_swapchain_property();
 
@@ -60,6 +61,7 @@ Window::Window(WindowParameters window_parameters) : window_width(window_paramet
     back_buffer = new Framebuffer(this, VkExtent2D{static_cast<uint32_t>(window_width), static_cast<uint32_t>(window_height)});
     create_command_buffer();
     create_fences_and_semaphores();
+    create_statistics_queries();
     descriptor_pool = new DescriptorPool(this);
 
     imgui_instance = new ImGuiInstance(this);
@@ -75,14 +77,17 @@ Window::~Window()
     window_map.erase(window_map.find(window_handle));
 
     gfx_context->wait_device();
+    flush_deferred_destructions();
 
     delete imgui_instance;
 
     delete descriptor_pool;
+    destroy_statistics_queries();
     destroy_fences_and_semaphores();
     destroy_command_buffer();
     delete back_buffer;
     destroy_render_pass();
+    delete secondary_command_pool;
     delete command_pool;
     gfx_context = nullptr;
     destroy_window_surface();
@@ -135,10 +140,43 @@ void Window::wait_init_idle()
 
     // Ensure all frame data are submitted
     vkWaitForFences(gfx_context->logical_device, 1, &in_flight_fences[current_frame_id], VK_TRUE, UINT64_MAX);
+    read_statistics_query(current_frame_id);
+
+    // Secondary command buffers and the resources released during this frame are not in use anymore
+    secondary_command_pool->reset(current_frame_id);
+    run_deferred_destructions(current_frame_id);
 
     END_NAMED_RECORD(WAIT_INIT_IDLE);
 }
 
+void Window::defer_destruction(std::function<void()> destroy)
+{
+    std::lock_guard<std::mutex> lock(deferred_destruction_lock);
+    if (deferred_destructions.size() != config::max_frame_in_flight)
+        deferred_destructions.resize(config::max_frame_in_flight);
+    deferred_destructions[current_frame_id].emplace_back(std::move(destroy));
+}
+
+void Window::run_deferred_destructions(size_t frame_id)
+{
+    // Destructions may defer new ones : they are run once this frame is complete again
+    std::vector<std::function<void()>> destructions;
+    {
+        std::lock_guard<std::mutex> lock(deferred_destruction_lock);
+        if (frame_id >= deferred_destructions.size())
+            return;
+        destructions.swap(deferred_destructions[frame_id]);
+    }
+    for (const auto& destroy : destructions)
+        destroy();
+}
+
+void Window::flush_deferred_destructions()
+{
+    for (size_t frame_id = 0; frame_id < deferred_destructions.size(); ++frame_id)
+        run_deferred_destructions(frame_id);
+}
+
 RenderContext Window::prepare_frame()
 {
     BEGIN_NAMED_RECORD(PREPARE_FRAME);
@@ -163,12 +201,14 @@ RenderContext Window::prepare_frame()
     images_in_flight[image_index] = in_flight_fences[current_frame_id];
 
     RenderContext render_context{
-        .is_valid       = true,
-        .command_buffer = command_buffers[image_index],
-        .framebuffer    = back_buffer->get(image_index),
-        .image_index    = image_index,
-        .res_x          = get_width(),
-        .res_y          = get_height(),
+        .is_valid               = true,
+        .command_buffer         = VK_NULL_HANDLE,
+        .primary_command_buffer = command_buffers[image_index],
+        .framebuffer            = back_buffer->get(image_index),
+        .image_index            = image_index,
+        .res_x                  = get_width(),
+        .res_y                  = get_height(),
+        .window                 = this,
     };
 
     /**
@@ -180,39 +220,13 @@ RenderContext Window::prepare_frame()
     begin_info.flags            = 0;       // Optional
     begin_info.pInheritanceInfo = nullptr; // Optional
 
-    if (vkBeginCommandBuffer(render_context.command_buffer, &begin_info) != VK_SUCCESS)
+    if (vkBeginCommandBuffer(render_context.primary_command_buffer, &begin_info) != VK_SUCCESS)
     {
         LOG_FATAL("Failed to create command buffer #%d", image_index);
     }
 
-    std::array<VkClearValue, 2> clear_values{};
-    clear_values[0].color        = {0.6f, 0.9f, 1.f, 1.0f};
-    clear_values[1].depthStencil = {1.0f, 0};
-
-    VkRenderPassBeginInfo render_pass_info{};
-    render_pass_info.sType             = VK_STRUCTURE_TYPE_RENDER_PASS_BEGIN_INFO;
-    render_pass_info.renderPass        = render_pass;
-    render_pass_info.framebuffer       = render_context.framebuffer;
-    render_pass_info.renderArea.offset = {0, 0};
-    render_pass_info.renderArea.extent = VkExtent2D{window_width, window_height};
-    render_pass_info.clearValueCount   = static_cast<uint32_t>(clear_values.size());
-    render_pass_info.pClearValues      = clear_values.data();
-
-    vkCmdBeginRenderPass(render_context.command_buffer, &render_pass_info, VK_SUBPASS_CONTENTS_INLINE);
-
-    // Set viewport and scissor params
-    VkViewport viewport;
-    viewport.x        = 0;
-    viewport.y        = 0;
-    viewport.width    = static_cast<float>(window_width);
-    viewport.height   = static_cast<float>(window_height);
-    viewport.minDepth = 0.0f;
-    viewport.maxDepth = 1.0f;
-    VkRect2D scissor;
-    scissor.extent = VkExtent2D{window_width, window_height};
-    scissor.offset = VkOffset2D{0, 0};
-    vkCmdSetViewport(render_context.command_buffer, 0, 1, &viewport);
-    vkCmdSetScissor(render_context.command_buffer, 0, 1, &scissor);
+    // The render pass begins in render_data() : work outside of it can still be recorded in the primary command buffer
+    render_context.command_buffer = begin_secondary_command_buffer(render_context);
 
     END_NAMED_RECORD(PREPARE_FRAME);
     return render_context;
@@ -238,8 +252,51 @@ void Window::render_data(RenderContext& render_context)
     /* End imgui draw stuff                                                 */
     /************************************************************************/
 
-    vkCmdEndRenderPass(render_context.command_buffer);
-    VK_ENSURE(vkEndCommandBuffer(render_context.command_buffer), "Failed to register command buffer #d", render_context.image_index);
+    VK_ENSURE(vkEndCommandBuffer(render_context.command_buffer), "Failed to register secondary command buffer #d", render_context.image_index);
+
+    // The main thread command buffer contains the ui : execute it last
+    submitted_secondary_command_buffers.emplace_back(render_context.command_buffer);
+
+    VkCommandBuffer primary_command_buffer = render_context.primary_command_buffer;
+
+    std::array<VkClearValue, 2> clear_values{};
+    clear_values[0].color        = {0.6f, 0.9f, 1.f, 1.0f};
+    clear_values[1].depthStencil = {1.0f, 0};
+
+    VkRenderPassBeginInfo render_pass_info{};
+    render_pass_info.sType             = VK_STRUCTURE_TYPE_RENDER_PASS_BEGIN_INFO;
+    render_pass_info.renderPass        = render_pass;
+    render_pass_info.framebuffer       = render_context.framebuffer;
+    render_pass_info.renderArea.offset = {0, 0};
+    render_pass_info.renderArea.extent = VkExtent2D{window_width, window_height};
+    render_pass_info.clearValueCount   = static_cast<uint32_t>(clear_values.size());
+    render_pass_info.pClearValues      = clear_values.data();
+
+    // The query is active for the whole render pass : the secondary command buffers inherit it
+    if (statistics_query_pool != VK_NULL_HANDLE)
+    {
+        vkCmdResetQueryPool(primary_command_buffer, statistics_query_pool, static_cast<uint32_t>(current_frame_id), 1);
+        vkCmdBeginQuery(primary_command_buffer, statistics_query_pool, static_cast<uint32_t>(current_frame_id), 0);
+        statistics_queries[current_frame_id] = StatisticsQuery{.b_recorded = true, .b_depth_prepass = !submitted_depth_prepass_command_buffers.empty()};
+    }
+
+    // Every draw is recorded in secondary command buffers (possibly from workers)
+    vkCmdBeginRenderPass(primary_command_buffer, &render_pass_info, VK_SUBPASS_CONTENTS_SECONDARY_COMMAND_BUFFERS);
+
+    if (!submitted_depth_prepass_command_buffers.empty())
+        vkCmdExecuteCommands(primary_command_buffer, static_cast<uint32_t>(submitted_depth_prepass_command_buffers.size()), submitted_depth_prepass_command_buffers.data());
+    submitted_depth_prepass_command_buffers.clear();
+
+    vkCmdNextSubpass(primary_command_buffer, VK_SUBPASS_CONTENTS_SECONDARY_COMMAND_BUFFERS);
+
+    vkCmdExecuteCommands(primary_command_buffer, static_cast<uint32_t>(submitted_secondary_command_buffers.size()), submitted_secondary_command_buffers.data());
+    submitted_secondary_command_buffers.clear();
+
+    vkCmdEndRenderPass(primary_command_buffer);
+
+    if (statistics_query_pool != VK_NULL_HANDLE)
+        vkCmdEndQuery(primary_command_buffer, statistics_query_pool, static_cast<uint32_t>(current_frame_id));
+    VK_ENSURE(vkEndCommandBuffer(primary_command_buffer), "Failed to register command buffer #d", render_context.image_index);
 
     /**
      * Submit queues
@@ -254,7 +311,7 @@ void Window::render_data(RenderContext& render_context)
     submitInfo.pWaitSemaphores                    = acquire_wait_semaphore;
     submitInfo.pWaitDstStageMask                  = wait_stage;
     submitInfo.commandBufferCount                 = 1;
-    submitInfo.pCommandBuffers                    = &render_context.command_buffer;
+    submitInfo.pCommandBuffers                    = &primary_command_buffer;
 
     VkSemaphore finished_semaphore[] = {render_finished_semaphores[current_frame_id]}; // This fence is used to tell when the gpu can present the submitted data
     submitInfo.signalSemaphoreCount  = 1;
@@ -292,6 +349,56 @@ void Window::render_data(RenderContext& render_context)
     }
 }
 
+VkCommandBuffer Window::begin_secondary_command_buffer(const RenderContext& render_context, uint32_t subpass) const
+{
+    return begin_secondary_command_buffer(render_pass, render_context.framebuffer, VkExtent2D{render_context.res_x, render_context.res_y}, subpass);
+}
+
+VkCommandBuffer Window::begin_secondary_command_buffer(VkRenderPass in_render_pass, VkFramebuffer framebuffer, VkExtent2D extent, uint32_t subpass) const
+{
+    VkCommandBuffer command_buffer = secondary_command_pool->allocate(current_frame_id);
+
+    VkCommandBufferInheritanceInfo inheritance_info{};
+    inheritance_info.sType              = VK_STRUCTURE_TYPE_COMMAND_BUFFER_INHERITANCE_INFO;
+    inheritance_info.renderPass         = in_render_pass;
+    inheritance_info.subpass            = subpass;
+    inheritance_info.framebuffer        = framebuffer;
+    inheritance_info.pipelineStatistics = statistics_query_pool != VK_NULL_HANDLE ? VK_QUERY_PIPELINE_STATISTIC_FRAGMENT_SHADER_INVOCATIONS_BIT : 0;
+
+    VkCommandBufferBeginInfo begin_info{};
+    begin_info.sType            = VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO;
+    begin_info.flags            = VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT | VK_COMMAND_BUFFER_USAGE_RENDER_PASS_CONTINUE_BIT;
+    begin_info.pInheritanceInfo = &inheritance_info;
+
+    VK_ENSURE(vkBeginCommandBuffer(command_buffer, &begin_info), "Failed to begin secondary command buffer");
+
+    // Dynamic states are not inherited from the primary command buffer
+    VkViewport viewport;
+    viewport.x        = 0;
+    viewport.y        = 0;
+    viewport.width    = static_cast<float>(extent.width);
+    viewport.height   = static_cast<float>(extent.height);
+    viewport.minDepth = 0.0f;
+    viewport.maxDepth = 1.0f;
+    VkRect2D scissor;
+    scissor.extent = extent;
+    scissor.offset = VkOffset2D{0, 0};
+    vkCmdSetViewport(command_buffer, 0, 1, &viewport);
+    vkCmdSetScissor(command_buffer, 0, 1, &scissor);
+
+    return command_buffer;
+}
+
+void Window::submit_secondary_command_buffers(const std::vector<VkCommandBuffer>& in_command_buffers)
+{
+    submitted_secondary_command_buffers.insert(submitted_secondary_command_buffers.end(), in_command_buffers.begin(), in_command_buffers.end());
+}
+
+void Window::submit_depth_prepass_command_buffers(const std::vector<VkCommandBuffer>& in_command_buffers)
+{
+    submitted_depth_prepass_command_buffers.insert(submitted_depth_prepass_command_buffers.end(), in_command_buffers.begin(), in_command_buffers.end());
+}
+
 bool Window::begin_frame()
 {
     return !glfwWindowShouldClose(window_handle);
@@ -358,6 +465,12 @@ void Window::create_or_recreate_render_pass()
     colorAttachmentResolveRef.attachment = 2;
     colorAttachmentResolveRef.layout     = VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL;
 
+    // Opaque geometry writes its depth first : the color subpass then only shades the visible fragments
+    VkSubpassDescription depth_prepass{};
+    depth_prepass.pipelineBindPoint       = VK_PIPELINE_BIND_POINT_GRAPHICS;
+    depth_prepass.colorAttachmentCount    = 0;
+    depth_prepass.pDepthStencilAttachment = &depthAttachmentRef;
+
     VkSubpassDescription subpass{};
     subpass.pipelineBindPoint       = VK_PIPELINE_BIND_POINT_GRAPHICS;
     subpass.colorAttachmentCount    = 1;
@@ -369,16 +482,16 @@ void Window::create_or_recreate_render_pass()
     subpass.preserveAttachmentCount = 0;       // Preserved attachments can be used to loop (and preserve) attachments through subpasses
     subpass.pPreserveAttachments    = nullptr; // (Preserve attachments not used by this example)
 
-    std::array<VkSubpassDependency, 2> dependencies;
+    std::array<VkSubpassDependency, 4> dependencies;
     dependencies[0].srcSubpass      = VK_SUBPASS_EXTERNAL;                           // Producer of the dependency
-    dependencies[0].dstSubpass      = 0;                                             // Consumer is our single subpass that will wait for the execution depdendency
+    dependencies[0].dstSubpass      = color_subpass;                                 // Consumer is the color subpass that will wait for the execution depdendency
     dependencies[0].srcStageMask    = VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT; // Match our pWaitDstStageMask when we vkQueueSubmit
     dependencies[0].dstStageMask    = VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT; // is a loadOp stage for color attachments
     dependencies[0].srcAccessMask   = 0;                                             // semaphore wait already does memory dependency for us
     dependencies[0].dstAccessMask   = VK_ACCESS_COLOR_ATTACHMENT_WRITE_BIT;          // is a loadOp CLEAR access mask for color attachments
     dependencies[0].dependencyFlags = VK_DEPENDENCY_BY_REGION_BIT;
 
-    dependencies[1].srcSubpass      = 0;                                             // Producer of the dependency is our single subpass
+    dependencies[1].srcSubpass      = color_subpass;                                 // Producer of the dependency is the color subpass
     dependencies[1].dstSubpass      = VK_SUBPASS_EXTERNAL;                           // Consumer are all commands outside of the renderpass
     dependencies[1].srcStageMask    = VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT; // is a storeOp stage for color attachments
     dependencies[1].dstStageMask    = VK_PIPELINE_STAGE_BOTTOM_OF_PIPE_BIT;          // Do not block any subsequent work
@@ -386,6 +499,22 @@ void Window::create_or_recreate_render_pass()
     dependencies[1].dstAccessMask   = 0;
     dependencies[1].dependencyFlags = VK_DEPENDENCY_BY_REGION_BIT;
 
+    dependencies[2].srcSubpass      = VK_SUBPASS_EXTERNAL; // The previous frame is done with the depth buffer before it is cleared
+    dependencies[2].dstSubpass      = depth_prepass_subpass;
+    dependencies[2].srcStageMask    = VK_PIPELINE_STAGE_LATE_FRAGMENT_TESTS_BIT;
+    dependencies[2].dstStageMask    = VK_PIPELINE_STAGE_EARLY_FRAGMENT_TESTS_BIT;
+    dependencies[2].srcAccessMask   = VK_ACCESS_DEPTH_STENCIL_ATTACHMENT_WRITE_BIT;
+    dependencies[2].dstAccessMask   = VK_ACCESS_DEPTH_STENCIL_ATTACHMENT_READ_BIT | VK_ACCESS_DEPTH_STENCIL_ATTACHMENT_WRITE_BIT;
+    dependencies[2].dependencyFlags = VK_DEPENDENCY_BY_REGION_BIT;
+
+    dependencies[3].srcSubpass      = depth_prepass_subpass; // The color subpass tests against the pre-pass depth
+    dependencies[3].dstSubpass      = color_subpass;
+    dependencies[3].srcStageMask    = VK_PIPELINE_STAGE_LATE_FRAGMENT_TESTS_BIT;
+    dependencies[3].dstStageMask    = VK_PIPELINE_STAGE_EARLY_FRAGMENT_TESTS_BIT;
+    dependencies[3].srcAccessMask   = VK_ACCESS_DEPTH_STENCIL_ATTACHMENT_WRITE_BIT;
+    dependencies[3].dstAccessMask   = VK_ACCESS_DEPTH_STENCIL_ATTACHMENT_READ_BIT | VK_ACCESS_DEPTH_STENCIL_ATTACHMENT_WRITE_BIT;
+    dependencies[3].dependencyFlags = VK_DEPENDENCY_BY_REGION_BIT;
+
     std::vector<VkAttachmentDescription> attachments;
 
     if (msaa_sample_count > 1)
@@ -403,8 +532,9 @@ void Window::create_or_recreate_render_pass()
     renderPassInfo.sType           = VK_STRUCTURE_TYPE_RENDER_PASS_CREATE_INFO;
     renderPassInfo.attachmentCount = static_cast<uint32_t>(attachments.size());
     renderPassInfo.pAttachments    = attachments.data();
-    renderPassInfo.subpassCount    = 1;
-    renderPassInfo.pSubpasses      = &subpass;
+    const std::array<VkSubpassDescription, 2> subpasses = {depth_prepass, subpass};
+    renderPassInfo.subpassCount                         = static_cast<uint32_t>(subpasses.size());
+    renderPassInfo.pSubpasses                           = subpasses.data();
     renderPassInfo.dependencyCount = static_cast<uint32_t>(dependencies.size());
     renderPassInfo.pDependencies   = dependencies.data();
     VK_ENSURE(vkCreateRenderPass(gfx_context->logical_device, &renderPassInfo, vulkan_common::allocation_callback, &render_pass), "Failed to create render pass");
@@ -446,6 +576,47 @@ void Window::create_fences_and_semaphores()
     }
 }
 
+void Window::create_statistics_queries()
+{
+    statistics_queries.resize(config::max_frame_in_flight);
+    fragment_stats.b_available = gfx_context->b_supports_pipeline_statistics;
+    if (!fragment_stats.b_available)
+        return;
+
+    VkQueryPoolCreateInfo query_pool_info{};
+    query_pool_info.sType              = VK_STRUCTURE_TYPE_QUERY_POOL_CREATE_INFO;
+    query_pool_info.queryType          = VK_QUERY_TYPE_PIPELINE_STATISTICS;
+    query_pool_info.queryCount         = config::max_frame_in_flight;
+    query_pool_info.pipelineStatistics = VK_QUERY_PIPELINE_STATISTIC_FRAGMENT_SHADER_INVOCATIONS_BIT;
+    VK_ENSURE(vkCreateQueryPool(gfx_context->logical_device, &query_pool_info, vulkan_common::allocation_callback, &statistics_query_pool), "Failed to create pipeline statistics query pool");
+}
+
+void Window::read_statistics_query(size_t frame_id)
+{
+    StatisticsQuery& query = statistics_queries[frame_id];
+    if (statistics_query_pool == VK_NULL_HANDLE || !query.b_recorded)
+        return;
+    query.b_recorded = false;
+
+    // The frame's fence is signaled : the result is available without waiting
+    uint64_t invocations = 0;
+    if (vkGetQueryPoolResults(gfx_context->logical_device, statistics_query_pool, static_cast<uint32_t>(frame_id), 1, sizeof(invocations), &invocations, sizeof(invocations), VK_QUERY_RESULT_64_BIT) != VK_SUCCESS)
+        return;
+
+    fragment_stats.invocations = invocations;
+    if (query.b_depth_prepass)
+        fragment_stats.invocations_with_prepass = invocations;
+    else
+        fragment_stats.invocations_without_prepass = invocations;
+}
+
+void Window::destroy_statistics_queries()
+{
+    if (statistics_query_pool != VK_NULL_HANDLE)
+        vkDestroyQueryPool(gfx_context->logical_device, statistics_query_pool, vulkan_common::allocation_callback);
+    statistics_query_pool = VK_NULL_HANDLE;
+}
+
 void Window::destroy_fences_and_semaphores()
 {
     LOG_INFO("destroy fence and semaphores");
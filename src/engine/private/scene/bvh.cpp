@@ -0,0 +1,254 @@
+
+
+#include "scene/bvh.h"
+
+#include <algorithm>
+#include <numeric>
+
+Aabb Aabb::transformed(const glm::mat4& transform) const
+{
+    Aabb result;
+    if (!is_valid())
+        return result;
+    for (int corner = 0; corner < 8; ++corner)
+    {
+        const glm::vec3 point(corner & 1 ? max.x : min.x, corner & 2 ? max.y : min.y, corner & 4 ? max.z : min.z);
+        result.grow(glm::vec3(transform * glm::vec4(point, 1.f)));
+    }
+    return result;
+}
+
+float Bvh::intersect(const Aabb& box, const glm::vec3& origin, const glm::vec3& inverse_direction, float max_distance)
+{
+    const glm::vec3 t0    = (box.min - origin) * inverse_direction;
+    const glm::vec3 t1    = (box.max - origin) * inverse_direction;
+    const glm::vec3 t_min = glm::min(t0, t1);
+    const glm::vec3 t_max = glm::max(t0, t1);
+
+    const float entry = std::max(std::max(t_min.x, t_min.y), std::max(t_min.z, 0.f));
+    const float exit  = std::min(std::min(t_max.x, t_max.y), std::min(t_max.z, max_distance));
+    return entry <= exit ? entry : FLT_MAX;
+}
+
+void Bvh::build(const std::vector<Aabb>& primitive_bounds)
+{
+    nodes.clear();
+    primitives.resize(primitive_bounds.size());
+    std::iota(primitives.begin(), primitives.end(), 0);
+    if (primitive_bounds.empty())
+        return;
+
+    std::vector<glm::vec3> centers(primitive_bounds.size());
+    for (size_t i = 0; i < primitive_bounds.size(); ++i)
+        centers[i] = primitive_bounds[i].get_center();
+
+    struct PendingNode
+    {
+        uint32_t node;
+        uint32_t depth;
+    };
+
+    nodes.reserve(primitive_bounds.size() * 2);
+    nodes.emplace_back(BvhNode{.first = 0, .count = static_cast<uint32_t>(primitives.size())});
+    std::vector<PendingNode> pending = {{0, 0}};
+    while (!pending.empty())
+    {
+        const PendingNode current = pending.back();
+        pending.pop_back();
+
+        const uint32_t first = nodes[current.node].first;
+        const uint32_t count = nodes[current.node].count;
+
+        Aabb bounds;
+        Aabb center_bounds;
+        for (uint32_t i = first; i < first + count; ++i)
+        {
+            bounds.grow(primitive_bounds[primitives[i]]);
+            center_bounds.grow(centers[primitives[i]]);
+        }
+        nodes[current.node].bounds = bounds;
+
+        if (count <= 1)
+            continue;
+
+        // Find the cheapest bin boundary along the three axes
+        const glm::vec3 center_extent = center_bounds.max - center_bounds.min;
+        int             split_axis    = -1;
+        uint32_t        split_bin     = 0;
+        float           split_cost    = static_cast<float>(count) * bounds.get_surface_area(); // Cost of keeping a leaf
+        for (int axis = 0; axis < 3 && current.depth < max_sah_depth; ++axis)
+        {
+            if (center_extent[axis] <= 0.f)
+                continue;
+
+            Aabb        bin_bounds[bin_count];
+            uint32_t    bin_counts[bin_count] = {};
+            const float bin_scale             = bin_count / center_extent[axis];
+            for (uint32_t i = first; i < first + count; ++i)
+            {
+                const auto bin = std::min(static_cast<uint32_t>((centers[primitives[i]][axis] - center_bounds.min[axis]) * bin_scale), bin_count - 1);
+                bin_bounds[bin].grow(primitive_bounds[primitives[i]]);
+                ++bin_counts[bin];
+            }
+
+            // Sweep from the right to get the cost of every right side, then from the left
+            float    right_costs[bin_count];
+            Aabb     right_bounds;
+            uint32_t right_count = 0;
+            for (uint32_t bin = bin_count - 1; bin > 0; --bin)
+            {
+                right_bounds.grow(bin_bounds[bin]);
+                right_count += bin_counts[bin];
+                right_costs[bin] = static_cast<float>(right_count) * right_bounds.get_surface_area();
+            }
+
+            Aabb     left_bounds;
+            uint32_t left_count = 0;
+            for (uint32_t bin = 1; bin < bin_count; ++bin)
+            {
+                left_bounds.grow(bin_bounds[bin - 1]);
+                left_count += bin_counts[bin - 1];
+                const float cost = traversal_cost * bounds.get_surface_area() + static_cast<float>(left_count) * left_bounds.get_surface_area() + right_costs[bin];
+                if (left_count > 0 && left_count < count && cost < split_cost)
+                {
+                    split_cost = cost;
+                    split_axis = axis;
+                    split_bin  = bin;
+                }
+            }
+        }
+
+        uint32_t left_count;
+        if (split_axis >= 0)
+        {
+            const float bin_scale = bin_count / center_extent[split_axis];
+            const auto  middle    = std::partition(primitives.begin() + first, primitives.begin() + first + count, [&](uint32_t primitive) {
+                return std::min(static_cast<uint32_t>((centers[primitive][split_axis] - center_bounds.min[split_axis]) * bin_scale), bin_count - 1) < split_bin;
+            });
+            left_count = static_cast<uint32_t>(middle - primitives.begin()) - first;
+        }
+        else if (count > max_leaf_size)
+        {
+            // No split beats a leaf but the leaf is too large (or the tree too deep) : split at the median of the largest axis
+            int axis = 0;
+            if (center_extent.y > center_extent[axis])
+                axis = 1;
+            if (center_extent.z > center_extent[axis])
+                axis = 2;
+            left_count = count / 2;
+            std::nth_element(primitives.begin() + first, primitives.begin() + first + left_count, primitives.begin() + first + count,
+                             [&](uint32_t a, uint32_t b) { return centers[a][axis] < centers[b][axis]; });
+        }
+        else
+            continue;
+
+        const auto left_child     = static_cast<uint32_t>(nodes.size());
+        nodes[current.node].first = left_child;
+        nodes[current.node].count = 0;
+        nodes.emplace_back(BvhNode{.first = first, .count = left_count});
+        nodes.emplace_back(BvhNode{.first = first + left_count, .count = count - left_count});
+        pending.emplace_back(PendingNode{left_child, current.depth + 1});
+        pending.emplace_back(PendingNode{left_child + 1, current.depth + 1});
+    }
+}
+
+void Bvh::refit(const std::vector<Aabb>& primitive_bounds)
+{
+    // Children are always stored after their parent
+    for (size_t i = nodes.size(); i-- > 0;)
+    {
+        BvhNode& node = nodes[i];
+        node.bounds   = {};
+        if (node.count > 0)
+        {
+            for (uint32_t primitive = node.first; primitive < node.first + node.count; ++primitive)
+                node.bounds.grow(primitive_bounds[primitives[primitive]]);
+        }
+        else
+        {
+            node.bounds.grow(nodes[node.first].bounds);
+            node.bounds.grow(nodes[node.first + 1].bounds);
+        }
+    }
+}
+
+float Bvh::get_cost() const
+{
+    if (nodes.empty())
+        return 0.f;
+
+    float cost = 0.f;
+    for (const BvhNode& node : nodes)
+        cost += node.bounds.get_surface_area() * (node.count > 0 ? static_cast<float>(node.count) : traversal_cost);
+
+    const float root_area = nodes[0].bounds.get_surface_area();
+    return root_area > 0.f ? cost / root_area : 0.f;
+}
+
+void MeshBvh::build(std::vector<glm::vec3> in_positions, std::vector<uint32_t> in_indices)
+{
+    positions = std::move(in_positions);
+    indices   = std::move(in_indices);
+
+    std::vector<Aabb> triangle_bounds(get_triangle_count());
+    for (uint32_t triangle = 0; triangle < triangle_bounds.size(); ++triangle)
+        triangle_bounds[triangle] = get_triangle_bounds(triangle);
+    bvh.build(triangle_bounds);
+}
+
+Aabb MeshBvh::get_triangle_bounds(uint32_t triangle) const
+{
+    Aabb bounds;
+    for (uint32_t vertex = 0; vertex < 3; ++vertex)
+        bounds.grow(positions[indices[triangle * 3 + vertex]]);
+    return bounds;
+}
+
+bool MeshBvh::raycast(const Ray& ray, float& distance, uint32_t& out_triangle, glm::vec3& out_normal) const
+{
+    Ray bounded_ray          = ray;
+    bounded_ray.max_distance = std::min(ray.max_distance, distance);
+    bool b_hit               = false;
+
+    bvh.traverse(bounded_ray, [&](uint32_t triangle, float& max_distance) {
+        // Moller-Trumbore, double sided
+        const glm::vec3& p0     = positions[indices[triangle * 3]];
+        const glm::vec3  edge_1 = positions[indices[triangle * 3 + 1]] - p0;
+        const glm::vec3  edge_2 = positions[indices[triangle * 3 + 2]] - p0;
+        const glm::vec3  p      = glm::cross(ray.direction, edge_2);
+        const float      det    = glm::dot(edge_1, p);
+        if (std::abs(det) < 1e-12f)
+            return;
+
+        const float     inverse_det = 1.f / det;
+        const glm::vec3 s           = ray.origin - p0;
+        const float     u           = glm::dot(s, p) * inverse_det;
+        if (u < 0.f || u > 1.f)
+            return;
+        const glm::vec3 q = glm::cross(s, edge_1);
+        const float     v = glm::dot(ray.direction, q) * inverse_det;
+        if (v < 0.f || u + v > 1.f)
+            return;
+
+        const float t = glm::dot(edge_2, q) * inverse_det;
+        if (t < 0.f || t >= max_distance)
+            return;
+
+        max_distance = t;
+        distance     = t;
+        out_triangle = triangle;
+        out_normal   = glm::cross(edge_1, edge_2);
+        b_hit        = true;
+    });
+
+    if (b_hit)
+        out_normal = glm::normalize(out_normal);
+    return b_hit;
+}
+
+bool MeshBvh::overlaps(const Aabb& box) const
+{
+    bool b_overlaps = false;
+    bvh.traverse(box, [&](uint32_t triangle) { b_overlaps = b_overlaps || get_triangle_bounds(triangle).overlaps(box); });
+    return b_overlaps;
+}
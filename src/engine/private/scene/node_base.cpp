@@ -1,19 +1,25 @@
 
 #include "scene/node_base.h"
 
+#include "scene/scene.h"
+
 #include <cpputils/logger.hpp>
 #include <algorithm>
 
-void Node::attach_to(const std::shared_ptr<Node>& new_parent_node, const bool b_keep_world_transform)
+void Node::attach_to(Node* new_parent_node, const bool b_keep_world_transform)
 {
-    if (!ensure_node_can_be_attached(new_parent_node.get()))
+    if (!ensure_node_can_be_attached(new_parent_node))
     {
         LOG_WARNING("cannot attach_to component to this one");
         return;
     }
 
+    if (parent)
+        parent->children.erase(std::ranges::find(parent->children, this));
+
     new_parent_node->children.emplace_back(this);
-    parent = new_parent_node.get();
+    parent = new_parent_node;
+    render_scene->b_tick_hierarchy_dirty = true;
 
     if (b_keep_world_transform)
     {
@@ -28,6 +34,14 @@ void Node::attach_to(const std::shared_ptr<Node>& new_parent_node, const bool b_
 
 void Node::detach(bool b_keep_world_transform)
 {
+    if (parent)
+    {
+        parent->children.erase(std::ranges::find(parent->children, this));
+        render_scene->b_tick_hierarchy_dirty = true;
+    }
+
+    parent = nullptr;
+
     if (b_keep_world_transform)
     {
         //@TODO handle b_keep_world_transform
@@ -37,13 +51,6 @@ void Node::detach(bool b_keep_world_transform)
     {
         recompute_transform();
     }
-
-    if (parent)
-    {
-        parent->children.erase(std::ranges::find(parent->children, this));
-    }
-
-    parent = nullptr;
 }
 
 bool Node::ensure_node_can_be_attached(const Node* in_node) const
@@ -51,6 +58,7 @@ bool Node::ensure_node_can_be_attached(const Node* in_node) const
     if (!in_node)
     {
         LOG_WARNING("invalid node");
+        return false;
     }
 
     if (in_node == this)
@@ -71,7 +79,8 @@ bool Node::ensure_node_can_be_attached(const Node* in_node) const
         return false;
     }
 
-    if (in_node->is_node_in_hierarchy(this))
+    // A node without children can't be an ancestor of another node
+    if (!children.empty() && in_node->is_node_in_hierarchy(this))
     {
         LOG_ERROR("cannot attach_to node to this one : this node is already attached to the current hierarchy.");
         return false;
@@ -82,17 +91,37 @@ bool Node::ensure_node_can_be_attached(const Node* in_node) const
 
 bool Node::is_node_in_hierarchy(const Node* in_node) const
 {
-    if (in_node == this)
-        return true;
-
-    if (parent)
-        return parent->is_node_in_hierarchy(in_node);
+    // Only the ancestor at the depth of in_node can be in_node
+    if (!in_node || in_node->depth > depth)
+        return false;
 
-    return false;
+    const Node* ancestor = this;
+    for (uint32_t i = depth - in_node->depth; i > 0; --i)
+        ancestor = ancestor->parent;
+    return ancestor == in_node;
 }
 
 void Node::recompute_transform()
 {
+    update_world_transform();
+    if (children.empty())
+        return;
+
+    // Parents are popped before their children are pushed : they are always up to date
+    std::vector<Node*> pending(children.begin(), children.end());
+    while (!pending.empty())
+    {
+        Node* node = pending.back();
+        pending.pop_back();
+        node->update_world_transform();
+        pending.insert(pending.end(), node->children.begin(), node->children.end());
+    }
+}
+
+void Node::update_world_transform()
+{
+    depth = parent ? parent->depth + 1 : 0;
+
     rel_transform = glm::translate(glm::dmat4(1.0), rel_rotation * rel_position);
     rel_transform = glm::scale(rel_transform, rel_scale);
 
@@ -111,8 +140,5 @@ void Node::recompute_transform()
         world_scale     = rel_scale;
     }
 
-    for (const auto& child : children)
-    {
-        child->recompute_transform();
-    }
+    on_transform_changed();
 }
@@ -4,22 +4,46 @@
 
 #include "assets/asset_material.h"
 #include "assets/asset_mesh_data.h"
+#include "scene/render_proxy.h"
 
-void MeshNode::render(RenderContext render_context)
+#include <cpputils/logger.hpp>
+
+bool MeshNode::get_render_record(RenderRecord& record) const
 {
     if (!mesh || !material)
-        return;
-
-    //@TODO : do once
-    //material->update_descriptor_sets(render_context.image_index);
-    
-    material->update_push_constants(render_context.command_buffer);
-    
-    vkCmdBindDescriptorSets(render_context.command_buffer, VK_PIPELINE_BIND_POINT_GRAPHICS, material->get_pipeline_layout(), 0, 1, &material->get_descriptor_sets()[render_context.image_index], 0, nullptr);
-    vkCmdBindPipeline(render_context.command_buffer, VK_PIPELINE_BIND_POINT_GRAPHICS, material->get_pipeline());
-
-    VkDeviceSize offsets[] = {0};
-    vkCmdBindVertexBuffers(render_context.command_buffer, 0, 1, &mesh->get_vertex_buffer(), offsets);
-    vkCmdBindIndexBuffer(render_context.command_buffer, mesh->get_index_buffer(), 0, VK_INDEX_TYPE_UINT32);
-    vkCmdDrawIndexed(render_context.command_buffer, mesh->get_indices_count(), 1, 0, 0, 0);
-}
\ No newline at end of file
+        return false;
+
+    record.material  = static_cast<Material*>(material.get_const());
+    record.mesh      = static_cast<MeshData*>(mesh.get_const());
+    record.transform = get_world_transform();
+    return true;
+}
+
+EAssetResolution MeshNode::resolve_assets()
+{
+    // Both are resolved each time : the material must be referenced even while the mesh is still loading
+    const bool b_mesh_resolved     = mesh.get() != nullptr;
+    const bool b_material_resolved = material.get() != nullptr;
+    if (!b_mesh_resolved || !b_material_resolved)
+        return EAssetResolution::Loading;
+
+    if (!mesh->has_geometry())
+    {
+        LOG_ERROR("mesh %s is empty", mesh.id().to_string().c_str());
+        return EAssetResolution::Failed;
+    }
+
+    // The pipeline of the material reads the vertex streams of the mesh
+    if (mesh->get_vertex_layout() != material->get_vertex_layout())
+    {
+        LOG_ERROR("mesh %s and material %s have different vertex layouts", mesh.id().to_string().c_str(), material.id().to_string().c_str());
+        return EAssetResolution::Failed;
+    }
+    return EAssetResolution::Resolved;
+}
+
+void MeshNode::get_snapshot_assets(std::vector<AssetId>& out_assets) const
+{
+    out_assets.emplace_back(mesh.id());
+    out_assets.emplace_back(material.id());
+}
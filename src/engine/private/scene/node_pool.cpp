@@ -0,0 +1,12 @@
+
+
+#include "scene/node_pool.h"
+
+#include <atomic>
+
+static std::atomic_uint32_t node_pool_id_counter = 0;
+
+uint32_t NodePoolBase::make_pool_id()
+{
+    return node_pool_id_counter++;
+}
@@ -0,0 +1,215 @@
+
+
+#include "scene/occlusion_buffer.h"
+
+#include "jobSystem/job_system.h"
+#include "statsRecorder.h"
+
+#include <algorithm>
+#include <cmath>
+
+#if defined(__SSE2__) || defined(_M_X64) || defined(_M_AMD64)
+#define OCCLUSION_BUFFER_SSE2 1
+#include <emmintrin.h>
+#else
+#define OCCLUSION_BUFFER_SSE2 0
+#endif
+
+// Geometry closer than this w is not rasterized, objects closer than this are never culled
+static constexpr float min_w = 1e-4f;
+
+OcclusionBuffer::OcclusionBuffer(uint32_t in_width, uint32_t in_height) : width((in_width + 3) & ~3u), height(in_height)
+{
+    depth.resize(static_cast<size_t>(width) * height, 0.f);
+}
+
+void OcclusionBuffer::begin(const glm::mat4& in_view_projection)
+{
+    view_projection = in_view_projection;
+    std::fill(depth.begin(), depth.end(), 0.f);
+    triangles.clear();
+}
+
+void OcclusionBuffer::add_occluder(const glm::mat4& transform, const std::vector<glm::vec3>& triangle_positions)
+{
+    const glm::mat4 clip_transform = view_projection * transform;
+    const glm::vec2 screen_size(static_cast<float>(width), static_cast<float>(height));
+
+    for (size_t first = 0; first + 2 < triangle_positions.size(); first += 3)
+    {
+        ScreenTriangle triangle;
+        bool           b_clipped = false;
+        for (int vertex = 0; vertex < 3; ++vertex)
+        {
+            const glm::vec4 clip = clip_transform * glm::vec4(triangle_positions[first + vertex], 1.f);
+            // Skipping triangles crossing the near plane only loses occlusion
+            if (clip.w <= min_w)
+            {
+                b_clipped = true;
+                break;
+            }
+            triangle.inv_w[vertex]     = 1.f / clip.w;
+            triangle.positions[vertex] = (glm::vec2(clip) * triangle.inv_w[vertex] * 0.5f + 0.5f) * screen_size;
+        }
+        if (b_clipped)
+            continue;
+
+        // Both sides are rasterized : make every triangle counter clockwise
+        const glm::vec2 edge_1 = triangle.positions[1] - triangle.positions[0];
+        const glm::vec2 edge_2 = triangle.positions[2] - triangle.positions[0];
+        const float     area   = edge_1.x * edge_2.y - edge_1.y * edge_2.x;
+        if (area == 0.f)
+            continue;
+        if (area < 0.f)
+        {
+            std::swap(triangle.positions[1], triangle.positions[2]);
+            std::swap(triangle.inv_w[1], triangle.inv_w[2]);
+        }
+
+        // Pixels whose center is in the triangle bounds
+        const glm::vec2 min_position = glm::min(triangle.positions[0], glm::min(triangle.positions[1], triangle.positions[2]));
+        const glm::vec2 max_position = glm::max(triangle.positions[0], glm::max(triangle.positions[1], triangle.positions[2]));
+        triangle.min_x               = std::max(static_cast<int32_t>(std::ceil(min_position.x - 0.5f)), 0);
+        triangle.min_y               = std::max(static_cast<int32_t>(std::ceil(min_position.y - 0.5f)), 0);
+        triangle.max_x               = std::min(static_cast<int32_t>(std::floor(max_position.x - 0.5f)), static_cast<int32_t>(width) - 1);
+        triangle.max_y               = std::min(static_cast<int32_t>(std::floor(max_position.y - 0.5f)), static_cast<int32_t>(height) - 1);
+        if (triangle.min_x > triangle.max_x || triangle.min_y > triangle.max_y)
+            continue;
+
+        triangles.emplace_back(triangle);
+    }
+}
+
+void OcclusionBuffer::rasterize()
+{
+    BEGIN_NAMED_RECORD(RASTERIZE_OCCLUDERS);
+    // Tiles own distinct rows : they don't need any synchronization
+    const uint32_t tile_count = (height + tile_height - 1) / tile_height;
+    job_system::parallel_for(
+        tile_count, [&](size_t tile) { rasterize_tile(static_cast<int32_t>(tile * tile_height), static_cast<int32_t>(std::min((tile + 1) * tile_height, size_t(height)))); }, 1);
+    END_NAMED_RECORD(RASTERIZE_OCCLUDERS);
+}
+
+void OcclusionBuffer::rasterize_tile(int32_t tile_min_y, int32_t tile_max_y)
+{
+    for (const ScreenTriangle& triangle : triangles)
+    {
+        const int32_t min_y = std::max(triangle.min_y, tile_min_y);
+        const int32_t max_y = std::min(triangle.max_y, tile_max_y - 1);
+        if (min_y > max_y)
+            continue;
+
+        // Edge i is opposite to vertex i : E(x, y) = a * x + b * y + c, positive inside
+        float a[3], b[3], c[3];
+        for (int edge = 0; edge < 3; ++edge)
+        {
+            const glm::vec2& from = triangle.positions[(edge + 1) % 3];
+            const glm::vec2& to   = triangle.positions[(edge + 2) % 3];
+            a[edge]               = from.y - to.y;
+            b[edge]               = to.x - from.x;
+            c[edge]               = from.x * to.y - from.y * to.x;
+        }
+
+        // 1 / w is linear in screen space : interpolate it with the normalized edge functions
+        const float inverse_area = 1.f / (a[0] * triangle.positions[0].x + b[0] * triangle.positions[0].y + c[0]);
+        float       depth_a      = 0.f;
+        float       depth_b      = 0.f;
+        float       depth_c      = 0.f;
+        for (int edge = 0; edge < 3; ++edge)
+        {
+            depth_a += a[edge] * triangle.inv_w[edge] * inverse_area;
+            depth_b += b[edge] * triangle.inv_w[edge] * inverse_area;
+            depth_c += c[edge] * triangle.inv_w[edge] * inverse_area;
+        }
+
+        const int32_t first_x = triangle.min_x & ~3;
+        for (int32_t y = min_y; y <= max_y; ++y)
+        {
+            const float center_y = static_cast<float>(y) + 0.5f;
+            float*      row      = depth.data() + static_cast<size_t>(y) * width;
+#if OCCLUSION_BUFFER_SSE2
+            const __m128 edge_0_row = _mm_set1_ps(b[0] * center_y + c[0]);
+            const __m128 edge_1_row = _mm_set1_ps(b[1] * center_y + c[1]);
+            const __m128 edge_2_row = _mm_set1_ps(b[2] * center_y + c[2]);
+            const __m128 depth_row  = _mm_set1_ps(depth_b * center_y + depth_c);
+            const __m128 zero       = _mm_setzero_ps();
+            for (int32_t x = first_x; x <= triangle.max_x; x += 4)
+            {
+                const float  first_center = static_cast<float>(x) + 0.5f;
+                const __m128 center_x     = _mm_setr_ps(first_center, first_center + 1.f, first_center + 2.f, first_center + 3.f);
+                const __m128 edge_0       = _mm_add_ps(_mm_mul_ps(_mm_set1_ps(a[0]), center_x), edge_0_row);
+                const __m128 edge_1       = _mm_add_ps(_mm_mul_ps(_mm_set1_ps(a[1]), center_x), edge_1_row);
+                const __m128 edge_2       = _mm_add_ps(_mm_mul_ps(_mm_set1_ps(a[2]), center_x), edge_2_row);
+                const __m128 inside       = _mm_and_ps(_mm_cmpge_ps(edge_0, zero), _mm_and_ps(_mm_cmpge_ps(edge_1, zero), _mm_cmpge_ps(edge_2, zero)));
+                if (_mm_movemask_ps(inside) == 0)
+                    continue;
+
+                // Outside lanes become 0 and never win the max
+                const __m128 pixel_depth = _mm_and_ps(inside, _mm_add_ps(_mm_mul_ps(_mm_set1_ps(depth_a), center_x), depth_row));
+                _mm_storeu_ps(row + x, _mm_max_ps(_mm_loadu_ps(row + x), pixel_depth));
+            }
+#else
+            for (int32_t x = first_x; x <= triangle.max_x; ++x)
+            {
+                const float center_x = static_cast<float>(x) + 0.5f;
+                if (a[0] * center_x + b[0] * center_y + c[0] < 0.f || a[1] * center_x + b[1] * center_y + c[1] < 0.f || a[2] * center_x + b[2] * center_y + c[2] < 0.f)
+                    continue;
+                row[x] = std::max(row[x], depth_a * center_x + depth_b * center_y + depth_c);
+            }
+#endif
+        }
+    }
+}
+
+bool OcclusionBuffer::is_occluded(const Aabb& bounds, const glm::mat4& transform) const
+{
+    if (!bounds.is_valid())
+        return false;
+
+    const glm::mat4 clip_transform = view_projection * transform;
+    glm::vec2       min_position(FLT_MAX);
+    glm::vec2       max_position(-FLT_MAX);
+    float           nearest_inv_w = 0.f;
+    for (int corner = 0; corner < 8; ++corner)
+    {
+        const glm::vec3 point(corner & 1 ? bounds.max.x : bounds.min.x, corner & 2 ? bounds.max.y : bounds.min.y, corner & 4 ? bounds.max.z : bounds.min.z);
+        const glm::vec4 clip = clip_transform * glm::vec4(point, 1.f);
+        if (clip.w <= min_w)
+            return false;
+
+        const float     inv_w    = 1.f / clip.w;
+        const glm::vec2 position = (glm::vec2(clip) * inv_w * 0.5f + 0.5f) * glm::vec2(static_cast<float>(width), static_cast<float>(height));
+        min_position             = glm::min(min_position, position);
+        max_position             = glm::max(max_position, position);
+        nearest_inv_w            = std::max(nearest_inv_w, inv_w);
+    }
+
+    // Every pixel the box touches must hold a nearer occluder. Boxes outside of the screen are left to frustum culling.
+    const int32_t min_x = std::max(static_cast<int32_t>(std::floor(min_position.x)), 0);
+    const int32_t min_y = std::max(static_cast<int32_t>(std::floor(min_position.y)), 0);
+    const int32_t max_x = std::min(static_cast<int32_t>(std::ceil(max_position.x)) - 1, static_cast<int32_t>(width) - 1);
+    const int32_t max_y = std::min(static_cast<int32_t>(std::ceil(max_position.y)) - 1, static_cast<int32_t>(height) - 1);
+    if (min_x > max_x || min_y > max_y)
+        return false;
+
+    for (int32_t y = min_y; y <= max_y; ++y)
+    {
+        const float* row = depth.data() + static_cast<size_t>(y) * width;
+#if OCCLUSION_BUFFER_SSE2
+        const __m128 nearest = _mm_set1_ps(nearest_inv_w);
+        for (int32_t x = min_x & ~3; x <= max_x; x += 4)
+        {
+            // Lanes outside of [min_x, max_x] are ignored
+            const int lanes     = (0xF << std::max(min_x - x, 0)) & (0xF >> std::max(x + 3 - max_x, 0));
+            const int b_visible = _mm_movemask_ps(_mm_cmple_ps(_mm_loadu_ps(row + x), nearest)) & lanes;
+            if (b_visible)
+                return false;
+        }
+#else
+        for (int32_t x = min_x; x <= max_x; ++x)
+            if (row[x] <= nearest_inv_w)
+                return false;
+#endif
+    }
+    return true;
+}
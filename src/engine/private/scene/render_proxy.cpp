@@ -0,0 +1,152 @@
+
+
+#include "scene/render_proxy.h"
+
+#include <algorithm>
+
+uint32_t RenderProxy::add_record(const RenderRecord& record)
+{
+    uint32_t proxy_id;
+    if (!free_proxy_ids.empty())
+    {
+        proxy_id = free_proxy_ids.back();
+        free_proxy_ids.pop_back();
+    }
+    else
+    {
+        proxy_id = static_cast<uint32_t>(proxy_to_dense.size());
+        proxy_to_dense.emplace_back();
+    }
+
+    const auto dense_index   = static_cast<uint32_t>(game_records.size());
+    proxy_to_dense[proxy_id] = dense_index;
+    game_records.emplace_back(record).previous_transform = record.transform;
+    dense_to_proxy.emplace_back(proxy_id);
+    mark_changed(dense_index);
+    return proxy_id;
+}
+
+void RenderProxy::update_record(uint32_t proxy_id, const RenderRecord& record)
+{
+    const uint32_t  dense_index        = proxy_to_dense[proxy_id];
+    const glm::mat4 previous_transform = game_records[dense_index].previous_transform;
+    game_records[dense_index]                    = record;
+    game_records[dense_index].previous_transform = previous_transform;
+    mark_changed(dense_index);
+    mark_step_changed(dense_index, true);
+}
+
+void RenderProxy::set_view(const RenderView& view)
+{
+    if (!b_game_has_view)
+        game_previous_view = view;
+    game_view       = view;
+    b_game_has_view = true;
+}
+
+void RenderProxy::reset_view()
+{
+    b_game_has_view = false;
+}
+
+RenderView RenderProxy::get_view(float alpha) const
+{
+    const glm::dvec3 forward = glm::mix(render_previous_view.forward, render_view.forward, static_cast<double>(alpha));
+    return RenderView{
+        .location        = glm::mix(render_previous_view.location, render_view.location, static_cast<double>(alpha)),
+        .forward         = glm::length(forward) > 0.0 ? glm::normalize(forward) : render_view.forward,
+        .up              = render_view.up,
+        .field_of_view   = glm::mix(render_previous_view.field_of_view, render_view.field_of_view, alpha),
+        .near_clip_plane = render_view.near_clip_plane,
+        .far_clip_plane  = render_view.far_clip_plane,
+    };
+}
+
+void RenderProxy::begin_step()
+{
+    // The view is interpolated from where the last step left it
+    game_previous_view = game_view;
+
+    for (size_t word = 0; word < step_changes.size(); ++word)
+    {
+        for (uint64_t bits = step_changes[word]; bits != 0; bits &= bits - 1)
+        {
+            const size_t index = word * 64 + std::countr_zero(bits);
+            if (index >= game_records.size())
+                break;
+            // The interpolation of this record ends where it was left : it needs to be republished even if it doesn't move anymore
+            game_records[index].previous_transform = game_records[index].transform;
+            mark_changed(static_cast<uint32_t>(index));
+        }
+        step_changes[word] = 0;
+    }
+}
+
+void RenderProxy::remove_record(uint32_t proxy_id)
+{
+    const uint32_t dense_index = proxy_to_dense[proxy_id];
+    const uint32_t last_index  = static_cast<uint32_t>(game_records.size() - 1);
+    if (dense_index != last_index)
+    {
+        game_records[dense_index]                   = game_records[last_index];
+        dense_to_proxy[dense_index]                 = dense_to_proxy[last_index];
+        proxy_to_dense[dense_to_proxy[dense_index]] = dense_index;
+        mark_changed(dense_index);
+        mark_step_changed(dense_index, step_changes.size() > last_index / 64 && (step_changes[last_index / 64] >> last_index % 64 & 1) != 0);
+    }
+    mark_step_changed(last_index, false);
+
+    game_records.pop_back();
+    dense_to_proxy.pop_back();
+    proxy_to_dense[proxy_id] = UINT32_MAX;
+    free_proxy_ids.emplace_back(proxy_id);
+}
+
+void RenderProxy::publish()
+{
+    render_records.resize(game_records.size());
+    render_proxy_ids.resize(game_records.size());
+    render_changes.resize(std::max(render_changes.size(), game_changes.size()), 0);
+    render_proxy_id_capacity = proxy_to_dense.size();
+    render_view              = game_view;
+    render_previous_view     = game_previous_view;
+    b_render_has_view        = b_game_has_view;
+
+    for (size_t word = 0; word < game_changes.size(); ++word)
+    {
+        for (uint64_t bits = game_changes[word]; bits != 0; bits &= bits - 1)
+        {
+            // Changed records can have been removed since
+            const size_t index = word * 64 + std::countr_zero(bits);
+            if (index >= game_records.size())
+                break;
+            render_records[index]   = game_records[index];
+            render_proxy_ids[index] = dense_to_proxy[index];
+        }
+        render_changes[word] |= game_changes[word];
+        game_changes[word] = 0;
+    }
+}
+
+void RenderProxy::mark_changed(uint32_t dense_index)
+{
+    const size_t word = dense_index / 64;
+    if (game_changes.size() <= word)
+        game_changes.resize(word + 1, 0);
+    game_changes[word] |= uint64_t(1) << dense_index % 64;
+}
+
+void RenderProxy::mark_step_changed(uint32_t dense_index, bool b_changed)
+{
+    const size_t word = dense_index / 64;
+    if (step_changes.size() <= word)
+    {
+        if (!b_changed)
+            return;
+        step_changes.resize(word + 1, 0);
+    }
+    if (b_changed)
+        step_changes[word] |= uint64_t(1) << dense_index % 64;
+    else
+        step_changes[word] &= ~(uint64_t(1) << dense_index % 64);
+}
@@ -0,0 +1,277 @@
+
+
+#include "scene/render_queue.h"
+
+#include "assets/asset_material.h"
+#include "assets/asset_mesh_data.h"
+#include "jobSystem/job_system.h"
+#include "rendering/vulkan/utils.h"
+#include "rendering/window.h"
+#include "statsRecorder.h"
+
+#include <algorithm>
+#include <cstring>
+
+static constexpr uint64_t invalid_sort_key = UINT64_MAX;
+
+uint64_t RenderQueue::make_sort_key(const DrawItem& item)
+{
+    if (!item.material || !item.mesh)
+        return invalid_sort_key;
+
+    // Each material owns its pipeline and its descriptor sets for now, so the material id sorts both
+    const uint64_t material_id = item.material->get_render_id() & 0xFFF;
+    const uint64_t mesh_id     = item.mesh->get_render_id() & 0x1FFFFFF;
+    const uint64_t lod_id      = item.lod & 0x7;
+
+    // Positive floats keep their ordering when compared as integers : front to back with the 24 most significant bits
+    uint32_t depth_bits;
+    const float depth = item.depth > 0.f ? item.depth : 0.f;
+    std::memcpy(&depth_bits, &depth, sizeof(float));
+
+    return material_id << 52 | mesh_id << 27 | lod_id << 24 | static_cast<uint64_t>(depth_bits >> 8);
+}
+
+void RenderQueue::reset(size_t item_count)
+{
+    items.clear();
+    items.resize(item_count);
+    keys.assign(item_count, invalid_sort_key);
+    sorted_count = 0;
+}
+
+void RenderQueue::set_item(size_t index, const DrawItem& item)
+{
+    items[index] = item;
+    keys[index]  = make_sort_key(item);
+}
+
+void RenderQueue::sort()
+{
+    BEGIN_NAMED_RECORD(SORT_RENDER_QUEUE);
+    const size_t count = items.size();
+
+    sorted_indices.resize(count);
+    key_scratch.resize(count);
+    index_scratch.resize(count);
+    for (uint32_t i = 0; i < count; ++i)
+        sorted_indices[i] = i;
+
+    // LSD radix sort : 8 passes of 8 bits, histograms are all computed in a single read
+    size_t histograms[8][256] = {};
+    for (const uint64_t key : keys)
+        for (int digit = 0; digit < 8; ++digit)
+            ++histograms[digit][key >> (digit * 8) & 0xFF];
+
+    for (int digit = 0; digit < 8 && count > 0; ++digit)
+    {
+        const int shift     = digit * 8;
+        auto&     histogram = histograms[digit];
+
+        // Every key shares this digit (ie : unused id bits), the pass would not change the order
+        if (histogram[keys[0] >> shift & 0xFF] == count)
+            continue;
+
+        size_t offset = 0;
+        for (auto& bucket : histogram)
+        {
+            const size_t bucket_size = bucket;
+            bucket                   = offset;
+            offset += bucket_size;
+        }
+
+        for (size_t i = 0; i < count; ++i)
+        {
+            const size_t destination   = histogram[keys[i] >> shift & 0xFF]++;
+            key_scratch[destination]   = keys[i];
+            index_scratch[destination] = sorted_indices[i];
+        }
+
+        keys.swap(key_scratch);
+        sorted_indices.swap(index_scratch);
+    }
+
+    sorted_count = count;
+    while (sorted_count > 0 && keys[sorted_count - 1] == invalid_sort_key)
+        --sorted_count;
+
+    // Items sharing material, mesh and lod are contiguous : collapse them into a single instanced draw
+    batches.clear();
+    for (size_t i = 0; i < sorted_count; ++i)
+    {
+        const DrawItem& item = get_sorted_item(i);
+        if (!batches.empty())
+        {
+            const DrawItem& batch_item = get_sorted_item(batches.back().first_instance);
+            if (batch_item.material == item.material && batch_item.mesh == item.mesh && batch_item.lod == item.lod)
+            {
+                ++batches.back().instance_count;
+                continue;
+            }
+        }
+        batches.emplace_back(DrawBatch{.first_instance = static_cast<uint32_t>(i), .instance_count = 1});
+    }
+
+    END_NAMED_RECORD(SORT_RENDER_QUEUE);
+}
+
+void RenderQueue::prepare(uint32_t image_index) const
+{
+    // Materials are contiguous in the sorted queue
+    const Material* last_material = nullptr;
+    for (size_t i = 0; i < sorted_count; ++i)
+    {
+        Material* material = get_sorted_item(i).material;
+        if (material != last_material)
+        {
+            material->update_descriptor_sets(image_index);
+            last_material = material;
+        }
+    }
+}
+
+void RenderQueue::record(const RenderContext& render_context, const IndirectDrawBuffers& indirect_buffers, bool b_depth_prepass)
+{
+    BEGIN_NAMED_RECORD(RECORD_RENDER_QUEUE);
+    stats = RenderQueueStats{};
+
+    // The pre-pass is recorded in its own subpass : it needs secondary command buffers from the window
+    if (b_depth_prepass && render_context.window)
+    {
+        // Instances of a batch are sorted front to back : its first instance is the nearest one
+        prepass_order.resize(batches.size());
+        for (uint32_t i = 0; i < prepass_order.size(); ++i)
+            prepass_order[i] = i;
+        std::sort(prepass_order.begin(), prepass_order.end(), [&](uint32_t a, uint32_t b) { return get_sorted_item(batches[a].first_instance).depth < get_sorted_item(batches[b].first_instance).depth; });
+
+        RenderQueueStats prepass_stats;
+        record_pass(render_context, indirect_buffers, EMaterialPass::DepthPrepass, prepass_order.data(), prepass_stats);
+        stats.prepass_draws = prepass_stats.draws;
+        stats.binds         = prepass_stats.binds;
+        record_pass(render_context, indirect_buffers, EMaterialPass::ColorAfterDepthPrepass, nullptr, stats);
+    }
+    else
+    {
+        record_pass(render_context, indirect_buffers, EMaterialPass::Color, nullptr, stats);
+    }
+
+    // Compared to one draw per item binding pipeline, descriptor set, vertex and index buffers
+    stats.items       = sorted_count;
+    stats.draws_saved = stats.items - stats.draws;
+    stats.binds_saved = stats.items * (stats.prepass_draws > 0 ? 8 : 4) - stats.binds;
+    END_NAMED_RECORD(RECORD_RENDER_QUEUE);
+}
+
+void RenderQueue::record_pass(const RenderContext& render_context, const IndirectDrawBuffers& indirect_buffers, EMaterialPass pass, const uint32_t* batch_order, RenderQueueStats& out_stats)
+{
+    const bool   b_depth_prepass      = pass == EMaterialPass::DepthPrepass;
+    const size_t command_buffer_count = std::clamp(batches.size() / min_batches_per_command_buffer, static_cast<size_t>(1), job_system::Worker::get_worker_count() + 1);
+    if ((command_buffer_count == 1 && !b_depth_prepass) || !render_context.window)
+    {
+        record_batches(render_context.command_buffer, render_context.image_index, 0, batches.size(), indirect_buffers, pass, batch_order, out_stats);
+        out_stats.command_buffers += 1;
+        return;
+    }
+
+    // Each range is recorded in its own secondary command buffer, allocated from the recording thread's pool
+    const uint32_t                subpass = b_depth_prepass ? Window::depth_prepass_subpass : Window::color_subpass;
+    std::vector<VkCommandBuffer>  command_buffers(command_buffer_count);
+    std::vector<RenderQueueStats> partial_stats(command_buffer_count);
+    job_system::parallel_for(
+        command_buffer_count,
+        [&](size_t i) {
+            command_buffers[i] = render_context.window->begin_secondary_command_buffer(render_context, subpass);
+            record_batches(command_buffers[i], render_context.image_index, batches.size() * i / command_buffer_count, batches.size() * (i + 1) / command_buffer_count, indirect_buffers, pass, batch_order,
+                           partial_stats[i]);
+            VK_ENSURE(vkEndCommandBuffer(command_buffers[i]), "Failed to record secondary command buffer");
+        },
+        1);
+    if (b_depth_prepass)
+        render_context.window->submit_depth_prepass_command_buffers(command_buffers);
+    else
+        render_context.window->submit_secondary_command_buffers(command_buffers);
+
+    for (const auto& partial : partial_stats)
+    {
+        out_stats.draws += partial.draws;
+        out_stats.binds += partial.binds;
+        out_stats.triangles += partial.triangles;
+    }
+    out_stats.command_buffers += command_buffer_count;
+}
+
+void RenderQueue::record_batches(VkCommandBuffer command_buffer, uint32_t image_index, size_t first_batch, size_t last_batch, const IndirectDrawBuffers& indirect_buffers, EMaterialPass pass, const uint32_t* batch_order,
+                                 RenderQueueStats& out_stats) const
+{
+    const Material*      bound_material       = nullptr;
+    const GeometryBlock* bound_vertex_block   = nullptr;
+    const GeometryBlock* bound_index_block    = nullptr;
+    VkPipeline           bound_pipeline       = VK_NULL_HANDLE;
+    VkPipelineLayout     bound_layout         = VK_NULL_HANDLE;
+    VkDescriptorSet      bound_descriptor_set = VK_NULL_HANDLE;
+
+    for (size_t position = first_batch; position < last_batch; ++position)
+    {
+        const size_t     batch_index = batch_order ? batch_order[position] : position;
+        const DrawBatch& batch       = batches[batch_index];
+        const DrawItem&  item  = get_sorted_item(batch.first_instance);
+
+        if (item.material != bound_material)
+        {
+            if (item.material->get_pipeline(pass) != bound_pipeline)
+            {
+                bound_pipeline = item.material->get_pipeline(pass);
+                vkCmdBindPipeline(command_buffer, VK_PIPELINE_BIND_POINT_GRAPHICS, bound_pipeline);
+                ++out_stats.binds;
+            }
+
+            // A different layout disturbs the previously bound descriptor set
+            if (item.material->get_pipeline_layout() != bound_layout)
+            {
+                bound_layout         = item.material->get_pipeline_layout();
+                bound_descriptor_set = VK_NULL_HANDLE;
+            }
+
+            const VkDescriptorSet descriptor_set = item.material->get_descriptor_sets()[image_index];
+            if (descriptor_set != bound_descriptor_set)
+            {
+                bound_descriptor_set = descriptor_set;
+                vkCmdBindDescriptorSets(command_buffer, VK_PIPELINE_BIND_POINT_GRAPHICS, bound_layout, 0, 1, &bound_descriptor_set, 0, nullptr);
+                ++out_stats.binds;
+            }
+
+            item.material->update_push_constants(command_buffer);
+            bound_material = item.material;
+        }
+
+        // Meshes share the blocks of the geometry pool : most of them are drawn without any buffer bind
+        const GeometryAllocation& geometry = item.mesh->get_geometry();
+        if (geometry.vertex_block != bound_vertex_block)
+        {
+            geometry.vertex_block->bind_vertex_buffers(command_buffer);
+            bound_vertex_block = geometry.vertex_block;
+            ++out_stats.binds;
+        }
+        if (geometry.index_block != bound_index_block)
+        {
+            geometry.index_block->bind_index_buffer(command_buffer);
+            bound_index_block = geometry.index_block;
+            ++out_stats.binds;
+        }
+
+        // Instances of a batch are contiguous from first_instance : the instance buffer maps them to their object
+        const MeshLod& lod = item.mesh->get_lod(item.lod);
+        if (indirect_buffers.draw_commands != VK_NULL_HANDLE)
+        {
+            // The culling pass sets the draw count to 0 if every instance is culled
+            vkCmdDrawIndexedIndirectCount(command_buffer, indirect_buffers.draw_commands, batch_index * sizeof(VkDrawIndexedIndirectCommand), indirect_buffers.draw_counts, batch_index * sizeof(uint32_t), 1,
+                                          sizeof(VkDrawIndexedIndirectCommand));
+        }
+        else
+        {
+            vkCmdDrawIndexed(command_buffer, lod.index_count, batch.instance_count, item.mesh->get_first_index() + lod.first_index, item.mesh->get_vertex_offset(), batch.first_instance);
+        }
+        ++out_stats.draws;
+        out_stats.triangles += lod.index_count / 3 * batch.instance_count;
+    }
+}
@@ -3,68 +3,701 @@
 #include "scene/scene.h"
 
 #include "assets/asset_base.h"
+#include "assets/asset_compute_material.h"
+#include "assets/asset_mesh_data.h"
+#include "config.h"
+#include "engine_interface.h"
 #include "scene/node_camera.h"
+#include "scene/node_mesh.h"
 #include "scene/node_primitive.h"
+#include "jobSystem/job_system.h"
+#include "statsRecorder.h"
+
+#include <algorithm>
+#include <atomic>
 
 struct ModMatrix
 {
     glm::mat4 a;
+    glm::mat4 previous;
+    glm::vec4 position_scale  = glm::vec4(1.f); // Dequantization of the mesh positions
+    glm::vec4 position_offset = glm::vec4(0.f);
 };
-Scene::Scene(AssetManager* asset_manager)
+
+struct CullObject
 {
-    camera_uniform_buffer = asset_manager->create<ShaderBuffer>("global_camera_uniform_buffer", "GlobalCameraUniformBuffer", CameraData{}, VK_BUFFER_USAGE_UNIFORM_BUFFER_BIT);
-    global_model_ssbo     = asset_manager->create<ShaderBuffer>("global_object_buffer", "ObjectBuffer", sizeof(ModMatrix) * 100, VK_BUFFER_USAGE_STORAGE_BUFFER_BIT);
+    glm::vec4 sphere       = glm::vec4(0);
+    uint32_t  batch        = 0;
+    uint32_t  object_index = 0;
+    uint32_t  padding[2];
+};
+
+struct CullingData
+{
+    glm::vec4 frustum_planes[6];
+    uint32_t  object_count = 0;
+};
+
+// Grow the buffer if needed then write data at the beginning
+static void write_storage_buffer(ShaderBuffer* buffer, const void* data, size_t size)
+{
+    if (buffer->get_size() < size)
+        buffer->resize_buffer(size);
+    buffer->write_buffer(data, size, 0);
 }
 
-void Scene::tick(const double delta_second)
+// Gribb-Hartmann plane extraction, normals point inside the frustum
+static void extract_frustum_planes(const glm::mat4& view_projection, glm::vec4 (&planes)[6])
 {
-    for (const auto& component : scene_nodes)
-        component->tick(delta_second);
+    const glm::vec4 row_x(view_projection[0][0], view_projection[1][0], view_projection[2][0], view_projection[3][0]);
+    const glm::vec4 row_y(view_projection[0][1], view_projection[1][1], view_projection[2][1], view_projection[3][1]);
+    const glm::vec4 row_z(view_projection[0][2], view_projection[1][2], view_projection[2][2], view_projection[3][2]);
+    const glm::vec4 row_w(view_projection[0][3], view_projection[1][3], view_projection[2][3], view_projection[3][3]);
+
+    planes[0] = row_w + row_x;
+    planes[1] = row_w - row_x;
+    planes[2] = row_w + row_y;
+    planes[3] = row_w - row_y;
+    planes[4] = row_w + row_z;
+    planes[5] = row_w - row_z;
+    for (auto& plane : planes)
+        plane /= glm::length(glm::vec3(plane));
 }
 
-void Scene::render_scene(RenderContext render_context)
+// Project the lod errors at the distance of the bounding sphere's closest point
+static uint32_t select_lod(const RenderRecord& record, const LodContext& lod_context, uint32_t current_lod)
+{
+    const glm::vec4& bounding_sphere = record.mesh->get_bounding_sphere();
+    const float      scale           = glm::max(glm::length(glm::vec3(record.transform[0])), glm::max(glm::length(glm::vec3(record.transform[1])), glm::length(glm::vec3(record.transform[2]))));
+    const glm::vec3  center          = glm::vec3(record.transform * glm::vec4(glm::vec3(bounding_sphere), 1.f));
+    const float      distance        = glm::max(glm::length(center - lod_context.camera_location) - bounding_sphere.w * scale, lod_context.min_distance);
+
+    return record.mesh->select_lod(lod_context.pixels_per_unit * scale / distance, lod_context.max_pixel_error, lod_context.hysteresis, current_lod);
+}
+
+Scene::Scene(AssetManager* in_asset_manager) : asset_manager(in_asset_manager), occlusion_buffer(config::occlusion_buffer_width, config::occlusion_buffer_height)
+{
+    if (asset_manager)
+    {
+        camera_uniform_buffer = asset_manager->create<ShaderBuffer>("global_camera_uniform_buffer", "GlobalCameraUniformBuffer", CameraData{}, VK_BUFFER_USAGE_UNIFORM_BUFFER_BIT);
+        global_model_ssbo     = asset_manager->create<ShaderBuffer>("global_object_buffer", "ObjectBuffer", sizeof(ModMatrix) * 100, VK_BUFFER_USAGE_STORAGE_BUFFER_BIT);
+        global_instance_ssbo  = asset_manager->create<ShaderBuffer>("global_instance_buffer", "InstanceBuffer", sizeof(uint32_t) * 100, VK_BUFFER_USAGE_STORAGE_BUFFER_BIT);
+        asset_manager->get_engine_interface()->register_scene(this);
+    }
+
+    register_node_type<Node>("Node");
+    register_node_type<Camera>("Camera");
+    register_node_type<MeshNode>("MeshNode", [](Scene& scene, AssetManager* asset_manager, const AssetId* assets, uint32_t asset_count) -> Node* {
+        if (asset_count != 2)
+            return nullptr;
+        return scene.add_node<MeshNode>(TAssetPtr<MeshData>(asset_manager, assets[0]), TAssetPtr<Material>(asset_manager, assets[1]));
+    });
+}
+
+Scene::~Scene()
+{
+    if (asset_manager)
+        asset_manager->get_engine_interface()->unregister_scene(this);
+
+    // Pools destroy the remaining nodes
+    destroy_removed_nodes(true);
+    node_pools.clear();
+}
+
+void Scene::remove_node(Node* node)
+{
+    if (!node || node->render_scene != this || node->scene_node_index == UINT32_MAX)
+    {
+        LOG_WARNING("cannot remove a node that is not part of this scene");
+        return;
+    }
+
+    while (!node->children.empty())
+        remove_node(node->children.back());
+    if (node->parent)
+        node->detach(false);
+
+    // Swap remove from the tick and render lists
+    Node* last_node                     = scene_nodes.back();
+    scene_nodes[node->scene_node_index] = last_node;
+    last_node->scene_node_index         = node->scene_node_index;
+    node->scene_node_index              = UINT32_MAX;
+    scene_nodes.pop_back();
+
+    if (node->rendered_node_index != UINT32_MAX)
+    {
+        PrimitiveNode* last_primitive             = rendered_nodes.back();
+        rendered_nodes[node->rendered_node_index] = last_primitive;
+        last_primitive->rendered_node_index       = node->rendered_node_index;
+        node->rendered_node_index                 = UINT32_MAX;
+        rendered_nodes.pop_back();
+
+        PrimitiveNode* primitive = static_cast<PrimitiveNode*>(node);
+        if (primitive->proxy_id != UINT32_MAX)
+        {
+            render_proxy.remove_record(primitive->proxy_id);
+            spatial_index.remove_instance(primitive->proxy_id);
+        }
+        primitive->proxy_id = UINT32_MAX;
+    }
+
+    if (node->tick_index != UINT32_MAX)
+    {
+        TickBatch& batch              = tick_batches[node->handle.pool_id];
+        Node*      last_ticked        = batch.nodes.back();
+        batch.nodes[node->tick_index] = last_ticked;
+        last_ticked->tick_index       = node->tick_index;
+        node->tick_index              = UINT32_MAX;
+        batch.nodes.pop_back();
+        batch.b_dirty = true;
+    }
+
+    if (enabled_camera == node)
+    {
+        enabled_camera = nullptr;
+        render_proxy.reset_view();
+    }
+
+    removed_nodes.emplace_back(RemovedNode{.handle = node->handle, .frame = frame_index});
+}
+
+Node* Scene::find_node(const NodeHandle& handle) const
+{
+    if (!handle.is_valid() || handle.pool_id >= node_pools.size() || !node_pools[handle.pool_id])
+        return nullptr;
+
+    Node* node = node_pools[handle.pool_id]->get(handle.slot, handle.generation);
+
+    // Removed nodes are kept alive until destroy_removed_nodes()
+    return node && node->scene_node_index != UINT32_MAX ? node : nullptr;
+}
+
+void Scene::destroy_removed_nodes(bool b_force)
+{
+    size_t destroyed_count = 0;
+    for (; destroyed_count < removed_nodes.size(); ++destroyed_count)
+    {
+        const RemovedNode& removed_node = removed_nodes[destroyed_count];
+        if (!b_force && removed_node.frame + config::max_frame_in_flight >= frame_index)
+            break;
+        node_pools[removed_node.handle.pool_id]->release(removed_node.handle.slot);
+    }
+    removed_nodes.erase(removed_nodes.begin(), removed_nodes.begin() + destroyed_count);
+}
+
+void Scene::init_gpu_culling(const TAssetPtr<Shader>& culling_shader)
+{
+    if (culling_material)
+    {
+        LOG_WARNING("gpu culling is already initialized for this scene");
+        return;
+    }
+
+    culling_uniform_buffer = asset_manager->create<ShaderBuffer>("gpu_culling_uniform_buffer", "CullingUniformBuffer", CullingData{}, VK_BUFFER_USAGE_UNIFORM_BUFFER_BIT);
+    cull_object_ssbo       = asset_manager->create<ShaderBuffer>("gpu_culling_object_buffer", "CullObjectBuffer", sizeof(CullObject) * 100, VK_BUFFER_USAGE_STORAGE_BUFFER_BIT);
+    draw_command_ssbo      = asset_manager->create<ShaderBuffer>("gpu_culling_draw_command_buffer", "DrawCommandBuffer", sizeof(VkDrawIndexedIndirectCommand) * 100,
+                                                                 VK_BUFFER_USAGE_STORAGE_BUFFER_BIT | VK_BUFFER_USAGE_INDIRECT_BUFFER_BIT);
+    draw_count_ssbo        = asset_manager->create<ShaderBuffer>("gpu_culling_draw_count_buffer", "DrawCountBuffer", sizeof(uint32_t) * 100, VK_BUFFER_USAGE_STORAGE_BUFFER_BIT | VK_BUFFER_USAGE_INDIRECT_BUFFER_BIT);
+
+    const ShaderStageData compute_stage{
+        .shader          = culling_shader,
+        .uniform_buffer  = {culling_uniform_buffer},
+        .storage_buffers = {cull_object_ssbo, draw_command_ssbo, draw_count_ssbo, global_instance_ssbo},
+    };
+    culling_material = asset_manager->create<ComputeMaterial>("gpu_culling_material", compute_stage);
+}
+
+void Scene::init_shadows(const TAssetPtr<Shader>& shadow_vertex_shader)
+{
+    if (shadow_renderer)
+    {
+        LOG_WARNING("shadows are already initialized for this scene");
+        return;
+    }
+    shadow_renderer = std::make_unique<ShadowRenderer>(asset_manager, shadow_vertex_shader, camera_uniform_buffer, global_model_ssbo);
+}
+
+void Scene::set_sun_direction(const glm::vec3& direction)
+{
+    if (shadow_renderer)
+        shadow_renderer->set_sun_direction(direction);
+}
+
+TAssetPtr<ShaderBuffer> Scene::get_shadow_uniform_buffer() const
+{
+    return shadow_renderer ? shadow_renderer->get_uniform_buffer() : nullptr;
+}
+
+VkDescriptorImageInfo Scene::get_shadow_map_image_info() const
+{
+    return shadow_renderer ? shadow_renderer->get_shadow_map_image_info() : VkDescriptorImageInfo{};
+}
+
+const ShadowStats& Scene::get_shadow_stats() const
+{
+    static const ShadowStats no_shadows = {};
+    return shadow_renderer ? shadow_renderer->get_stats() : no_shadows;
+}
+
+void Scene::register_render_record(PrimitiveNode* primitive)
+{
+    // Failed primitives are never registered nor polled again
+    const EAssetResolution resolution = primitive->resolve_assets();
+    if (resolution == EAssetResolution::Loading)
+        loading_primitives.emplace_back(primitive->get_handle());
+    if (resolution != EAssetResolution::Resolved)
+        return;
+
+    RenderRecord record;
+    if (primitive->get_render_record(record))
+    {
+        primitive->proxy_id = render_proxy.add_record(record);
+        spatial_index.set_instance(primitive->proxy_id, primitive->get_handle(), record.mesh && record.mesh->has_collision() ? &record.mesh->get_bvh() : nullptr, record.transform);
+    }
+}
+
+void Scene::update_render_records()
 {
     if (enabled_camera)
+        render_proxy.set_view(RenderView{
+            .location        = enabled_camera->get_world_position(),
+            .forward         = enabled_camera->get_forward_vector(),
+            .up              = enabled_camera->get_world_up(),
+            .field_of_view   = enabled_camera->get_field_of_view(),
+            .near_clip_plane = enabled_camera->get_near_clip_plane(),
+            .far_clip_plane  = enabled_camera->get_far_clip_plane(),
+        });
+
+    for (PrimitiveNode* primitive : rendered_nodes)
     {
-        CameraData camera_data = {
-            .world_projection = make_projection_matrix(render_context),
-            .view_matrix      = enabled_camera->get_look_at_matrix(),
-            .camera_location  = enabled_camera->get_world_position(),
-        };
-        camera_uniform_buffer->set_data(camera_data);
+        if (!primitive->b_render_record_dirty)
+            continue;
+        primitive->b_render_record_dirty = false;
 
-        std::vector<ModMatrix> matrix(100);
-        for (int i = 0; i < 100; ++i)
+        RenderRecord record;
+        if (primitive->proxy_id != UINT32_MAX && primitive->get_render_record(record))
         {
-            matrix[i].a = glm::mat4(1.0);
+            render_proxy.update_record(primitive->proxy_id, record);
+            spatial_index.set_instance(primitive->proxy_id, primitive->get_handle(), record.mesh && record.mesh->has_collision() ? &record.mesh->get_bvh() : nullptr, record.transform);
         }
+    }
+}
+
+void Scene::register_loaded_primitives()
+{
+    // The primitives still loading are queued again, the failed ones are dropped
+    const std::vector<NodeHandle> loading = std::move(loading_primitives);
+    loading_primitives.clear();
+    for (const NodeHandle& handle : loading)
+        if (auto* primitive = find_node<PrimitiveNode>(handle))
+            register_render_record(primitive);
+}
+
+void Scene::publish_render_records()
+{
+    ++frame_index;
+    destroy_removed_nodes(false);
+
+    // Assets loaded asynchronously became resident since the last frame
+    if (!loading_primitives.empty())
+        register_loaded_primitives();
+
+    // Also catch the primitives modified outside of tick()
+    BEGIN_NAMED_RECORD(PUBLISH_RENDER_RECORDS);
+    update_render_records();
+    render_proxy.publish();
+    spatial_index.update();
+    END_NAMED_RECORD(PUBLISH_RENDER_RECORDS);
+}
 
-        global_model_ssbo->write_buffer(matrix.data(), matrix.size() * sizeof(ModMatrix), 0);
+bool Scene::attach_hierarchy(const std::vector<Node*>& nodes, const std::vector<uint32_t>& parents, Node* root_parent)
+{
+    if (nodes.size() != parents.size())
+    {
+        LOG_ERROR("attach_hierarchy : %zu nodes for %zu parents", nodes.size(), parents.size());
+        return false;
     }
-    else
+    if (root_parent && root_parent->render_scene != this)
+    {
+        LOG_ERROR("attach_hierarchy : the root parent is not owned by this scene");
+        return false;
+    }
+
+    // A node listed twice would be its own ancestor
+    std::vector<const Node*> sorted_nodes(nodes.begin(), nodes.end());
+    std::sort(sorted_nodes.begin(), sorted_nodes.end());
+    if (std::adjacent_find(sorted_nodes.begin(), sorted_nodes.end()) != sorted_nodes.end())
+    {
+        LOG_ERROR("attach_hierarchy : a node is listed more than once");
+        return false;
+    }
+
+    // Parents come first and batch nodes are distinct detached leaves : the batch can't form a cycle
+    for (size_t i = 0; i < nodes.size(); ++i)
+    {
+        const Node* node = nodes[i];
+        if (!node || node->render_scene != this || node->parent || !node->children.empty() || node == root_parent || (parents[i] != UINT32_MAX && parents[i] >= i))
+        {
+            LOG_ERROR("attach_hierarchy : node %zu is invalid, already attached or its parent is not before it", i);
+            return false;
+        }
+    }
+
+    for (size_t i = 0; i < nodes.size(); ++i)
+    {
+        Node* node   = nodes[i];
+        node->parent = parents[i] == UINT32_MAX ? root_parent : nodes[parents[i]];
+        if (node->parent)
+            node->parent->children.emplace_back(node);
+        node->update_world_transform();
+    }
+    b_tick_hierarchy_dirty = true;
+    return true;
+}
+
+void Scene::register_tick(Node* node, uint32_t pool_id, ETickPhase phase)
+{
+    if (tick_batches.size() <= pool_id)
+        tick_batches.resize(pool_id + 1);
+
+    TickBatch& batch = tick_batches[pool_id];
+    batch.phase      = phase;
+    node->tick_index = static_cast<uint32_t>(batch.nodes.size());
+    batch.nodes.emplace_back(node);
+    batch.b_dirty = true;
+}
+
+void Scene::schedule_tick_batch(TickBatch& batch, uint32_t pool_id)
+{
+    // Ticking a node moves its children : the level of a node is its number of ancestors in the same batch
+    std::vector<uint32_t> levels(batch.nodes.size(), 0);
+    uint32_t              level_count = 0;
+    for (size_t i = 0; i < batch.nodes.size(); ++i)
+    {
+        for (const Node* ancestor = batch.nodes[i]->parent; ancestor; ancestor = ancestor->parent)
+            if (ancestor->tick_index != UINT32_MAX && ancestor->handle.pool_id == pool_id)
+                ++levels[i];
+        level_count = std::max(level_count, levels[i] + 1);
+    }
+
+    // Counting sort by level, insertion order is kept inside a level
+    batch.level_ends.assign(level_count, 0);
+    for (const uint32_t level : levels)
+        ++batch.level_ends[level];
+    for (size_t level = 1; level < level_count; ++level)
+        batch.level_ends[level] += batch.level_ends[level - 1];
+
+    batch.scheduled.resize(batch.nodes.size());
+    std::vector<size_t> cursors(level_count, 0);
+    for (size_t level = 1; level < level_count; ++level)
+        cursors[level] = batch.level_ends[level - 1];
+    for (size_t i = 0; i < batch.nodes.size(); ++i)
+        batch.scheduled[cursors[levels[i]]++] = batch.nodes[i];
+
+    batch.b_dirty = false;
+}
+
+void Scene::tick(const double delta_second)
+{
+    BEGIN_NAMED_RECORD(TICK_SCENE);
+    render_proxy.begin_step();
+    spatial_index.update();
+
+    const bool b_reschedule_all = b_tick_hierarchy_dirty;
+    b_tick_hierarchy_dirty      = false;
+
+    // Phases and classes are ticked in a fixed order
+    for (int phase = 0; phase < static_cast<int>(ETickPhase::Count); ++phase)
+    {
+        for (uint32_t pool_id = 0; pool_id < tick_batches.size(); ++pool_id)
+        {
+            TickBatch& batch = tick_batches[pool_id];
+            if (static_cast<int>(batch.phase) != phase || batch.nodes.empty())
+                continue;
+
+            if (batch.b_dirty || b_reschedule_all)
+                schedule_tick_batch(batch, pool_id);
+
+            size_t level_begin = 0;
+            for (const size_t level_end : batch.level_ends)
+            {
+                job_system::parallel_for(level_end - level_begin, [&](size_t i) { batch.scheduled[level_begin + i]->tick(delta_second); });
+                level_begin = level_end;
+            }
+        }
+    }
+
+    // Capture the transforms at the end of the step, they are interpolated from the start of the step ones
+    update_render_records();
+    END_NAMED_RECORD(TICK_SCENE);
+}
+
+void Scene::render_scene(RenderContext render_context)
+{
+    if (!asset_manager)
+    {
+        LOG_ERROR("scenes without asset manager can't be rendered");
+        return;
+    }
+
+    // The camera node can be moved by the simulation running meanwhile : only its published view is read
+    if (!render_proxy.has_view())
     {
         LOG_WARNING("no default camera enabled for this scene");
         return;
     }
-    for (const auto& component : rendered_nodes)
+
+    const RenderView view            = render_proxy.get_view(interpolation_alpha);
+    const glm::dvec3 camera_location = view.location;
+
+    CameraData camera_data = {
+        .world_projection    = make_projection_matrix(render_context),
+        .view_matrix         = glm::lookAt(view.location, view.location + view.forward, view.up),
+        .camera_location     = camera_location,
+        .interpolation_alpha = interpolation_alpha,
+    };
+    camera_uniform_buffer->set_data(camera_data);
+
+    // Vertical resolution covered by a unit length at a distance of 1
+    const LodContext lod_context = {
+        .camera_location = glm::vec3(camera_location),
+        .pixels_per_unit = static_cast<float>(render_context.res_y / (2.0 * std::tan(view.field_of_view * 0.5))),
+        .max_pixel_error = lod_max_pixel_error,
+    };
+
+    const glm::mat4 view_projection = glm::mat4(camera_data.world_projection) * glm::mat4(camera_data.view_matrix);
+
+    occlusion_stats = {};
+    if (b_occlusion_culling)
+        rasterize_occluders(view_projection, glm::vec3(camera_location));
+    const bool b_test_occlusion = occlusion_stats.occluders > 0;
+
+    // The render side only reads the published records
+    BEGIN_NAMED_RECORD(BUILD_RENDER_QUEUE);
+    const size_t record_count = render_proxy.get_record_count();
+    render_lods.resize(render_proxy.get_proxy_id_capacity(), 0);
+    render_queue.reset(record_count);
+    std::atomic<size_t> occluded_count = 0;
+    job_system::parallel_for(record_count, [&](size_t i) {
+        const RenderRecord& record = render_proxy.get_record(i);
+
+        // Occluded items are left unset : the queue never draws them. Moving objects are drawn between their two last transforms, both must be hidden.
+        if (b_test_occlusion)
+        {
+            const Aabb& bounds = record.mesh->get_bounds();
+            if (occlusion_buffer.is_occluded(bounds, record.transform) && occlusion_buffer.is_occluded(bounds, record.previous_transform))
+            {
+                ++occluded_count;
+                return;
+            }
+        }
+
+        uint32_t& lod = render_lods[render_proxy.get_proxy_id(i)];
+        lod                        = select_lod(record, lod_context, lod);
+
+        const glm::vec3 offset = glm::vec3(record.transform[3]) - glm::vec3(camera_location);
+        render_queue.set_item(i, DrawItem{
+                                     .material     = record.material,
+                                     .mesh         = record.mesh,
+                                     .transform    = record.transform,
+                                     .depth        = glm::dot(offset, offset),
+                                     .lod          = lod,
+                                     .object_index = static_cast<uint32_t>(i),
+                                 });
+    });
+    occlusion_stats.occluded = occluded_count;
+    END_NAMED_RECORD(BUILD_RENDER_QUEUE);
+
+    render_queue.sort();
+
+    // Object i is record i : only the records changed since the last frame are written
+    if (global_model_ssbo->get_size() < record_count * sizeof(ModMatrix))
+        global_model_ssbo->resize_buffer(record_count * sizeof(ModMatrix));
+    render_proxy.consume_changes([&](size_t first_record, size_t record_run) {
+        std::vector<ModMatrix> matrices(record_run);
+        for (size_t i = 0; i < record_run; ++i)
+        {
+            const RenderRecord& record = render_proxy.get_record(first_record + i);
+            matrices[i]                = {.a = record.transform, .previous = record.previous_transform};
+            if (record.mesh)
+            {
+                matrices[i].position_scale  = record.mesh->get_position_scale();
+                matrices[i].position_offset = record.mesh->get_position_offset();
+            }
+            if (shadow_renderer)
+                shadow_renderer->mark_record_changed(first_record + i, record);
+        }
+        global_model_ssbo->write_buffer(matrices.data(), record_run * sizeof(ModMatrix), first_record * sizeof(ModMatrix));
+    });
+
+    // Depth passes of the cascades, outside of the main render pass
+    if (shadow_renderer)
+    {
+        const glm::vec3 forward = glm::vec3(view.forward);
+        const glm::vec3 right   = glm::normalize(glm::cross(forward, glm::vec3(view.up)));
+        shadow_renderer->render(render_context, render_proxy, render_lods,
+                                ShadowView{
+                                    .location        = glm::vec3(camera_location),
+                                    .forward         = forward,
+                                    .right           = right,
+                                    .up              = glm::cross(right, forward),
+                                    .tan_half_fov    = std::tan(view.field_of_view * 0.5f),
+                                    .aspect_ratio    = render_context.res_x / static_cast<float>(render_context.res_y),
+                                    .near_clip_plane = view.near_clip_plane,
+                                    .far_clip_plane  = view.far_clip_plane,
+                                });
+    }
+
+    const size_t object_count = render_queue.get_sorted_count();
+
+    IndirectDrawBuffers indirect_buffers = {};
+    if (is_gpu_culling_available(render_context) && object_count > 0)
+    {
+        dispatch_gpu_culling(render_context, view_projection);
+        indirect_buffers.draw_commands = draw_command_ssbo->get_descriptor_buffer_info(render_context.image_index)->buffer;
+        indirect_buffers.draw_counts   = draw_count_ssbo->get_descriptor_buffer_info(render_context.image_index)->buffer;
+    }
+    else if (object_count > 0)
     {
-        component->render(render_context);
+        // Without culling, every instance is drawn : instance i is the object of sorted item i
+        std::vector<uint32_t> instance_ids(object_count);
+        for (uint32_t i = 0; i < instance_ids.size(); ++i)
+            instance_ids[i] = render_queue.get_sorted_item(i).object_index;
+        write_storage_buffer(global_instance_ssbo.operator->(), instance_ids.data(), instance_ids.size() * sizeof(uint32_t));
     }
+
+    render_queue.prepare(render_context.image_index);
+    render_queue.record(render_context, indirect_buffers, b_depth_prepass);
 }
 
-void Scene::set_camera(std::shared_ptr<Camera> new_camera)
+void Scene::rasterize_occluders(const glm::mat4& view_projection, const glm::vec3& camera_location)
+{
+    BEGIN_NAMED_RECORD(SELECT_OCCLUDERS);
+    struct Occluder
+    {
+        size_t record      = 0;
+        float  screen_size = 0.f;
+    };
+    std::vector<Occluder> occluders;
+    for (size_t i = 0; i < render_proxy.get_record_count(); ++i)
+    {
+        const RenderRecord& record = render_proxy.get_record(i);
+        if (!record.mesh || record.mesh->get_occluder_triangles().empty())
+            continue;
+
+        // Moving records are drawn somewhere between their two transforms : they would hide objects where they are not drawn
+        if (record.transform != record.previous_transform)
+            continue;
+
+        const glm::vec4& bounding_sphere = record.mesh->get_bounding_sphere();
+        const float      scale           = glm::max(glm::length(glm::vec3(record.transform[0])), glm::max(glm::length(glm::vec3(record.transform[1])), glm::length(glm::vec3(record.transform[2]))));
+        const glm::vec3  center          = glm::vec3(record.transform * glm::vec4(glm::vec3(bounding_sphere), 1.f));
+        const float      screen_size     = bounding_sphere.w * scale / glm::max(glm::length(center - camera_location), 0.001f);
+        if (screen_size >= config::min_occluder_screen_size)
+            occluders.emplace_back(Occluder{.record = i, .screen_size = screen_size});
+    }
+
+    // Largest first
+    const size_t occluder_count = std::min(occluders.size(), size_t(config::max_occluders));
+    std::partial_sort(occluders.begin(), occluders.begin() + occluder_count, occluders.end(), [](const Occluder& a, const Occluder& b) { return a.screen_size > b.screen_size; });
+
+    occlusion_buffer.begin(view_projection);
+    for (size_t i = 0; i < occluder_count; ++i)
+    {
+        const RenderRecord&           record    = render_proxy.get_record(occluders[i].record);
+        const std::vector<glm::vec3>& triangles = record.mesh->get_occluder_triangles();
+        occlusion_buffer.add_occluder(record.transform, triangles);
+        occlusion_stats.occluder_triangles += triangles.size() / 3;
+    }
+    occlusion_stats.occluders = occluder_count;
+    END_NAMED_RECORD(SELECT_OCCLUDERS);
+
+    if (occluder_count > 0)
+        occlusion_buffer.rasterize();
+}
+
+bool Scene::is_gpu_culling_available(const RenderContext& render_context) const
+{
+    return b_gpu_culling && culling_material && render_context.window && render_context.window->get_gfx_context()->b_supports_draw_indirect_count;
+}
+
+void Scene::dispatch_gpu_culling(const RenderContext& render_context, const glm::mat4& view_projection)
+{
+    BEGIN_NAMED_RECORD(DISPATCH_GPU_CULLING);
+    const size_t object_count = render_queue.get_sorted_count();
+    const size_t batch_count  = render_queue.get_batch_count();
+
+    // Every batch starts with no visible instance, the culling pass appends the visible ones
+    std::vector<CullObject>                   cull_objects(object_count);
+    std::vector<VkDrawIndexedIndirectCommand> draw_commands(batch_count);
+    std::vector<uint32_t>                     draw_counts(batch_count, 0);
+    job_system::parallel_for(batch_count, [&](size_t batch_index) {
+        const DrawBatch& batch = render_queue.get_batch(batch_index);
+        const MeshData*  mesh  = render_queue.get_sorted_item(batch.first_instance).mesh;
+
+        const MeshLod& lod = mesh->get_lod(render_queue.get_sorted_item(batch.first_instance).lod);
+
+        draw_commands[batch_index] = VkDrawIndexedIndirectCommand{
+            .indexCount    = lod.index_count,
+            .instanceCount = 0,
+            .firstIndex    = mesh->get_first_index() + lod.first_index,
+            .vertexOffset  = mesh->get_vertex_offset(),
+            .firstInstance = batch.first_instance,
+        };
+
+        const glm::vec4& local_sphere = mesh->get_bounding_sphere();
+        for (uint32_t i = batch.first_instance; i < batch.first_instance + batch.instance_count; ++i)
+        {
+            const glm::mat4& transform = render_queue.get_sorted_item(i).transform;
+            const float      scale     = glm::max(glm::length(glm::vec3(transform[0])), glm::max(glm::length(glm::vec3(transform[1])), glm::length(glm::vec3(transform[2]))));
+            cull_objects[i].sphere       = glm::vec4(glm::vec3(transform * glm::vec4(glm::vec3(local_sphere), 1.f)), local_sphere.w * scale);
+            cull_objects[i].batch        = static_cast<uint32_t>(batch_index);
+            cull_objects[i].object_index = render_queue.get_sorted_item(i).object_index;
+        }
+    });
+
+    CullingData culling_data;
+    extract_frustum_planes(view_projection, culling_data.frustum_planes);
+    culling_data.object_count = static_cast<uint32_t>(object_count);
+    culling_uniform_buffer->set_data(culling_data);
+
+    write_storage_buffer(cull_object_ssbo.operator->(), cull_objects.data(), cull_objects.size() * sizeof(CullObject));
+    write_storage_buffer(draw_command_ssbo.operator->(), draw_commands.data(), draw_commands.size() * sizeof(VkDrawIndexedIndirectCommand));
+    write_storage_buffer(draw_count_ssbo.operator->(), draw_counts.data(), draw_counts.size() * sizeof(uint32_t));
+
+    // Only written by the gpu
+    if (global_instance_ssbo->get_size() < object_count * sizeof(uint32_t))
+        global_instance_ssbo->resize_buffer(object_count * sizeof(uint32_t));
+
+    culling_material->update_descriptor_sets(render_context.image_index);
+    culling_material->dispatch(render_context.primary_command_buffer, render_context.image_index, static_cast<uint32_t>((object_count + 63) / 64));
+
+    VkMemoryBarrier barrier{};
+    barrier.sType         = VK_STRUCTURE_TYPE_MEMORY_BARRIER;
+    barrier.srcAccessMask = VK_ACCESS_SHADER_WRITE_BIT;
+    barrier.dstAccessMask = VK_ACCESS_INDIRECT_COMMAND_READ_BIT | VK_ACCESS_SHADER_READ_BIT;
+    vkCmdPipelineBarrier(render_context.primary_command_buffer, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, VK_PIPELINE_STAGE_DRAW_INDIRECT_BIT | VK_PIPELINE_STAGE_VERTEX_SHADER_BIT, 0, 1, &barrier, 0, nullptr, 0, nullptr);
+    END_NAMED_RECORD(DISPATCH_GPU_CULLING);
+}
+
+void Scene::set_camera(Camera* new_camera)
 {
     if (new_camera->get_render_scene() != this)
     {
         LOG_ERROR("cannot set scene's default camera if the camera is not owned by the scene : %x", this);
     }
-    else
-        enabled_camera = std::move(new_camera);
+    else if (enabled_camera != new_camera)
+    {
+        // The new camera is not interpolated from the previous one
+        enabled_camera = new_camera;
+        render_proxy.reset_view();
+    }
 }
 
 glm::dmat4 Scene::make_projection_matrix(const RenderContext& render_context) const
 {
-    if (!enabled_camera)
+    if (!render_proxy.has_view())
         return glm::dmat4(1.0);
-    return glm::perspective<double>(enabled_camera->get_field_of_view(), render_context.res_x / static_cast<double>(render_context.res_y), enabled_camera->get_near_clip_plane(), enabled_camera->get_far_clip_plane());
+    const RenderView view = render_proxy.get_view(interpolation_alpha);
+    return glm::perspective<double>(view.field_of_view, render_context.res_x / static_cast<double>(render_context.res_y), view.near_clip_plane, view.far_clip_plane);
 }
@@ -0,0 +1,164 @@
+
+
+#include "scene/scene_snapshot.h"
+
+#include "ios/mapped_file.h"
+#include "scene/node_base.h"
+#include "scene/scene.h"
+#include "statsRecorder.h"
+
+#include <fstream>
+
+using namespace scene_snapshot;
+
+namespace
+{
+// Whether count elements starting at offset are inside the file. Can't overflow, whatever the header contains.
+bool is_range_in_file(uint64_t offset, uint64_t count, size_t element_size, size_t file_size)
+{
+    return offset <= file_size && count <= (file_size - offset) / element_size;
+}
+} // namespace
+
+bool Scene::save_snapshot(const std::filesystem::path& file_path) const
+{
+    BEGIN_NAMED_RECORD(SAVE_SCENE_SNAPSHOT);
+    std::vector<NodeRecord> records;
+    std::vector<uint64_t>   assets;
+    records.reserve(scene_nodes.size());
+
+    // Depth first from the roots so parents are always written before their children
+    struct PendingNode
+    {
+        const Node* node;
+        uint32_t    parent;
+    };
+    std::vector<PendingNode> pending;
+    for (const Node* node : scene_nodes)
+        if (!node->parent)
+            pending.emplace_back(PendingNode{node, UINT32_MAX});
+
+    const uint64_t       base_type = hash_type_name("Node");
+    std::vector<AssetId> node_assets;
+    while (!pending.empty())
+    {
+        const PendingNode current = pending.back();
+        pending.pop_back();
+        const Node* node = current.node;
+
+        const uint32_t pool_id = node->handle.pool_id;
+        const bool     b_known = pool_id < node_types.size() && node_types[pool_id].factory;
+
+        node_assets.clear();
+        if (b_known)
+            node->get_snapshot_assets(node_assets);
+
+        records.emplace_back(NodeRecord{
+            .type        = b_known ? node_types[pool_id].type : base_type,
+            .parent      = current.parent,
+            .first_asset = static_cast<uint32_t>(assets.size()),
+            .asset_count = static_cast<uint32_t>(node_assets.size()),
+            .position    = {node->rel_position.x, node->rel_position.y, node->rel_position.z},
+            .rotation    = {node->rel_rotation.w, node->rel_rotation.x, node->rel_rotation.y, node->rel_rotation.z},
+            .scale       = {node->rel_scale.x, node->rel_scale.y, node->rel_scale.z},
+        });
+        for (const AssetId& asset : node_assets)
+            assets.emplace_back(asset());
+
+        const auto index = static_cast<uint32_t>(records.size() - 1);
+        for (const Node* child : node->children)
+            pending.emplace_back(PendingNode{child, index});
+    }
+
+    const Header header = {
+        .node_count   = static_cast<uint32_t>(records.size()),
+        .asset_count  = static_cast<uint32_t>(assets.size()),
+        .nodes_offset = sizeof(Header),
+        .asset_offset = sizeof(Header) + records.size() * sizeof(NodeRecord),
+    };
+
+    std::ofstream file(file_path, std::ios::binary | std::ios::trunc);
+    if (!file)
+    {
+        LOG_ERROR("failed to write snapshot %s", file_path.string().c_str());
+        return false;
+    }
+    file.write(reinterpret_cast<const char*>(&header), sizeof(Header));
+    file.write(reinterpret_cast<const char*>(records.data()), static_cast<std::streamsize>(records.size() * sizeof(NodeRecord)));
+    file.write(reinterpret_cast<const char*>(assets.data()), static_cast<std::streamsize>(assets.size() * sizeof(uint64_t)));
+    END_NAMED_RECORD(SAVE_SCENE_SNAPSHOT);
+
+    LOG_INFO("saved %zu nodes to %s", records.size(), file_path.string().c_str());
+    return file.good();
+}
+
+std::vector<Node*> Scene::load_snapshot(const std::filesystem::path& file_path)
+{
+    BEGIN_NAMED_RECORD(LOAD_SCENE_SNAPSHOT);
+    std::vector<Node*> roots;
+
+    const MappedFile file(file_path);
+    if (!file.is_valid() || file.get_size() < sizeof(Header))
+    {
+        LOG_ERROR("failed to read snapshot %s", file_path.string().c_str());
+        return roots;
+    }
+
+    const auto* header = reinterpret_cast<const Header*>(file.get_data());
+    if (header->magic != magic || header->version != version)
+    {
+        LOG_ERROR("%s is not a scene snapshot or has an outdated version (%u, expected %u)", file_path.string().c_str(), header->version, version);
+        return roots;
+    }
+    if (!is_range_in_file(header->nodes_offset, header->node_count, sizeof(NodeRecord), file.get_size()) || !is_range_in_file(header->asset_offset, header->asset_count, sizeof(uint64_t), file.get_size()) ||
+        header->nodes_offset % 8 != 0 || header->asset_offset % 8 != 0)
+    {
+        LOG_ERROR("snapshot %s is truncated", file_path.string().c_str());
+        return roots;
+    }
+
+    const auto* records = reinterpret_cast<const NodeRecord*>(file.get_data() + header->nodes_offset);
+    const auto* assets  = reinterpret_cast<const uint64_t*>(file.get_data() + header->asset_offset);
+
+    // Parents are created first : each node is attached and gets its world transform in O(1), without the attach_to() checks
+    std::vector<Node*>   nodes(header->node_count, nullptr);
+    std::vector<AssetId> node_assets;
+    for (uint32_t i = 0; i < header->node_count; ++i)
+    {
+        const NodeRecord& record = records[i];
+
+        Node* node = nullptr;
+        if (const auto factory = node_factories.find(record.type); factory != node_factories.end())
+        {
+            node_assets.clear();
+            if (uint64_t(record.first_asset) + record.asset_count <= header->asset_count)
+                for (uint32_t asset = 0; asset < record.asset_count; ++asset)
+                    node_assets.emplace_back(static_cast<size_t>(assets[record.first_asset + asset]));
+            node = factory->second(*this, asset_manager, node_assets.data(), static_cast<uint32_t>(node_assets.size()));
+        }
+        // Keep the hierarchy of unknown or unusable nodes
+        if (!node)
+            node = add_node<Node>();
+        nodes[i] = node;
+
+        node->rel_position = glm::dvec3(record.position[0], record.position[1], record.position[2]);
+        node->rel_rotation = glm::dquat(record.rotation[0], record.rotation[1], record.rotation[2], record.rotation[3]);
+        node->rel_scale    = glm::dvec3(record.scale[0], record.scale[1], record.scale[2]);
+
+        if (record.parent < i)
+        {
+            node->parent = nodes[record.parent];
+            node->parent->children.emplace_back(node);
+        }
+        else
+            roots.emplace_back(node);
+
+        // The node has no children yet
+        node->update_world_transform();
+    }
+    b_tick_hierarchy_dirty = true;
+    END_NAMED_RECORD(LOAD_SCENE_SNAPSHOT);
+
+    LOG_INFO("loaded %u nodes from %s", header->node_count, file_path.string().c_str());
+    return roots;
+}
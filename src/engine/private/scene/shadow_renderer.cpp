@@ -0,0 +1,334 @@
+
+
+#include "scene/shadow_renderer.h"
+
+#include "assets/asset_base.h"
+#include "assets/asset_mesh_data.h"
+#include "assets/asset_shadow_material.h"
+#include "assets/asset_uniform_buffer.h"
+#include "config.h"
+#include "engine_interface.h"
+#include "jobSystem/job_system.h"
+#include "rendering/vulkan/shadow_map.h"
+#include "rendering/vulkan/utils.h"
+#include "rendering/window.h"
+#include "statsRecorder.h"
+
+#include <algorithm>
+#include <glm/gtc/matrix_transform.hpp>
+
+static glm::vec4 make_world_sphere(const glm::vec4& local_sphere, const glm::mat4& transform)
+{
+    const float scale = glm::max(glm::length(glm::vec3(transform[0])), glm::max(glm::length(glm::vec3(transform[1])), glm::length(glm::vec3(transform[2]))));
+    return glm::vec4(glm::vec3(transform * glm::vec4(glm::vec3(local_sphere), 1.f)), local_sphere.w * scale);
+}
+
+ShadowRenderer::ShadowRenderer(AssetManager* asset_manager, const TAssetPtr<Shader>& vertex_shader, const TAssetPtr<ShaderBuffer>& camera_uniform_buffer, const TAssetPtr<ShaderBuffer>& model_ssbo)
+{
+    const uint32_t cascade_count = std::clamp(config::shadow_cascade_count, 1u, max_cascades);
+
+    shadow_map = std::make_unique<ShadowMap>(get_engine_interface()->get_gfx_context(), config::shadow_map_resolution, cascade_count);
+    cascades.resize(cascade_count);
+    cascade_batches.resize(cascade_count);
+
+    shadow_uniform_buffer  = asset_manager->create<ShaderBuffer>("shadow_uniform_buffer", "ShadowUniformBuffer", ShadowData{}, VK_BUFFER_USAGE_UNIFORM_BUFFER_BIT);
+    shadow_instance_buffer = asset_manager->create<ShaderBuffer>("shadow_instance_buffer", "ShadowInstanceBuffer", sizeof(uint32_t) * 100, VK_BUFFER_USAGE_STORAGE_BUFFER_BIT);
+
+    const ShaderStageData vertex_stage{
+        .shader          = vertex_shader,
+        .uniform_buffer  = {camera_uniform_buffer, shadow_uniform_buffer},
+        .storage_buffers = {model_ssbo, shadow_instance_buffer},
+    };
+    shadow_material = asset_manager->create<ShadowMaterial>("shadow_material", vertex_stage, shadow_map->get_render_pass());
+}
+
+ShadowRenderer::~ShadowRenderer() = default;
+
+const VkDescriptorImageInfo& ShadowRenderer::get_shadow_map_image_info() const
+{
+    return shadow_map->get_descriptor_image_info();
+}
+
+void ShadowRenderer::set_sun_direction(const glm::vec3& direction)
+{
+    const glm::vec3 new_direction = glm::normalize(direction);
+    if (new_direction == sun_direction)
+        return;
+
+    // Every cascade is refitted to the new light orientation
+    sun_direction = new_direction;
+    for (Cascade& cascade : cascades)
+        cascade.radius = 0.f;
+}
+
+void ShadowRenderer::mark_record_changed(size_t record_index, const RenderRecord& record)
+{
+    // Records were added since the last frame : everything is rebuilt by render()
+    if (b_all_dirty || record_index >= caster_bounds.size())
+    {
+        b_all_dirty = true;
+        return;
+    }
+
+    // Clear the shadow where the record was last drawn, and draw it where it is now
+    CasterBounds& bounds = caster_bounds[record_index];
+    mark_dirty(bounds);
+
+    const glm::vec4& local_sphere = record.mesh->get_bounding_sphere();
+    bounds.sphere                 = make_world_sphere(local_sphere, record.transform);
+    bounds.previous_sphere        = make_world_sphere(local_sphere, record.previous_transform);
+    bounds.b_moving               = record.transform != record.previous_transform;
+    mark_dirty(bounds);
+}
+
+void ShadowRenderer::mark_dirty(const CasterBounds& bounds)
+{
+    for (Cascade& cascade : cascades)
+    {
+        if (!cascade.b_dirty && overlaps(cascade, bounds))
+            cascade.b_dirty = true;
+    }
+}
+
+bool ShadowRenderer::overlaps(const Cascade& cascade, const CasterBounds& bounds) const
+{
+    // Not fitted yet, it will be rendered anyway
+    if (cascade.radius <= 0.f)
+        return true;
+
+    // Orthographic projection : clip w is 1, the sphere radius scales uniformly in xy
+    const auto overlaps_sphere = [&](const glm::vec4& sphere) {
+        const glm::vec4 clip   = cascade.view_projection * glm::vec4(glm::vec3(sphere), 1.f);
+        const float     extent = 1.f + sphere.w / cascade.radius;
+        const float     depth  = sphere.w / cascade.depth_range;
+        return std::abs(clip.x) <= extent && std::abs(clip.y) <= extent && clip.z >= -depth && clip.z <= 1.f + depth;
+    };
+    return overlaps_sphere(bounds.sphere) || (bounds.b_moving && overlaps_sphere(bounds.previous_sphere));
+}
+
+void ShadowRenderer::fit_cascades(const ShadowView& view)
+{
+    const uint32_t cascade_count = static_cast<uint32_t>(cascades.size());
+    const float    near_plane    = view.near_clip_plane;
+    const float    far_plane     = std::max(std::min(view.far_clip_plane, config::shadow_distance), near_plane * 2.f);
+
+    // The light rotation doesn't depend on the cascade : every cascade snaps to the same texel grid orientation
+    const glm::vec3 up_axis        = std::abs(sun_direction.z) > 0.99f ? glm::vec3(1, 0, 0) : glm::vec3(0, 0, 1);
+    const glm::mat4 light_rotation = glm::lookAt(glm::vec3(0), -sun_direction, up_axis);
+
+    float split_begin = near_plane;
+    for (uint32_t c = 0; c < cascade_count; ++c)
+    {
+        // Practical split scheme : logarithmic splits keep the texel density constant on screen, uniform ones avoid wasting the last cascades
+        const float ratio     = static_cast<float>(c + 1) / static_cast<float>(cascade_count);
+        const float log_split = near_plane * std::pow(far_plane / near_plane, ratio);
+        const float uni_split = near_plane + (far_plane - near_plane) * ratio;
+        const float split_end = config::shadow_split_lambda * log_split + (1.f - config::shadow_split_lambda) * uni_split;
+        shadow_data.cascade_splits[c] = split_end;
+
+        // Bounding sphere of the slice : its radius doesn't change when the camera turns
+        glm::vec3 corners[8];
+        for (int i = 0; i < 8; ++i)
+        {
+            const float depth  = i < 4 ? split_begin : split_end;
+            const float half_y = depth * view.tan_half_fov;
+            const float half_x = half_y * view.aspect_ratio;
+            corners[i]         = view.location + view.forward * depth + view.right * (i & 1 ? half_x : -half_x) + view.up * (i & 2 ? half_y : -half_y);
+        }
+        split_begin = split_end;
+
+        glm::vec3 center(0);
+        for (const glm::vec3& corner : corners)
+            center += corner / 8.f;
+        float radius = 0.f;
+        for (const glm::vec3& corner : corners)
+            radius = std::max(radius, glm::length(corner - center));
+        radius = std::ceil(radius * 16.f) / 16.f;
+
+        // The fitted sphere still contains the slice : keep the cascade and its content
+        Cascade&    cascade       = cascades[c];
+        const float fitted_radius = radius * (1.f + config::shadow_update_margin);
+        if (cascade.radius == fitted_radius && glm::length(center - cascade.center) <= radius * config::shadow_update_margin)
+            continue;
+
+        // Moving the center by whole texels keeps the shadow edges from shimmering between refits
+        const float texel_size   = 2.f * fitted_radius / static_cast<float>(shadow_map->get_resolution());
+        glm::vec3   light_center = glm::vec3(light_rotation * glm::vec4(center, 1.f));
+        light_center.x           = std::floor(light_center.x / texel_size) * texel_size;
+        light_center.y           = std::floor(light_center.y / texel_size) * texel_size;
+
+        cascade.center      = glm::vec3(glm::transpose(light_rotation) * glm::vec4(light_center, 1.f));
+        cascade.radius      = fitted_radius;
+        cascade.depth_range = config::shadow_caster_distance + fitted_radius;
+
+        const glm::mat4 light_view = glm::lookAt(cascade.center + sun_direction * config::shadow_caster_distance, cascade.center, up_axis);
+        cascade.view_projection    = glm::orthoRH_ZO(-fitted_radius, fitted_radius, -fitted_radius, fitted_radius, 0.f, cascade.depth_range) * light_view;
+        cascade.b_dirty            = true;
+    }
+}
+
+void ShadowRenderer::render(const RenderContext& render_context, const RenderProxy& render_proxy, const std::vector<uint32_t>& render_lods, const ShadowView& view)
+{
+    stats = ShadowStats{};
+    if (!render_context.window)
+        return;
+
+    BEGIN_NAMED_RECORD(RENDER_SHADOWS);
+    const size_t record_count = render_proxy.get_record_count();
+
+    fit_cascades(view);
+
+    if (b_all_dirty || caster_bounds.size() != record_count)
+    {
+        // Records were added or removed : dense indices can't be matched with the last frame ones
+        caster_bounds.resize(record_count);
+        for (size_t i = 0; i < record_count; ++i)
+        {
+            const RenderRecord& record       = render_proxy.get_record(i);
+            const glm::vec4&    local_sphere = record.mesh->get_bounding_sphere();
+            caster_bounds[i]                 = CasterBounds{
+                .sphere          = make_world_sphere(local_sphere, record.transform),
+                .previous_sphere = make_world_sphere(local_sphere, record.previous_transform),
+                .b_moving        = record.transform != record.previous_transform,
+            };
+        }
+        for (Cascade& cascade : cascades)
+            cascade.b_dirty = true;
+        b_all_dirty = false;
+    }
+    else
+    {
+        // Moving records are interpolated every frame, even without a new simulation step
+        for (const CasterBounds& bounds : caster_bounds)
+            if (bounds.b_moving)
+                mark_dirty(bounds);
+    }
+
+    for (uint32_t c = 0; c < cascades.size(); ++c)
+        shadow_data.cascade_view_projection[c] = cascades[c].view_projection;
+    shadow_data.sun_direction = glm::vec4(sun_direction, 0.f);
+    shadow_data.cascade_count = static_cast<uint32_t>(cascades.size());
+    shadow_uniform_buffer->set_data(shadow_data);
+
+    std::vector<uint32_t> dirty_cascades;
+    for (uint32_t c = 0; c < cascades.size(); ++c)
+        if (cascades[c].b_dirty)
+            dirty_cascades.emplace_back(c);
+    if (dirty_cascades.empty())
+    {
+        END_NAMED_RECORD(RENDER_SHADOWS);
+        return;
+    }
+
+    // Cull the casters of each dirty cascade and batch them by mesh and lod. Cascade c owns the instances [c * record count, (c + 1) * record count[
+    instance_ids.resize(cascades.size() * record_count);
+    job_system::parallel_for(
+        dirty_cascades.size(),
+        [&](size_t i) {
+            const uint32_t c       = dirty_cascades[i];
+            const uint32_t base    = static_cast<uint32_t>(c * record_count);
+            const Cascade& cascade = cascades[c];
+            auto&          batches = cascade_batches[c];
+            batches.clear();
+
+            std::vector<uint64_t> keys;
+            for (size_t r = 0; r < record_count; ++r)
+            {
+                if (!overlaps(cascade, caster_bounds[r]))
+                    continue;
+                const RenderRecord& record = render_proxy.get_record(r);
+                const uint32_t      lod    = std::min(render_lods[render_proxy.get_proxy_id(r)], record.mesh->get_lod_count() - 1);
+                keys.emplace_back(static_cast<uint64_t>(record.mesh->get_render_id()) << 40 | static_cast<uint64_t>(lod) << 32 | r);
+            }
+            std::sort(keys.begin(), keys.end());
+
+            for (uint32_t k = 0; k < keys.size(); ++k)
+            {
+                const uint32_t      r      = static_cast<uint32_t>(keys[k]);
+                const uint32_t      lod    = static_cast<uint32_t>(keys[k] >> 32) & 0xFF;
+                const RenderRecord& record = render_proxy.get_record(r);
+                if (batches.empty() || batches.back().mesh != record.mesh || batches.back().lod != lod)
+                    batches.emplace_back(ShadowBatch{.mesh = record.mesh, .lod = lod, .first_instance = base + k});
+                ++batches.back().instance_count;
+                instance_ids[base + k] = r;
+            }
+        },
+        1);
+
+    if (shadow_instance_buffer->get_size() < instance_ids.size() * sizeof(uint32_t))
+        shadow_instance_buffer->resize_buffer(instance_ids.size() * sizeof(uint32_t));
+    for (const uint32_t c : dirty_cascades)
+    {
+        size_t instance_count = 0;
+        for (const ShadowBatch& batch : cascade_batches[c])
+            instance_count += batch.instance_count;
+        if (instance_count > 0)
+            shadow_instance_buffer->write_buffer(&instance_ids[c * record_count], instance_count * sizeof(uint32_t), c * record_count * sizeof(uint32_t));
+        stats.casters += instance_count;
+        stats.draws += cascade_batches[c].size();
+    }
+    shadow_material->update_descriptor_sets(render_context.image_index);
+
+    // One secondary command buffer per cascade, recorded on the workers
+    const uint32_t               resolution = shadow_map->get_resolution();
+    std::vector<VkCommandBuffer> command_buffers(dirty_cascades.size());
+    job_system::parallel_for(
+        dirty_cascades.size(),
+        [&](size_t i) {
+            const uint32_t c   = dirty_cascades[i];
+            command_buffers[i] = render_context.window->begin_secondary_command_buffer(shadow_map->get_render_pass(), shadow_map->get_framebuffer(c), VkExtent2D{resolution, resolution});
+            EVertexPositionFormat bound_format = EVertexPositionFormat::Unorm16;
+            shadow_material->bind(command_buffers[i], render_context.image_index, c, bound_format);
+
+            const GeometryBlock* bound_vertex_block = nullptr;
+            const GeometryBlock* bound_index_block  = nullptr;
+            for (const ShadowBatch& batch : cascade_batches[c])
+            {
+                const GeometryAllocation& geometry = batch.mesh->get_geometry();
+                if (geometry.vertex_block != bound_vertex_block)
+                {
+                    // The pipeline layout is shared : the descriptor set stays bound
+                    const EVertexPositionFormat position_format = geometry.vertex_block->vertex_layout.position_format;
+                    if (position_format != bound_format)
+                    {
+                        vkCmdBindPipeline(command_buffers[i], VK_PIPELINE_BIND_POINT_GRAPHICS, shadow_material->get_pipeline(position_format));
+                        bound_format = position_format;
+                    }
+                    geometry.vertex_block->bind_vertex_buffers(command_buffers[i], true);
+                    bound_vertex_block = geometry.vertex_block;
+                }
+                if (geometry.index_block != bound_index_block)
+                {
+                    geometry.index_block->bind_index_buffer(command_buffers[i]);
+                    bound_index_block = geometry.index_block;
+                }
+                const MeshLod& lod = batch.mesh->get_lod(batch.lod);
+                vkCmdDrawIndexed(command_buffers[i], lod.index_count, batch.instance_count, batch.mesh->get_first_index() + lod.first_index, batch.mesh->get_vertex_offset(), batch.first_instance);
+            }
+            VK_ENSURE(vkEndCommandBuffer(command_buffers[i]), "Failed to record shadow cascade %d", c);
+        },
+        1);
+
+    // The passes are executed before the main render pass, which samples every layer
+    VkClearValue clear_value{};
+    clear_value.depthStencil = {1.0f, 0};
+    for (size_t i = 0; i < dirty_cascades.size(); ++i)
+    {
+        VkRenderPassBeginInfo render_pass_info{};
+        render_pass_info.sType             = VK_STRUCTURE_TYPE_RENDER_PASS_BEGIN_INFO;
+        render_pass_info.renderPass        = shadow_map->get_render_pass();
+        render_pass_info.framebuffer       = shadow_map->get_framebuffer(dirty_cascades[i]);
+        render_pass_info.renderArea.offset = {0, 0};
+        render_pass_info.renderArea.extent = VkExtent2D{resolution, resolution};
+        render_pass_info.clearValueCount   = 1;
+        render_pass_info.pClearValues      = &clear_value;
+
+        vkCmdBeginRenderPass(render_context.primary_command_buffer, &render_pass_info, VK_SUBPASS_CONTENTS_SECONDARY_COMMAND_BUFFERS);
+        vkCmdExecuteCommands(render_context.primary_command_buffer, 1, &command_buffers[i]);
+        vkCmdEndRenderPass(render_context.primary_command_buffer);
+
+        cascades[dirty_cascades[i]].b_dirty = false;
+    }
+    stats.cascades_rendered = dirty_cascades.size();
+    END_NAMED_RECORD(RENDER_SHADOWS);
+}
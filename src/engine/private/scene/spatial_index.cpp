@@ -0,0 +1,128 @@
+
+
+#include "scene/spatial_index.h"
+
+#include "jobSystem/job_system.h"
+#include "statsRecorder.h"
+
+void SpatialIndex::set_instance(uint32_t id, NodeHandle node, const MeshBvh* mesh, const glm::mat4& transform)
+{
+    if (!mesh)
+    {
+        remove_instance(id);
+        return;
+    }
+
+    if (instances.size() <= id)
+        instances.resize(id + 1);
+
+    Instance& instance = instances[id];
+    if (!instance.mesh)
+        b_rebuild = true;
+    b_refit = true;
+
+    instance = {
+        .node           = node,
+        .mesh           = mesh,
+        .local_to_world = transform,
+        .world_to_local = glm::inverse(transform),
+    };
+}
+
+void SpatialIndex::remove_instance(uint32_t id)
+{
+    if (id >= instances.size() || !instances[id].mesh)
+        return;
+    instances[id] = {};
+    b_rebuild     = true;
+}
+
+void SpatialIndex::update()
+{
+    if (!b_rebuild && !b_refit)
+        return;
+
+    BEGIN_NAMED_RECORD(UPDATE_SPATIAL_INDEX);
+    if (b_rebuild)
+    {
+        instance_ids.clear();
+        for (uint32_t id = 0; id < instances.size(); ++id)
+            if (instances[id].mesh)
+                instance_ids.emplace_back(id);
+    }
+
+    instance_bounds.resize(instance_ids.size());
+    for (size_t i = 0; i < instance_ids.size(); ++i)
+    {
+        const Instance& instance = instances[instance_ids[i]];
+        instance_bounds[i]       = instance.mesh->get_bounds().transformed(instance.local_to_world);
+    }
+
+    if (!b_rebuild)
+    {
+        top_level.refit(instance_bounds);
+        b_rebuild = top_level.get_cost() > built_cost * max_refit_cost_ratio;
+    }
+    if (b_rebuild)
+    {
+        top_level.build(instance_bounds);
+        built_cost = top_level.get_cost();
+    }
+
+    b_rebuild = false;
+    b_refit   = false;
+    END_NAMED_RECORD(UPDATE_SPATIAL_INDEX);
+}
+
+bool SpatialIndex::raycast(const Ray& ray, RayHit& out_hit) const
+{
+    out_hit = {};
+    top_level.traverse(ray, [&](uint32_t primitive, float& max_distance) {
+        const Instance& instance = instances[instance_ids[primitive]];
+
+        // The local direction is not normalized so local and world hit distances are the same
+        const Ray local_ray = {
+            .origin       = glm::vec3(instance.world_to_local * glm::vec4(ray.origin, 1.f)),
+            .direction    = glm::vec3(instance.world_to_local * glm::vec4(ray.direction, 0.f)),
+            .max_distance = max_distance,
+        };
+
+        uint32_t  triangle;
+        glm::vec3 local_normal;
+        if (!instance.mesh->raycast(local_ray, max_distance, triangle, local_normal))
+            return;
+
+        out_hit = {
+            .node     = instance.node,
+            .triangle = triangle,
+            .distance = max_distance,
+            .position = ray.origin + ray.direction * max_distance,
+            .normal   = glm::normalize(glm::transpose(glm::mat3(instance.world_to_local)) * local_normal),
+        };
+    });
+    return out_hit.is_valid();
+}
+
+void SpatialIndex::overlap_box(const Aabb& box, std::vector<NodeHandle>& out_nodes) const
+{
+    top_level.traverse(box, [&](uint32_t primitive) {
+        const Instance& instance = instances[instance_ids[primitive]];
+        if (instance.mesh->overlaps(box.transformed(instance.world_to_local)))
+            out_nodes.emplace_back(instance.node);
+    });
+}
+
+void SpatialIndex::raycast_batch(const std::vector<Ray>& rays, std::vector<RayHit>& out_hits) const
+{
+    out_hits.resize(rays.size());
+    job_system::parallel_for(rays.size(), [&](size_t i) { raycast(rays[i], out_hits[i]); }, 16);
+}
+
+void SpatialIndex::overlap_box_batch(const std::vector<Aabb>& boxes, std::vector<std::vector<NodeHandle>>& out_nodes) const
+{
+    out_nodes.resize(boxes.size());
+    job_system::parallel_for(boxes.size(), [&](size_t i) {
+        out_nodes[i].clear();
+        overlap_box(boxes[i], out_nodes[i]);
+    }, 16);
+}
@@ -599,6 +599,7 @@ bool ImGuiInstance::ImGui_ImplVulkan_CreateDeviceObjects()
     info.pDynamicState                = &dynamic_state;
     info.layout                       = g_PipelineLayout;
     info.renderPass                   = g_window_context->get_render_pass();
+    info.subpass                      = Window::color_subpass;
     err                               = vkCreateGraphicsPipelines(v->get_gfx_context()->logical_device, g_pipeline_cache, 1, &info, vulkan_common::allocation_callback, &g_Pipeline);
     VK_ENSURE(err);
 
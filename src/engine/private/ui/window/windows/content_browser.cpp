@@ -4,6 +4,9 @@
 
 #include "engine_interface.h"
 #include "assets/asset_base.h"
+#include "assets/asset_mesh_data.h"
+#include "assets/asset_uploader.h"
+#include "assets/geometry_pool.h"
 #include "imgui.h"
 
 void ContentBrowser::draw_content()
@@ -13,6 +16,26 @@ void ContentBrowser::draw_content()
         ImGui::Text("failed to find content browser !");
         return;
     }
-    const auto& content = get_context()->get_asset_manager()->get_assets();
-    for (auto& item : content) { ImGui::Text("%s : %s", item.first.to_string().c_str(), item.second->try_load() ? "ready" : "loading"); }
+    AssetManager* asset_manager = get_context()->get_asset_manager();
+
+    const auto budget_text = [](size_t bytes) { return bytes == SIZE_MAX ? std::string("-") : std::to_string(bytes / 1024) + " KB"; };
+    for (const auto& stats : asset_manager->get_memory_stats())
+    {
+        const bool b_over_budget = stats.b_budgeted && (stats.cpu_bytes > stats.budget.cpu_bytes || stats.gpu_bytes > stats.budget.gpu_bytes);
+        ImGui::TextColored(b_over_budget ? ImVec4(1, 0.3f, 0.3f, 1) : ImVec4(1, 1, 1, 1), "%s : %zu assets (%zu cached, %zu evicted) | cpu %zu KB / %s | gpu %zu KB / %s", stats.name.c_str(), stats.asset_count,
+                           stats.unreferenced_count, stats.evicted_count, stats.cpu_bytes / 1024, budget_text(stats.budget.cpu_bytes).c_str(), stats.gpu_bytes / 1024, budget_text(stats.budget.gpu_bytes).c_str());
+    }
+    ImGui::Text("mesh cpu data released after upload : %zu KB", MeshData::get_released_cpu_bytes() / 1024);
+    const GeometryPoolStats geometry_stats = asset_manager->get_geometry_pool()->get_stats();
+    ImGui::Text("geometry pool : %zu meshes in %zu blocks | %zu KB used / %zu KB", geometry_stats.allocation_count, geometry_stats.block_count, geometry_stats.used_bytes / 1024, geometry_stats.reserved_bytes / 1024);
+    ImGui::Separator();
+
+    const auto& content = asset_manager->get_assets();
+    for (auto& item : content)
+    {
+        ImGui::Text("%s : %s | refs %u | last used %llu | cpu %zu KB | gpu %zu KB", item.first.to_string().c_str(), item.second->try_load() ? "ready" : "loading", item.second->get_ref_count(),
+                    static_cast<unsigned long long>(item.second->get_last_used_frame()), item.second->get_cpu_bytes() / 1024, item.second->get_gpu_bytes() / 1024);
+    }
+    for (const auto& id : asset_manager->get_loading_assets()) { ImGui::Text("%s : loading", id.to_string().c_str()); }
+    ImGui::Text("pending uploads : %llu bytes", static_cast<unsigned long long>(asset_manager->get_uploader()->get_pending_bytes()));
 }
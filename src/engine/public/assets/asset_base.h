@@ -1,11 +1,20 @@
 #pragma once
+#include <algorithm>
+#include <atomic>
+#include <cstdint>
+#include <functional>
 #include <memory>
 #include <mutex>
+#include <new>
 #include <optional>
+#include <tuple>
+#include <typeindex>
 #include <unordered_map>
+#include <vector>
 
 #include "asset_id.h"
 #include "asset_ptr.h"
+#include "asset_registry.h"
 #include "types/nonCopiable.h"
 
 #include <cpputils/logger.hpp>
@@ -13,56 +22,200 @@
 class GfxContext;
 class Window;
 class AssetBase;
+class AssetUploader;
+class GeometryPool;
 class IEngineInterface;
 
+namespace job_system
+{
+class IJobTask;
+}
+
+// Memory limits of an asset class, unlimited by default
+struct AssetBudget
+{
+    size_t cpu_bytes = SIZE_MAX;
+    size_t gpu_bytes = SIZE_MAX;
+};
+
+// Memory used by the resident assets of a class
+struct AssetClassStats
+{
+    std::string name;
+    bool        b_budgeted         = false;
+    AssetBudget budget             = {};
+    size_t      asset_count        = 0;
+    size_t      unreferenced_count = 0; // Cached assets that can be evicted
+    size_t      cpu_bytes          = 0;
+    size_t      gpu_bytes          = 0;
+    size_t      evicted_count      = 0; // Since the start
+};
+
 class AssetManager final
 {
   public:
-    AssetManager(IEngineInterface* in_engine_interface) : engine_interface(in_engine_interface)
-    {
-    }
+    AssetManager(IEngineInterface* in_engine_interface);
     ~AssetManager();
 
+    // Construct the asset on the calling thread and wait for its gpu uploads : it is resident when returned
     template <class AssetClass, typename... Args> TAssetPtr<AssetClass> create(const AssetId& asset_id, Args... args)
     {
-        if (exists(asset_id))
-        {
-            LOG_ERROR("Cannot create two asset with the same id : %s", asset_id.to_string().c_str());
+        AssetSlot* slot = reserve(asset_id);
+        if (!slot)
             return nullptr;
-        }
-
-        AssetClass* asset_ptr = static_cast<AssetClass*>(std::malloc(sizeof(AssetClass)));
-        if (!asset_ptr)
-            LOG_FATAL("failed to create asset storage");
-        asset_ptr->internal_constructor(engine_interface, asset_id);
 
+        AssetClass* asset_ptr = allocate<AssetClass>(asset_id);
         new (asset_ptr) AssetClass(std::forward<Args>(args)...);
-        register_lock.lock();
-        assets[asset_id] = asset_ptr;
-        register_lock.unlock();
+        make_resident(slot, asset_ptr);
         return asset_ptr;
     }
 
-    bool exists(const AssetId& id)
+    /**
+     * Load the asset on a worker and return immediately : loader() reads and decodes the data there, it returns the tuple of the constructor arguments.
+     * The asset is then constructed on the same worker and its gpu uploads are batched on the transfer queue.
+     * Pointers to this asset resolve once it is resident, which is checked by update() : the frame never waits for a load.
+     */
+    template <class AssetClass, typename Loader> TAssetPtr<AssetClass> create_async(const AssetId& asset_id, Loader loader)
+    {
+        const bool b_started = load_async(asset_id, [this, asset_id, loader]() -> AssetBase* {
+            AssetClass* asset_ptr = allocate<AssetClass>(asset_id);
+            std::apply([asset_ptr](auto&&... args) { new (asset_ptr) AssetClass(std::forward<decltype(args)>(args)...); }, loader());
+            return asset_ptr;
+        });
+        if (!b_started)
+            return nullptr;
+        return TAssetPtr<AssetClass>(this, asset_id);
+    }
+
+    // Submit the requested uploads and publish the assets that became resident. Called once per frame, never blocks.
+    void update();
+
+    // Resident or loading. Lock-free.
+    [[nodiscard]] bool exists(const AssetId& id) const
+    {
+        const AssetSlot* slot = registry.find(id);
+        return slot && slot->b_reserved.load(std::memory_order_acquire);
+    }
+
+    // Null until the asset is resident. Lock-free.
+    [[nodiscard]] AssetBase* find(const AssetId& id) const
     {
-        return assets.find(id) != assets.end();
+        const AssetSlot* slot = registry.find(id);
+        return slot ? slot->asset.load(std::memory_order_acquire) : nullptr;
     }
-    
-    [[nodiscard]] AssetBase* find(const AssetId& id);
+
+    // Registry slot of this id, null if it was never used. Asset pointers cache it. Lock-free.
+    [[nodiscard]] const AssetSlot* find_slot(const AssetId& id) const
+    {
+        return registry.find(id);
+    }
+
     [[nodiscard]] AssetId                                 find_valid_asset_id(const std::string& asset_name);
     [[nodiscard]] std::unordered_map<AssetId, AssetBase*> get_assets();
+    [[nodiscard]] std::vector<AssetId>                    get_loading_assets();
+
+    [[nodiscard]] AssetUploader* get_uploader() const
+    {
+        return uploader.get();
+    }
+
+    [[nodiscard]] IEngineInterface* get_engine_interface() const
+    {
+        return engine_interface;
+    }
+
+    // Shared vertex and index buffers of the meshes
+    [[nodiscard]] GeometryPool* get_geometry_pool() const
+    {
+        return geometry_pool.get();
+    }
 
+    /**
+     * Unreferenced assets of a class with a budget stay cached until the class exceeds its budget, then the least recently used are evicted first.
+     * Unreferenced assets of other classes stay cached until shutdown. Assets that were never referenced stay resident.
+     */
+    template <class AssetClass> void set_budget(const AssetBudget& budget)
+    {
+        std::lock_guard<std::mutex> lock(memory_lock);
+        AssetClassStats&            stats = get_class_stats(typeid(AssetClass));
+        stats.b_budgeted                  = true;
+        stats.budget                      = budget;
+    }
+
+    [[nodiscard]] std::vector<AssetClassStats> get_memory_stats();
+
+    // Incremented by update(), assets are stamped with it when they are accessed
+    [[nodiscard]] uint64_t get_frame() const
+    {
+        return frame.load(std::memory_order_relaxed);
+    }
 
   private:
-    std::mutex                              register_lock;
-    std::unordered_map<AssetId, AssetBase*> assets;
-    IEngineInterface*                       engine_interface;
+    friend class AssetBase;
+
+    template <class AssetClass> AssetClass* allocate(const AssetId& asset_id)
+    {
+        // Global operator new : assets are destroyed with delete once evicted
+        AssetClass* asset_ptr = static_cast<AssetClass*>(::operator new(sizeof(AssetClass), std::nothrow));
+        if (!asset_ptr)
+            LOG_FATAL("failed to create asset storage");
+        asset_ptr->internal_constructor(engine_interface, asset_id);
+        return asset_ptr;
+    }
+
+    // Reserve the slot of a new asset. Null if the id is already used, or if its name collides with the one of another asset.
+    AssetSlot* reserve(const AssetId& asset_id);
+
+    // Wait for the uploads of the asset then publish it
+    void make_resident(AssetSlot* slot, AssetBase* asset);
+
+    // Return false if the id is already used
+    bool load_async(const AssetId& asset_id, std::function<AssetBase*()> load);
+
+    // Called when the last pointer to this asset dropped it. Thread safe.
+    void release(AssetBase* asset);
+
+    // Evict the unreferenced assets exceeding the budget of their class. Requires the memory lock.
+    void evict_unreferenced();
+
+    // Release the id of the asset : it is destroyed once the frames in flight are complete. Requires the memory lock.
+    void unload(AssetBase* asset);
+
+    // Deferred by unload()
+    void destroy_unloaded(AssetBase* asset);
+
+    // Account the memory of an asset that became resident
+    void track(AssetBase* asset);
+
+    // Requires the memory lock
+    AssetClassStats& get_class_stats(const std::type_index& asset_class);
+
+    struct LoadingAsset
+    {
+        AssetSlot*                            slot  = nullptr;
+        std::shared_ptr<job_system::IJobTask> job   = nullptr;
+        std::atomic<AssetBase*>               asset = nullptr; // Set by the job once constructed, its uploads may still be running
+    };
+
+    AssetRegistry                              registry;
+    std::mutex                                 loading_lock;
+    std::vector<std::unique_ptr<LoadingAsset>> loading_assets;
+    std::unique_ptr<AssetUploader>             uploader;
+    std::unique_ptr<GeometryPool>              geometry_pool;
+    IEngineInterface*                          engine_interface;
+    std::atomic_bool                           b_shutting_down = false; // Assets are not unloaded anymore, they are all destroyed with the manager
+    std::atomic_uint64_t                       frame           = 0;
+
+    std::mutex                                           memory_lock;
+    std::unordered_map<std::type_index, AssetClassStats> class_stats  = {};
+    std::vector<AssetBase*>                              unreferenced = {}; // Resident assets whose last pointer was dropped
 };
 
 class AssetBase : public NonCopiable
 {
   public:
     friend class AssetManager;
+    friend class IAssetPtr;
 
     virtual std::string to_string()
     {
@@ -78,7 +231,35 @@ class AssetBase : public NonCopiable
 
     virtual bool try_load()
     {
-        return false;
+        return is_resident();
+    }
+
+    // Constructed and its gpu uploads complete
+    [[nodiscard]] bool is_resident() const
+    {
+        return b_resident;
+    }
+
+    // Asset pointers currently referencing this asset
+    [[nodiscard]] uint32_t get_ref_count() const
+    {
+        return ref_count.load(std::memory_order_relaxed);
+    }
+
+    // Last frame of the asset manager where a pointer accessed this asset
+    [[nodiscard]] uint64_t get_last_used_frame() const
+    {
+        return last_used_frame.load(std::memory_order_relaxed);
+    }
+
+    // Memory owned by the asset, accounted in the budget of its class. Sampled when the asset becomes resident.
+    [[nodiscard]] virtual size_t get_cpu_bytes() const
+    {
+        return 0;
+    }
+    [[nodiscard]] virtual size_t get_gpu_bytes() const
+    {
+        return 0;
     }
 
     [[nodiscard]] IEngineInterface* get_engine_interface() const
@@ -97,6 +278,12 @@ class AssetBase : public NonCopiable
     {
     }
 
+    // The asset is only resident once the upload of this ticket completed (see AssetUploader)
+    void set_upload_ticket(uint64_t ticket)
+    {
+        upload_ticket = std::max(upload_ticket, ticket);
+    }
+
   private:
     void internal_constructor(IEngineInterface* in_engine_interface, const AssetId& id)
     {
@@ -104,6 +291,29 @@ class AssetBase : public NonCopiable
         asset_id         = new AssetId(id);
     }
 
-    AssetId*          asset_id;
-    IEngineInterface* engine_interface;
+    // Only used by the asset pointers
+    void add_ref()
+    {
+        ref_count.fetch_add(1, std::memory_order_relaxed);
+    }
+    void release_ref();
+
+    // Only stored when it changes : the assets used every frame don't keep writing the same cache line
+    void touch(uint64_t frame)
+    {
+        if (last_used_frame.load(std::memory_order_relaxed) != frame)
+            last_used_frame.store(frame, std::memory_order_relaxed);
+    }
+
+    AssetId*             asset_id;
+    IEngineInterface*    engine_interface;
+    std::atomic_bool     b_resident      = false;
+    uint64_t             upload_ticket   = 0;
+    std::atomic_uint32_t ref_count       = 0;
+    std::atomic_uint64_t last_used_frame = 0;
+
+    // Written under the memory lock of the asset manager
+    bool   b_unreferenced    = false;
+    size_t tracked_cpu_bytes = 0;
+    size_t tracked_gpu_bytes = 0;
 };
\ No newline at end of file
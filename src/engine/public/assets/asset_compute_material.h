@@ -0,0 +1,49 @@
+#pragma once
+#include "asset_base.h"
+#include "asset_material.h"
+
+/**
+ * Compute pipeline built from a single compute shader stage.
+ * Uniform and storage buffers are bound by name like Material's.
+ */
+class ComputeMaterial : public AssetBase
+{
+  public:
+    ComputeMaterial(const ShaderStageData& in_compute_stage);
+    virtual ~ComputeMaterial() override;
+
+    [[nodiscard]] VkPipelineLayout get_pipeline_layout() const
+    {
+        return pipeline_layout;
+    }
+    [[nodiscard]] VkPipeline get_pipeline() const
+    {
+        return compute_pipeline;
+    }
+    [[nodiscard]] const std::vector<VkDescriptorSet>& get_descriptor_sets() const
+    {
+        return descriptor_sets;
+    }
+
+    void update_descriptor_sets(size_t image_index);
+
+    // Bind the pipeline and the descriptor set of this image then dispatch. Must be recorded outside of a render pass.
+    void dispatch(VkCommandBuffer command_buffer, uint32_t image_index, uint32_t group_count_x, uint32_t group_count_y = 1, uint32_t group_count_z = 1) const;
+
+  private:
+    void destroy_resources();
+
+    std::vector<VkDescriptorSetLayoutBinding> make_layout_bindings();
+    void                                      create_pipeline();
+    void                                      create_descriptor_sets(const std::vector<VkDescriptorSetLayoutBinding>& layout_bindings);
+
+    ShaderStageData compute_stage = {};
+
+    std::unordered_map<std::string, uint32_t> ssbo_bindings;
+    std::unordered_map<std::string, uint32_t> uniform_bindings;
+
+    VkDescriptorSetLayout        descriptor_set_layout = VK_NULL_HANDLE;
+    std::vector<VkDescriptorSet> descriptor_sets       = {};
+    VkPipelineLayout             pipeline_layout       = VK_NULL_HANDLE;
+    VkPipeline                   compute_pipeline      = VK_NULL_HANDLE;
+};
@@ -1,5 +1,8 @@
 #pragma once
+#include <atomic>
+#include <cstdint>
 #include <string>
+#include <string_view>
 
 class AssetId;
 
@@ -11,31 +14,93 @@ namespace std
 		std::size_t operator()(const AssetId& other) const noexcept;
 	};
 }
+
+/**
+ * 64 bits FNV-1a hash of the asset name. String literals are hashed at compile time in constant expressions (or with "name"_id).
+ * The names of the registered assets are kept in a side table available in every build : for to_string() and to detect two names hashing to the same id.
+ */
 class AssetId final
 {
 public:
-	AssetId(const size_t id_val);
-	AssetId(const AssetId& other);
-	AssetId(const AssetId&& other) noexcept;
-	AssetId(const std::string& name);
-	AssetId(const char* name) : AssetId(std::string(name)) {}
+	constexpr AssetId(const size_t id_val) : id(id_val) {}
+	constexpr AssetId(const AssetId& other) : id(other.id), name(other.name), runtime_name(other.runtime_name) { add_runtime_name_ref(); }
+	constexpr ~AssetId() { release_runtime_name(); }
+
+	// String literal : the name points to the literal, no name is recorded. Immediate so a runtime char buffer can't bind here : use the std::string constructor.
+	template <size_t N> consteval AssetId(const char (&literal)[N]) : id(hash_name(std::string_view(literal, N - 1))), name(literal, N - 1) {}
 
-	size_t operator()() const { return id; }
+	// Runtime name : hashed without locking. The copies of the id share a copy of the name, it is only interned by register_name().
+	AssetId(std::string in_name);
 
-	AssetId& operator=(const AssetId& other) { id = other.id; return *this; }
-	bool operator==(const AssetId& other) const { return other.id == id; }
+	static constexpr size_t hash_name(std::string_view in_name)
+	{
+		uint64_t hash = 0xcbf29ce484222325;
+		for (const char c : in_name)
+		{
+			hash ^= static_cast<uint8_t>(c);
+			hash *= 0x100000001b3;
+		}
+		return static_cast<size_t>(hash);
+	}
 
+	constexpr size_t operator()() const { return id; }
+
+	constexpr AssetId& operator=(const AssetId& other)
+	{
+		if (this == &other)
+			return *this;
+		other.add_runtime_name_ref();
+		release_runtime_name();
+		id           = other.id;
+		name         = other.name;
+		runtime_name = other.runtime_name;
+		return *this;
+	}
+	constexpr bool operator==(const AssetId& other) const { return other.id == id; }
+
+	/**
+	 * Record the name of this id when its asset is created, runtime names are interned here. Returns false if another name was recorded with the same id.
+	 * Ids built from a raw hash have no name and are always accepted.
+	 */
+	[[nodiscard]] bool register_name() const;
+
+	// The name if known, else the hash
 	[[nodiscard]] std::string to_string() const;
 
 private:
 
 	friend class AssetBase;
+	friend consteval AssetId operator""_id(const char* literal, size_t length);
 	AssetId() = default;
+	constexpr AssetId(std::string_view literal, size_t id_val) : id(id_val), name(literal) {}
 	
 	friend std::size_t std::hash<AssetId>::operator()(const AssetId& other) const noexcept;
-	
-	size_t id;
-#ifdef _DEBUG
-	std::string asset_name;
-#endif
+
+	struct RuntimeName
+	{
+		std::atomic_uint32_t ref_count = 1;
+		std::string          value;
+	};
+
+	// Never called in constant expressions : ids built there have no runtime name
+	constexpr void add_runtime_name_ref() const
+	{
+		if (runtime_name)
+			runtime_name->ref_count.fetch_add(1, std::memory_order_relaxed);
+	}
+	constexpr void release_runtime_name()
+	{
+		if (runtime_name && runtime_name->ref_count.fetch_sub(1, std::memory_order_acq_rel) == 1)
+			delete runtime_name;
+		runtime_name = nullptr;
+	}
+
+	size_t           id           = 0;
+	std::string_view name         = {};      // Static storage : a literal
+	RuntimeName*     runtime_name = nullptr; // Null for literals and raw hashes
 };
+
+consteval AssetId operator""_id(const char* literal, size_t length)
+{
+	return AssetId(std::string_view(literal, length), AssetId::hash_name(std::string_view(literal, length)));
+}
@@ -4,6 +4,8 @@
 #include "asset_shader.h"
 #include "rendering/vulkan/descriptor_pool.h"
 
+#include <array>
+
 class ShaderBuffer;
 class Shader;
 
@@ -89,31 +91,58 @@ class PushConstant
     bool   b_is_dirty = false;
 };
 
+// Image bound by name to a combined image sampler of the shader
+struct SampledImage
+{
+    std::string           name       = {};
+    VkDescriptorImageInfo image_info = {};
+};
+
 struct ShaderStageData
 {
     TAssetPtr<Shader>                     shader         = nullptr;
     std::vector<TAssetPtr<ShaderBuffer>> uniform_buffer = {};
     std::vector<TAssetPtr<ShaderBuffer>> storage_buffers = {};
+    std::vector<SampledImage>            sampled_images  = {};
+};
+
+// Pipelines of a material, one per way it is drawn in the frame's render pass
+enum class EMaterialPass
+{
+    Color,                  // Depth tested and written
+    ColorAfterDepthPrepass, // Only shades the fragments whose depth equals the pre-pass one, depth is not written
+    DepthPrepass,           // Vertex stage only, in the depth pre-pass subpass
+    Count
 };
 
 class Material : public AssetBase
 {
   public:
-    Material(const ShaderStageData& in_vertex_stage, const ShaderStageData& in_fragment_stage, const std::shared_ptr<PushConstant>& in_push_constant = nullptr);
+    // Meshes drawn with this material must use its vertex layout
+    Material(const ShaderStageData& in_vertex_stage, const ShaderStageData& in_fragment_stage, const std::shared_ptr<PushConstant>& in_push_constant = nullptr, const VertexLayout& in_vertex_layout = {});
     virtual ~Material() override;
 
     [[nodiscard]] VkPipelineLayout get_pipeline_layout() const
     {
         return pipeline_layout;
     }
-    [[nodiscard]] VkPipeline get_pipeline() const
+    [[nodiscard]] VkPipeline get_pipeline(EMaterialPass pass = EMaterialPass::Color) const
     {
-        return shader_pipeline;
+        return pipelines[static_cast<size_t>(pass)];
     }
     [[nodiscard]] const std::vector<VkDescriptorSet>& get_descriptor_sets() const
     {
         return descriptor_sets;
     }
+    // Dense id used by the render queue to group draws sharing this material
+    [[nodiscard]] uint32_t get_render_id() const
+    {
+        return render_id;
+    }
+    [[nodiscard]] const VertexLayout& get_vertex_layout() const
+    {
+        return vertex_layout;
+    }
     void update_push_constants(VkCommandBuffer& command_buffer);
 
     void update_descriptor_sets(size_t imageIndex);
@@ -128,14 +157,18 @@ class Material : public AssetBase
     ShaderStageData               vertex_stage   = {};
     ShaderStageData               fragment_stage = {};
     std::shared_ptr<PushConstant> push_constant  = nullptr;
+    VertexLayout                  vertex_layout  = {};
 
     std::unordered_map<std::string, uint32_t> vertex_ssbo_bindings;
     std::unordered_map<std::string, uint32_t> fragment_ssbo_bindings;
     std::unordered_map<std::string, uint32_t> vertex_uniform_bindings;
     std::unordered_map<std::string, uint32_t> fragment_uniform_bindings;
+    std::unordered_map<std::string, uint32_t> vertex_image_bindings;
+    std::unordered_map<std::string, uint32_t> fragment_image_bindings;
 
     VkDescriptorSetLayout        descriptor_set_layout = VK_NULL_HANDLE;
     std::vector<VkDescriptorSet> descriptor_sets       = {};
     VkPipelineLayout             pipeline_layout       = VK_NULL_HANDLE;
-    VkPipeline                   shader_pipeline       = VK_NULL_HANDLE;
+    std::array<VkPipeline, static_cast<size_t>(EMaterialPass::Count)> pipelines = {};
+    uint32_t                     render_id             = 0;
 };
\ No newline at end of file
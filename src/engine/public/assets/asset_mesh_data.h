@@ -1,57 +1,198 @@
 #pragma once
 
 #include "asset_base.h"
+#include "geometry_pool.h"
+#include "scene/bvh.h"
+#include "vertex_layout.h"
 
 #include <glm/glm.hpp>
-#include <vk_mem_alloc.h>
 
 #include <vulkan/vulkan_core.h>
 
-struct Vertex
+// A level of detail is a range of the mesh index buffer
+struct MeshLod
 {
-    glm::vec3 pos    = glm::vec3();
-    glm::vec2 uv     = glm::vec2();
-    glm::vec4 col    = glm::vec4();
-    glm::vec3 norm   = glm::vec3();
-    glm::vec3 tang   = glm::vec3();
-    glm::vec3 bitang = glm::vec3();
-
-    static VkVertexInputBindingDescription get_binding_description();
+    uint32_t first_index = 0;
+    uint32_t index_count = 0;
+    float    error       = 0.f; // Object space deviation from the full resolution mesh
+};
 
-    static std::vector<VkVertexInputAttributeDescription> get_attribute_descriptions();
+// Mesh data kept in cpu memory once the vertex and index buffers are staged for upload
+enum class EMeshCpuResidency
+{
+    Released,  // Nothing but the occluder triangles : the mesh is ignored by the spatial queries
+    Collision, // Positions and indices of the full resolution lod, for the spatial queries (raycasts, overlaps, picking)
+    Full,      // Also the vertices and indices, for tools editing the mesh
 };
 
 class MeshData : public AssetBase
 {
   public:
-    MeshData(std::vector<Vertex> in_vertices, std::vector<uint32_t> in_indices);
+    // Lods index ranges in in_indices. If empty, the whole index buffer is the only lod.
+    MeshData(std::vector<Vertex> in_vertices, std::vector<uint32_t> in_indices, std::vector<MeshLod> in_lods = {}, EMeshCpuResidency in_cpu_residency = EMeshCpuResidency::Collision,
+             const VertexLayout& in_vertex_layout = {});
     virtual ~MeshData();
 
-[[nodiscard]] const VkBuffer& get_vertex_buffer() const
+    // Range of the mesh in the geometry pool. Meshes sharing its blocks are drawn without rebinding the buffers.
+    [[nodiscard]] const GeometryAllocation& get_geometry() const
     {
-        return vertex_buffer;
+        return geometry;
     }
 
-    [[nodiscard]] const VkBuffer& get_index_buffer() const
+    // False if the mesh data was empty : nothing was allocated in the pool and the mesh can't be drawn
+    [[nodiscard]] bool has_geometry() const
     {
-        return index_buffer;
+        return geometry.pool != nullptr;
     }
+
+    // Bind the blocks of the pool holding this mesh. Depth only pipelines only read the position stream.
+    void bind_vertex_buffers(VkCommandBuffer command_buffer, bool b_position_only = false) const
+    {
+        geometry.vertex_block->bind_vertex_buffers(command_buffer, b_position_only);
+    }
+    void bind_index_buffer(VkCommandBuffer command_buffer) const
+    {
+        geometry.index_block->bind_index_buffer(command_buffer);
+    }
+
+    // Draw arguments : lod first indices are relative to get_first_index(), the indices to get_vertex_offset()
+    [[nodiscard]] uint32_t get_first_index() const
+    {
+        return geometry.first_index;
+    }
+    [[nodiscard]] int32_t get_vertex_offset() const
+    {
+        return static_cast<int32_t>(geometry.first_vertex);
+    }
+
+    [[nodiscard]] const VertexLayout& get_vertex_layout() const
+    {
+        return vertex_layout;
+    }
+
+    // Shaders dequantize the positions with position * scale + offset
+    [[nodiscard]] glm::vec4 get_position_scale() const
+    {
+        return vertex_layout.get_position_scale(bounds);
+    }
+    [[nodiscard]] glm::vec4 get_position_offset() const
+    {
+        return vertex_layout.get_position_offset(bounds);
+    }
+
+    // 16 bits when every vertex can be addressed with them, chosen at upload
+    [[nodiscard]] VkIndexType get_index_type() const
+    {
+        return index_type;
+    }
+    [[nodiscard]] size_t get_index_size() const
+    {
+        return index_type == VK_INDEX_TYPE_UINT16 ? sizeof(uint16_t) : sizeof(uint32_t);
+    }
+    // Size of the index buffer, including every lod
     [[nodiscard]] uint32_t get_indices_count() const
     {
-        return static_cast<uint32_t>(indices.size());
+        return index_count;
+    }
+
+    [[nodiscard]] uint32_t get_vertex_count() const
+    {
+        return vertex_count;
+    }
+
+    [[nodiscard]] EMeshCpuResidency get_cpu_residency() const
+    {
+        return cpu_residency;
+    }
+
+    // Empty unless the cpu residency is Full
+    [[nodiscard]] const std::vector<Vertex>& get_vertices() const
+    {
+        return vertices;
+    }
+    [[nodiscard]] const std::vector<uint32_t>& get_indices() const
+    {
+        return indices;
+    }
+
+    [[nodiscard]] uint32_t get_lod_count() const
+    {
+        return static_cast<uint32_t>(lods.size());
+    }
+
+    [[nodiscard]] const MeshLod& get_lod(uint32_t lod_index) const
+    {
+        return lods[lod_index];
+    }
+
+    /**
+     * Coarsest lod whose error, seen at pixels_per_unit pixels per object space unit, stays under max_pixel_error.
+     * Switching to a coarser lod than current_lod requires the error to be hysteresis (ratio) below the limit to avoid popping.
+     */
+    [[nodiscard]] uint32_t select_lod(float pixels_per_unit, float max_pixel_error, float hysteresis, uint32_t current_lod) const;
+
+    // Local space bounding sphere : xyz = center, w = radius
+    [[nodiscard]] const glm::vec4& get_bounding_sphere() const
+    {
+        return bounding_sphere;
+    }
+
+    // Local space bounds of the vertices
+    [[nodiscard]] const Aabb& get_bounds() const
+    {
+        return bounds;
     }
 
+    // Local space triangle bvh of the full resolution lod, used by the scene spatial queries. Empty if the cpu residency is Released.
+    [[nodiscard]] const MeshBvh& get_bvh() const
+    {
+        return bvh;
+    }
+
+    [[nodiscard]] bool has_collision() const
+    {
+        return !bvh.is_empty();
+    }
+
+    // Local space triangle positions of the coarsest lod, rasterized when the mesh is selected as an occluder
+    [[nodiscard]] const std::vector<glm::vec3>& get_occluder_triangles() const
+    {
+        return occluder_triangles;
+    }
+
+    // Dense id used by the render queue to group draws sharing this mesh, reused once the mesh is destroyed
+    [[nodiscard]] uint32_t get_render_id() const
+    {
+        return render_id;
+    }
+
+    [[nodiscard]] size_t get_cpu_bytes() const override;
+    [[nodiscard]] size_t get_gpu_bytes() const override;
+
+    // Cpu bytes freed by the meshes since the start, once their data was staged for upload
+    [[nodiscard]] static size_t get_released_cpu_bytes();
+
   private:
     void set_mesh_data(const std::vector<Vertex>& in_vertices, const std::vector<uint32_t>& in_indices);
 
+    // Free the data the cpu residency doesn't keep
+    void release_cpu_data();
+
     std::vector<Vertex>   vertices;
     std::vector<uint32_t> indices;
+    std::vector<MeshLod>  lods;
+    uint32_t              vertex_count  = 0;
+    uint32_t              index_count   = 0;
+    EMeshCpuResidency     cpu_residency = EMeshCpuResidency::Collision;
+    VertexLayout          vertex_layout = {};
+
+    GeometryAllocation geometry   = {};
+    VkIndexType        index_type = VK_INDEX_TYPE_UINT32;
 
-    VkBuffer          vertex_buffer            = VK_NULL_HANDLE;
-    VmaAllocation     vertex_buffer_allocation = VK_NULL_HANDLE;
-    VmaAllocationInfo vertex_buffer_alloc_info = {};
+    glm::vec4 bounding_sphere = glm::vec4(0);
+    Aabb      bounds          = {};
+    MeshBvh   bvh             = {};
+    uint32_t  render_id       = 0;
 
-    VkBuffer          index_buffer            = VK_NULL_HANDLE;
-    VmaAllocation     index_buffer_allocation = VK_NULL_HANDLE;
-    VmaAllocationInfo index_buffer_alloc_info = {};
+    std::vector<glm::vec3> occluder_triangles = {};
 };
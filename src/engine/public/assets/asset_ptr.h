@@ -1,12 +1,14 @@
 #pragma once
 
-#include <memory>
+#include <cstdint>
+#include <optional>
 
 #include "asset_id.h"
 
 class AssetManager;
 class Window;
 class AssetBase;
+struct AssetSlot;
 
 class IAssetPtr
 {
@@ -14,19 +16,21 @@ class IAssetPtr
     IAssetPtr();
     IAssetPtr(AssetManager* in_asset_manager, const AssetId& in_asset_id);
     IAssetPtr(AssetBase* in_asset);
-    explicit IAssetPtr(const IAssetPtr& other) : asset_manager(other.asset_manager), asset_id(other.asset_id), asset(other.asset)
-    {
-    }
+    explicit IAssetPtr(const IAssetPtr& other);
+    IAssetPtr(IAssetPtr&& other) noexcept;
+    IAssetPtr& operator=(const IAssetPtr& other);
+    IAssetPtr& operator=(IAssetPtr&& other) noexcept;
 
     void set(AssetBase* in_asset);
     void set(AssetManager* asset_manager, const AssetId& in_asset_id);
     void clear();
 
+    // Once resolved, a single load checks that the cached asset is still the one registered for this id
     [[nodiscard]] AssetBase* get();
     [[nodiscard]] AssetBase* get_const() const;
     [[nodiscard]] AssetId    id() const
     {
-        return *asset_id.get();
+        return *asset_id;
     }
 
     virtual ~IAssetPtr();
@@ -42,9 +46,17 @@ class IAssetPtr
     }
 
   private:
-    AssetManager*            asset_manager = nullptr;
-    std::shared_ptr<AssetId> asset_id      = nullptr;
-    AssetBase*               asset         = nullptr;
+    // Look the slot up and cache its asset
+    AssetBase* resolve();
+
+    // Drop the reference held on the cached asset
+    void release_asset();
+
+    AssetManager*          asset_manager = nullptr;
+    std::optional<AssetId> asset_id      = std::nullopt;
+    AssetBase*             asset         = nullptr; // Referenced while cached : the last pointer dropping it unloads the asset
+    const AssetSlot*       slot          = nullptr;
+    uint32_t               generation    = 0; // Of the slot when asset was cached
 };
 
 template <class AssetClass> class TAssetPtr final : public IAssetPtr
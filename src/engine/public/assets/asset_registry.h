@@ -0,0 +1,96 @@
+#pragma once
+
+#include <array>
+#include <atomic>
+#include <memory>
+#include <mutex>
+#include <vector>
+
+#include "asset_id.h"
+
+class AssetBase;
+
+// Registry entry of an asset id. Slots are never freed : a pointer to a slot stays valid as long as the registry.
+struct AssetSlot
+{
+    size_t                  id         = 0;       // AssetId value, written before the slot is published
+    std::atomic<AssetBase*> asset      = nullptr; // Null while loading
+    std::atomic_uint32_t    generation = 0;       // Incremented each time the asset of this id is released
+    std::atomic_bool        b_reserved = false;   // The id is used, by a loading or a resident asset
+};
+
+/**
+ * Concurrent map from asset ids to their slot.
+ * Lookups are lock-free : they probe an open addressing table of slot indices, published with release stores.
+ * Writers are serialized but never block the readers : when the table grows, the new one is filled before being swapped in,
+ * the previous tables are kept until the registry is destroyed since readers may still be probing them.
+ */
+class AssetRegistry final
+{
+  public:
+    AssetRegistry();
+    ~AssetRegistry();
+
+    // Slot of this id, or null if it was never reserved. Lock-free.
+    [[nodiscard]] AssetSlot* find(const AssetId& id) const;
+
+    // Reserve the slot of this id. Returns null if it is already reserved.
+    AssetSlot* reserve(const AssetId& id);
+
+    // Make the asset visible to the lookups
+    static void publish(AssetSlot* slot, AssetBase* asset)
+    {
+        slot->asset.store(asset, std::memory_order_release);
+    }
+
+    // Unpublish the asset and free the id : cached pointers to this slot see a new generation
+    static void release(AssetSlot* slot);
+
+    // Call func(slot) for every reserved slot
+    template <typename Lambda> void for_each(Lambda&& func) const
+    {
+        const uint32_t count = slot_count.load(std::memory_order_acquire);
+        for (uint32_t i = 0; i < count; ++i)
+        {
+            AssetSlot* slot = get_slot(i);
+            if (slot->b_reserved.load(std::memory_order_acquire))
+                func(slot);
+        }
+    }
+
+  private:
+    static constexpr uint32_t chunk_size = 1024;
+    static constexpr uint32_t max_chunks = 1024;
+
+    // Buckets store slot index + 1, 0 is empty. Capacity is a power of two.
+    struct Table
+    {
+        explicit Table(size_t in_capacity) : capacity(in_capacity), buckets(std::make_unique<std::atomic_uint32_t[]>(in_capacity))
+        {
+        }
+
+        size_t                                  capacity;
+        std::unique_ptr<std::atomic_uint32_t[]> buckets;
+    };
+
+    [[nodiscard]] AssetSlot* get_slot(uint32_t index) const
+    {
+        return &chunks[index / chunk_size].load(std::memory_order_acquire)[index % chunk_size];
+    }
+
+    static size_t bucket_of(size_t id, size_t capacity)
+    {
+        return (id * 0x9E3779B97F4A7C15ull >> 32) & (capacity - 1);
+    }
+
+    // Requires the write lock
+    static void insert(Table& table, size_t id, uint32_t slot_index);
+    void        grow();
+
+    std::array<std::atomic<AssetSlot*>, max_chunks> chunks     = {};
+    std::atomic_uint32_t                            slot_count = 0;
+    std::atomic<Table*>                             table      = nullptr;
+
+    std::mutex                          write_lock;
+    std::vector<std::unique_ptr<Table>> tables = {}; // Current table last
+};
@@ -8,7 +8,8 @@ enum class EShaderStage
 {
     VertexShader,
     FragmentShader,
-    GeometryShader
+    GeometryShader,
+    ComputeShader
 };
 
 enum class EShaderPropertyType
@@ -0,0 +1,50 @@
+#pragma once
+#include "asset_base.h"
+#include "asset_material.h"
+
+/**
+ * Depth only graphic pipeline built from a single vertex stage, rendering into a shadow map render pass.
+ * Uniform and storage buffers are bound by name like Material's. The cascade index is a uint32 push constant of the vertex stage.
+ * Only the position stream of the meshes is read : there is one pipeline per position format, sharing the same layout.
+ */
+class ShadowMaterial : public AssetBase
+{
+  public:
+    ShadowMaterial(const ShaderStageData& in_vertex_stage, VkRenderPass in_render_pass);
+    virtual ~ShadowMaterial() override;
+
+    [[nodiscard]] VkPipelineLayout get_pipeline_layout() const
+    {
+        return pipeline_layout;
+    }
+    [[nodiscard]] VkPipeline get_pipeline(EVertexPositionFormat position_format) const
+    {
+        return shadow_pipelines[static_cast<size_t>(position_format)];
+    }
+    [[nodiscard]] const std::vector<VkDescriptorSet>& get_descriptor_sets() const
+    {
+        return descriptor_sets;
+    }
+
+    void update_descriptor_sets(size_t image_index);
+
+    // Bind the pipeline of this position format, the descriptor set of this image and the cascade index
+    void bind(VkCommandBuffer command_buffer, uint32_t image_index, uint32_t cascade, EVertexPositionFormat position_format) const;
+
+  private:
+    void destroy_resources();
+
+    std::vector<VkDescriptorSetLayoutBinding> make_layout_bindings();
+    void                                      create_pipeline(VkRenderPass render_pass);
+    void                                      create_descriptor_sets(const std::vector<VkDescriptorSetLayoutBinding>& layout_bindings);
+
+    ShaderStageData vertex_stage = {};
+
+    std::unordered_map<std::string, uint32_t> ssbo_bindings;
+    std::unordered_map<std::string, uint32_t> uniform_bindings;
+
+    VkDescriptorSetLayout        descriptor_set_layout = VK_NULL_HANDLE;
+    std::vector<VkDescriptorSet> descriptor_sets       = {};
+    VkPipelineLayout             pipeline_layout       = VK_NULL_HANDLE;
+    std::array<VkPipeline, static_cast<size_t>(EVertexPositionFormat::Count)> shadow_pipelines = {};
+};
@@ -1,6 +1,7 @@
 #pragma once
 #include "asset_base.h"
 
+#include <algorithm>
 #include <glm/glm.hpp>
 #include <string.h>
 #include <vulkan/vulkan.h>
@@ -34,19 +35,22 @@ class ShaderBuffer : public AssetBase
         }
     }
 
+    // Only the written range is uploaded to the gpu buffers
     void write_buffer(const void* in_data, size_t in_size, size_t in_offset = 0)
     {
         if (in_size + in_offset > data_size)
         {
             LOG_WARNING("trying to write out of buffer range");
+            return;
         }
-        
+
         if (in_data)
-            memcpy(static_cast<char*>(data) + in_offset, in_data, data_size);
+            memcpy(static_cast<char*>(data) + in_offset, in_data, in_size);
 
-        for (int i = 0; i < dirty_buffers.size(); ++i)
+        for (auto& range : dirty_ranges)
         {
-            dirty_buffers[i] = true;
+            range.begin = range.begin < range.end ? std::min(range.begin, in_offset) : in_offset;
+            range.end   = std::max(range.end, in_offset + in_size);
         }
     }
 
@@ -55,9 +59,28 @@ class ShaderBuffer : public AssetBase
         return buffer_name;
     }
 
+    [[nodiscard]] size_t get_size() const
+    {
+        return data_size;
+    }
+
+    [[nodiscard]] size_t get_cpu_bytes() const override
+    {
+        return data_size;
+    }
+
+    // One buffer per swapchain image, created when the image first uses it
+    [[nodiscard]] size_t get_gpu_bytes() const override
+    {
+        return data_size * std::max<size_t>(buffer.size(), 1);
+    }
+
     [[nodiscard]] VkDescriptorBufferInfo* get_descriptor_buffer_info(uint32_t image_index);
 
   private:
+    void create_gpu_buffer(size_t image_index);
+    void destroy_gpu_buffer(size_t image_index);
+
     struct CameraData2
     {
         glm::mat4 world_projection = glm::mat4(1.0);
@@ -73,7 +96,14 @@ class ShaderBuffer : public AssetBase
     std::vector<VkDescriptorBufferInfo> descriptor_buffer_info;
     std::vector<VkBuffer>               buffer;
     std::vector<VkDeviceMemory>         buffer_memory;
-    std::vector<bool>                   dirty_buffers;
+
+    // Bytes modified since each image's buffer was last uploaded
+    struct DirtyRange
+    {
+        size_t begin = 0;
+        size_t end   = 0;
+    };
+    std::vector<DirtyRange> dirty_ranges;
 
     VkWriteDescriptorSet write_descriptor_set;
 };
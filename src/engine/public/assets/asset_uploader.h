@@ -0,0 +1,88 @@
+#pragma once
+
+#include <atomic>
+#include <deque>
+#include <mutex>
+#include <vector>
+#include <vk_mem_alloc.h>
+#include <vulkan/vulkan_core.h>
+
+class GfxContext;
+
+/**
+ * Batches the gpu uploads of the assets on the transfer queue.
+ * Data is copied to a staging buffer when the upload is requested. The copies requested between two flush() are submitted together,
+ * they complete once the fence of their batch is signaled : flush() only polls these fences, it never blocks.
+ * An upload is identified by the ticket of its batch, batches complete in order.
+ */
+class AssetUploader final
+{
+  public:
+    AssetUploader(GfxContext* in_gfx_context);
+    ~AssetUploader();
+
+    // Device local buffer, usable by the graphic queue once the uploads writing it completed
+    void create_buffer(VkDeviceSize size, VkBufferUsageFlags usage, VkBuffer& buffer, VmaAllocation& allocation) const;
+
+    // Copy data to a staging buffer and request its copy to destination. Returns the ticket of the upload. Thread safe.
+    uint64_t upload_buffer(VkBuffer destination, const void* data, VkDeviceSize size, VkDeviceSize destination_offset = 0);
+
+    // Release the completed batches and submit the requested copies
+    void flush();
+
+    // Submit the requested copies and block until the upload of this ticket completed
+    void wait(uint64_t ticket);
+
+    // Ticket 0 is always complete
+    [[nodiscard]] bool is_complete(uint64_t ticket) const
+    {
+        return ticket <= completed_ticket;
+    }
+
+    // Bytes copied to staging buffers that are not resident yet
+    [[nodiscard]] VkDeviceSize get_pending_bytes() const
+    {
+        return pending_bytes;
+    }
+
+  private:
+    struct StagingBuffer
+    {
+        VkBuffer      buffer     = VK_NULL_HANDLE;
+        VmaAllocation allocation = VK_NULL_HANDLE;
+        VkDeviceSize  size       = 0;
+    };
+
+    struct PendingCopy
+    {
+        StagingBuffer staging            = {};
+        VkBuffer      destination        = VK_NULL_HANDLE;
+        VkDeviceSize  destination_offset = 0;
+    };
+
+    struct Batch
+    {
+        uint64_t                   ticket          = 0;
+        VkCommandBuffer            command_buffer  = VK_NULL_HANDLE;
+        VkFence                    fence           = VK_NULL_HANDLE;
+        std::vector<StagingBuffer> staging_buffers = {};
+    };
+
+    // Both require the lock
+    void submit_pending();
+    void release_completed();
+
+    void release_batch(Batch& batch);
+
+    GfxContext*   gfx_context  = nullptr;
+    VkCommandPool command_pool = VK_NULL_HANDLE;
+
+    std::mutex                   upload_lock;
+    std::vector<PendingCopy>     pending_copies   = {};
+    std::deque<Batch>            in_flight        = {}; // Ordered by ticket
+    std::vector<VkCommandBuffer> free_commands    = {};
+    std::vector<VkFence>         free_fences      = {};
+    uint64_t                     pending_ticket   = 1; // Ticket of the copies requested since the last submission
+    std::atomic_uint64_t         completed_ticket = 0;
+    std::atomic_uint64_t         pending_bytes    = 0;
+};
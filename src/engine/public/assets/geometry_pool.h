@@ -0,0 +1,97 @@
+#pragma once
+
+#include "vertex_layout.h"
+
+#include <memory>
+#include <mutex>
+#include <vector>
+#include <vk_mem_alloc.h>
+#include <vulkan/vulkan_core.h>
+
+class AssetUploader;
+class GfxContext;
+class GeometryPool;
+class Window;
+
+// Device buffer shared by many meshes, sub-allocated in vertices or in indices
+struct GeometryBlock
+{
+    VkBuffer        buffer           = VK_NULL_HANDLE;
+    VmaAllocation   allocation       = VK_NULL_HANDLE;
+    VmaVirtualBlock virtual_block    = VK_NULL_HANDLE;
+    uint32_t        capacity         = 0; // In vertices or indices
+    uint32_t        element_size     = 0; // Bytes of a vertex (both streams) or of an index
+    VkDeviceSize    attribute_offset = 0; // Vertex blocks : the position stream of every vertex, then the attribute stream
+    VertexLayout    vertex_layout    = {};
+    VkIndexType     index_type       = VK_INDEX_TYPE_UINT32;
+
+    void bind_vertex_buffers(VkCommandBuffer command_buffer, bool b_position_only = false) const;
+    void bind_index_buffer(VkCommandBuffer command_buffer) const;
+};
+
+// Range of a mesh in the pool. Its indices are relative to first_vertex, which the draws pass as their vertex offset.
+struct GeometryAllocation
+{
+    GeometryPool*        pool              = nullptr; // Null until allocated and once freed
+    GeometryBlock*       vertex_block      = nullptr;
+    GeometryBlock*       index_block       = nullptr;
+    VmaVirtualAllocation vertex_allocation = VK_NULL_HANDLE;
+    VmaVirtualAllocation index_allocation  = VK_NULL_HANDLE;
+    uint32_t             first_vertex      = 0;
+    uint32_t             vertex_count      = 0;
+    uint32_t             first_index       = 0;
+    uint32_t             index_count       = 0;
+};
+
+struct GeometryPoolStats
+{
+    size_t block_count      = 0;
+    size_t allocation_count = 0;
+    size_t reserved_bytes   = 0; // Device memory of the blocks
+    size_t used_bytes       = 0; // Part of it allocated to meshes
+};
+
+/**
+ * Vertex and index arenas shared by the meshes : meshes drawn one after the other usually don't rebind any buffer.
+ * Vertex blocks hold the vertices of one VertexLayout, index blocks the indices of one index type. Blocks are sub-allocated with VMA virtual blocks
+ * and a new block is created when none of the existing ones has room left. A mesh larger than a block gets a block of its own.
+ * Freed ranges are reused by the next meshes. A block left empty is released once the frames in flight are complete, so evicting meshes returns
+ * device memory. Thread safe.
+ */
+class GeometryPool final
+{
+  public:
+    GeometryPool(GfxContext* in_gfx_context, AssetUploader* in_uploader, Window* in_window) : gfx_context(in_gfx_context), uploader(in_uploader), window(in_window)
+    {
+    }
+    ~GeometryPool();
+
+    GeometryAllocation allocate(const VertexLayout& vertex_layout, uint32_t vertex_count, VkIndexType index_type, uint32_t index_count);
+
+    // The range must not be used by the frames in flight anymore
+    void free(GeometryAllocation& allocation);
+
+    [[nodiscard]] GeometryPoolStats get_stats() const;
+
+    static constexpr uint32_t vertex_block_capacity = 1u << 20;
+    static constexpr uint32_t index_block_capacity  = 1u << 22;
+
+  private:
+    // Requires the lock. Returns the block of the range and writes its first element.
+    GeometryBlock* allocate_range(std::vector<std::unique_ptr<GeometryBlock>>& blocks, const VertexLayout* vertex_layout, VkIndexType index_type, uint32_t count, VmaVirtualAllocation& out_allocation,
+                                  uint32_t& out_first);
+    std::unique_ptr<GeometryBlock> create_block(const VertexLayout* vertex_layout, VkIndexType index_type, uint32_t capacity);
+
+    // Requires the lock. Remove the block from the pool if no range is allocated in it anymore and defer its destruction.
+    void release_if_empty(std::vector<std::unique_ptr<GeometryBlock>>& blocks, GeometryBlock* block);
+
+    GfxContext*    gfx_context = nullptr;
+    AssetUploader* uploader    = nullptr;
+    Window*        window      = nullptr;
+
+    mutable std::mutex                          pool_lock;
+    std::vector<std::unique_ptr<GeometryBlock>> vertex_blocks    = {}; // Every layout : there are only a few of them
+    std::vector<std::unique_ptr<GeometryBlock>> index_blocks     = {};
+    size_t                                      allocation_count = 0;
+    size_t                                      used_bytes       = 0;
+};
@@ -0,0 +1,56 @@
+#pragma once
+
+#include "scene/bvh.h"
+
+#include <cstdint>
+#include <glm/glm.hpp>
+#include <vector>
+#include <vulkan/vulkan_core.h>
+
+// Decoded vertex, as imported. Meshes are encoded with a VertexLayout before being uploaded.
+struct Vertex
+{
+    glm::vec3 pos    = glm::vec3();
+    glm::vec2 uv     = glm::vec2();
+    glm::vec4 col    = glm::vec4();
+    glm::vec3 norm   = glm::vec3();
+    glm::vec3 tang   = glm::vec3();
+    glm::vec3 bitang = glm::vec3();
+};
+
+enum class EVertexPositionFormat : uint8_t
+{
+    Float,   // R32G32B32_SFLOAT
+    Unorm16, // R16G16B16A16_UNORM, relative to the mesh bounds
+    Count
+};
+
+/**
+ * Formats of the vertex attributes in the gpu buffers, and the vertex input state reading them.
+ * Binding 0 holds the positions, binding 1 the other attributes : depth only passes only fetch the first stream.
+ * Locations are fixed : 0 position, 1 uv (half), 2 color (rgba8), 3 normal and 4 tangent (octahedral, 2 x snorm16).
+ * The sign of the bitangent is stored in the tangent, shaders rebuild it as cross(normal, tangent) * sign.
+ */
+struct VertexLayout
+{
+    EVertexPositionFormat position_format = EVertexPositionFormat::Unorm16;
+    bool                  b_uv            = true;
+    bool                  b_color         = false;
+    bool                  b_normal        = true;
+    bool                  b_tangent       = true;
+
+    bool operator==(const VertexLayout& other) const = default;
+
+    [[nodiscard]] uint32_t get_position_stride() const;
+    [[nodiscard]] uint32_t get_attribute_stride() const;
+
+    [[nodiscard]] std::vector<VkVertexInputBindingDescription>   get_binding_descriptions(bool b_position_only = false) const;
+    [[nodiscard]] std::vector<VkVertexInputAttributeDescription> get_attribute_descriptions(bool b_position_only = false) const;
+
+    // Shaders read position * scale + offset. Identity for float positions.
+    [[nodiscard]] glm::vec4 get_position_scale(const Aabb& bounds) const;
+    [[nodiscard]] glm::vec4 get_position_offset(const Aabb& bounds) const;
+
+    // Encode both streams. Quantized positions are relative to bounds.
+    void encode(const std::vector<Vertex>& vertices, const Aabb& bounds, std::vector<uint8_t>& out_positions, std::vector<uint8_t>& out_attributes) const;
+};
@@ -2,14 +2,22 @@
 #include "rendering/window.h"
 
 #include "assets/asset_base.h"
+#include "config.h"
 #include "ios/input_manager.h"
 #include "ui/window/window_base.h"
 
 #include <filesystem>
 #include <memory>
+#include <vector>
+
+namespace job_system
+{
+class IJobTask;
+}
 
 class InputManager;
 class PlayerController;
+class Scene;
 
 class IEngineInterface
 {
@@ -50,14 +58,41 @@ class IEngineInterface
         return delta_second;
     }
 
+    [[nodiscard]] static double get_fixed_delta_second()
+    {
+        return 1.0 / config::simulation_rate;
+    }
+
+    // Position of the rendered frame between the two last simulation steps, in [0, 1[
+    [[nodiscard]] double get_simulation_alpha() const
+    {
+        return simulation_alpha;
+    }
+
+    // Simulation steps executed for the rendered frame
+    [[nodiscard]] uint32_t get_simulation_steps() const
+    {
+        return simulation_steps;
+    }
+
     void close();
 
+    // Rendered scenes register themselves : the engine publishes them at each frame boundary, once the simulation is complete
+    void register_scene(Scene* scene);
+    void unregister_scene(Scene* scene);
+
   protected:
     virtual void load_resources()   = 0;
     virtual void pre_initialize()   = 0;
     virtual void pre_shutdown()     = 0;
     virtual void unload_resources() = 0;
 
+    // Fixed step simulation, executed on a worker while the main thread renders the previously published simulation state
+    virtual void simulation_tick(double fixed_delta_second)
+    {
+    }
+
+    // Called once the simulation of the previous frame is complete and before the next one starts. The registered scenes are published right after.
     virtual void pre_draw()                                 = 0;
     virtual void render_scene(RenderContext render_context) = 0;
     virtual void post_draw()                                = 0;
@@ -68,10 +103,20 @@ class IEngineInterface
 
   private:
     void                                  run_main_task(WindowParameters window_parameters);
+    void                                  start_simulation();
+    void                                  wait_simulation();
     double                                delta_second = 0.0;
     std::chrono::steady_clock::time_point last_delta_second_time;
     std::unique_ptr<AssetManager>         asset_manager  = nullptr;
     std::unique_ptr<Window>               game_window    = nullptr;
     std::unique_ptr<WindowManager>        window_manager = nullptr;
     std::unique_ptr<InputManager>         input_manager  = nullptr;
+    std::vector<Scene*>                   scenes         = {};
+
+    std::shared_ptr<job_system::IJobTask> simulation_job           = nullptr;
+    double                                simulation_accumulator   = 0.0;
+    double                                simulation_alpha         = 0.0;
+    double                                pending_simulation_alpha = 0.0;
+    uint32_t                              simulation_steps         = 0;
+    uint32_t                              pending_simulation_steps = 0;
 };
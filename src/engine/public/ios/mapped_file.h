@@ -0,0 +1,43 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <filesystem>
+
+/**
+ * Read only memory mapping of a whole file. The content stays mapped until the object is destroyed.
+ */
+class MappedFile final
+{
+  public:
+    MappedFile(const std::filesystem::path& file_path);
+    ~MappedFile();
+
+    MappedFile(const MappedFile&)            = delete;
+    MappedFile& operator=(const MappedFile&) = delete;
+
+    [[nodiscard]] bool is_valid() const
+    {
+        return data != nullptr;
+    }
+
+    [[nodiscard]] const uint8_t* get_data() const
+    {
+        return data;
+    }
+
+    [[nodiscard]] size_t get_size() const
+    {
+        return size;
+    }
+
+  private:
+    const uint8_t* data = nullptr;
+    size_t         size = 0;
+#if _WIN32
+    void* file_handle    = nullptr;
+    void* mapping_handle = nullptr;
+#else
+    int file_descriptor = -1;
+#endif
+};
@@ -6,9 +6,13 @@
 #include <assimp/Importer.hpp>
 #include <filesystem>
 #include <memory>
+#include <tuple>
+#include <vector>
 
 class AssetManager;
 class MeshData;
+struct Vertex;
+struct MeshLod;
 
 class MeshImporter
 {
@@ -24,7 +28,16 @@ class MeshImporter
 
     static TAssetPtr<MeshData> process_mesh(const AssetId& asset_id, AssetManager* asset_manager, aiMesh* mesh, size_t id);
 
+    // Decode and build the lods of the mesh on a worker. The importer owning the mesh is kept alive until it is decoded.
+    static TAssetPtr<MeshData> process_mesh_async(const AssetId& asset_id, AssetManager* asset_manager, const std::shared_ptr<Assimp::Importer>& owner, aiMesh* mesh);
+
+    // Lod 0 included
+    static constexpr size_t max_lod_count = 6;
+
   private:
+    // Vertices, indices (every lod) and lods : the MeshData constructor arguments
+    static std::tuple<std::vector<Vertex>, std::vector<uint32_t>, std::vector<MeshLod>> decode_mesh(const aiMesh* mesh);
+
     std::unique_ptr<Assimp::Importer> importer;
     AssetManager*                     asset_manager;
 };
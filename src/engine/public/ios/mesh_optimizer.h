@@ -0,0 +1,52 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+struct Vertex;
+struct MeshLod;
+
+namespace mesh_optimizer
+{
+// Post transform cache size the orders are optimized for, a common FIFO size
+constexpr uint32_t default_cache_size = 16;
+
+struct VertexCacheStats
+{
+    float acmr = 0.f; // Average cache miss ratio : vertices transformed per triangle. 0.5 at best, 3 at worst.
+    float atvr = 0.f; // Average transformed vertex ratio : vertices transformed per vertex referenced. 1 at best.
+};
+
+struct MeshOptimizationStats
+{
+    VertexCacheStats before = {};
+    VertexCacheStats after  = {};
+};
+
+// Simulate a FIFO post transform cache over the triangle list
+VertexCacheStats analyze_vertex_cache(const std::vector<uint32_t>& indices, size_t vertex_count, uint32_t cache_size = default_cache_size);
+
+/**
+ * Tipsify (Sander et al. 2007) : triangles are emitted as fans around a vertex, the next fan vertex being the one still in the cache that will stay
+ * there the longest. Linear time.
+ * out_clusters receives the first triangle of each run, the order restarts from a non cached vertex between runs.
+ */
+std::vector<uint32_t> optimize_vertex_cache(const std::vector<uint32_t>& indices, size_t vertex_count, std::vector<uint32_t>& out_clusters, uint32_t cache_size = default_cache_size);
+
+/**
+ * Reorder the clusters of optimize_vertex_cache so the ones facing outward from the mesh center are drawn first : they tend to occlude the others.
+ * Clusters are split further where it costs less than threshold times their ACMR, to give the sort more freedom.
+ */
+std::vector<uint32_t> optimize_overdraw(const std::vector<uint32_t>& indices, const std::vector<Vertex>& vertices, const std::vector<uint32_t>& clusters, float threshold = 1.05f,
+                                        uint32_t cache_size = default_cache_size);
+
+// Sort the vertices by first use in the index buffer and remap the indices. Unreferenced vertices are dropped.
+void optimize_vertex_fetch(std::vector<Vertex>& vertices, std::vector<uint32_t>& indices);
+
+/**
+ * Run the three passes on every lod of an imported mesh. The lods are index ranges of indices and keep their ranges.
+ * The stats are the ones of lod 0.
+ */
+MeshOptimizationStats optimize_mesh(std::vector<Vertex>& vertices, std::vector<uint32_t>& indices, const std::vector<MeshLod>& lods);
+} // namespace mesh_optimizer
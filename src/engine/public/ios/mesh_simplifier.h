@@ -0,0 +1,25 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+struct Vertex;
+struct MeshLod;
+
+namespace mesh_simplifier
+{
+/**
+ * Quadric error edge collapse simplification.
+ * Vertices sharing a position are collapsed together so attribute seams don't block the simplification, mesh borders are locked.
+ * Stops when target_index_count is reached or when the next collapse would move the surface further than target_error (object space).
+ * out_error receives the largest deviation introduced.
+ */
+std::vector<uint32_t> simplify(const std::vector<Vertex>& vertices, const std::vector<uint32_t>& indices, size_t target_index_count, float target_error, float& out_error);
+
+/**
+ * Append successive simplifications of the lod 0 indices to the index buffer.
+ * Each lod targets half the triangles of the previous one. The chain stops when the simplification no longer pays off.
+ */
+std::vector<MeshLod> build_lod_chain(const std::vector<Vertex>& vertices, std::vector<uint32_t>& indices, size_t max_lod_count);
+} // namespace mesh_simplifier
@@ -12,24 +12,31 @@ class MeshData;
 class Node;
 
 class Shader;
+class Material;
 
 class SceneImporter final
 {
   public:
     SceneImporter(AssetManager* in_asset_manager) : asset_manager(in_asset_manager)
     {
-        importer = std::make_unique<Assimp::Importer>();
     }
     ~SceneImporter() {}
 
-    std::shared_ptr<Node> import_file(const std::filesystem::path& source_file, const std::string& asset_name, Scene* context_scene);
+    /**
+     * The nodes are created immediately, the meshes are loaded asynchronously : mesh nodes are rendered once their mesh is resident.
+     * Every import reads the file with its own importer, released once the last mesh is decoded.
+     */
+    Node* import_file(const std::filesystem::path& source_file, const std::string& asset_name, Scene* context_scene);
 
   private:
     //TAssetPtr<Texture2d> process_texture(struct aiTexture* texture, size_t id);
     TAssetPtr<Shader>    process_material(struct aiMaterial* material, size_t id);
 
-    std::shared_ptr<Node> process_node(aiNode* ai_node, const std::shared_ptr<Node>& parent, Scene* context_scene);
-    std::shared_ptr<Node> create_node(aiNode* context, const std::shared_ptr<Node>& parent, Scene* context_scene);
+    // Create the nodes of the ai_node subtree and attach them to parent in a single batch
+    Node* process_node(aiNode* ai_node, Node* parent, Scene* context_scene);
+
+    // Append the node of context and its mesh nodes to the batch, parent is an index in nodes
+    void create_node(aiNode* context, uint32_t parent, std::vector<Node*>& nodes, std::vector<uint32_t>& parents, Scene* context_scene);
 
     AssetManager* asset_manager = nullptr;
 
@@ -37,6 +44,7 @@ class SceneImporter final
     //std::vector<TAssetPtr<Texture2d>> texture_refs;
     std::vector<TAssetPtr<Shader>>    material_refs;
     std::vector<TAssetPtr<MeshData>>  meshes_refs;
+    TAssetPtr<Material>               material;
 
-    std::unique_ptr<Assimp::Importer> importer;
+    std::shared_ptr<Assimp::Importer> importer;
 };
\ No newline at end of file
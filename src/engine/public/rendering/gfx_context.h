@@ -17,7 +17,14 @@ class GfxContext
 
     VmaAllocator vulkan_memory_allocator = VK_NULL_HANDLE;
 
+    // vkCmdDrawIndexedIndirectCount is available (Vulkan 1.2 drawIndirectCount feature)
+    bool b_supports_draw_indirect_count = false;
+
+    // Pipeline statistics queries can be active while secondary command buffers execute (pipelineStatisticsQuery and inheritedQueries features)
+    bool b_supports_pipeline_statistics = false;
+
     void     submit_graphic_queue(const VkSubmitInfo& submit_infos, VkFence submit_fence);
+    void     submit_transfert_queue(const VkSubmitInfo& submit_infos, VkFence submit_fence);
     VkResult submit_present_queue(const VkPresentInfoKHR& present_infos);
     void     wait_device();
 
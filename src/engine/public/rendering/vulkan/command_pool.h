@@ -1,6 +1,7 @@
 #pragma once
 
 #include <thread>
+#include <vector>
 
 
 #include "common.h"
@@ -42,4 +43,34 @@ namespace command_pool
 		const uint32_t context_queue;
 	};
 
+	/**
+	 * Secondary command buffers, allocated from one pool per thread (each worker plus the main thread) and per frame in flight.
+	 * The pools of a frame are reset together once the frame fence is signaled, the command buffers are then reused.
+	 */
+	class SecondaryContainer final {
+	public:
+		SecondaryContainer(VkDevice logical_device, uint32_t queue, size_t frame_count);
+		~SecondaryContainer();
+
+		// Reset every pool of this frame, must not be called while the frame is in use
+		void reset(size_t frame_id);
+
+		// Get an unused command buffer from the calling thread's pool
+		[[nodiscard]] VkCommandBuffer allocate(size_t frame_id);
+
+	private:
+		struct ThreadPool
+		{
+			VkCommandPool                pool            = VK_NULL_HANDLE;
+			std::vector<VkCommandBuffer> command_buffers = {};
+			size_t                       used_count      = 0;
+		};
+
+		// pools[frame_id * thread_count + thread_index]
+		std::vector<ThreadPool> pools;
+		size_t thread_count = 0;
+
+		const VkDevice context_logical_device;
+	};
+
 }
@@ -0,0 +1,66 @@
+#pragma once
+
+#include "rendering/vulkan/utils.h"
+
+#include <vector>
+
+class GfxContext;
+
+/**
+ * Depth array image with one layer per shadow cascade, and the depth only render pass writing one layer.
+ * Each pass leaves its layer in shader read layout : the whole array is sampled with depth comparison (sampler2DArrayShadow).
+ */
+class ShadowMap
+{
+  public:
+    ShadowMap(GfxContext* in_gfx_context, uint32_t in_resolution, uint32_t in_layer_count);
+    ~ShadowMap();
+
+    [[nodiscard]] VkRenderPass get_render_pass() const
+    {
+        return render_pass;
+    }
+
+    [[nodiscard]] VkFramebuffer get_framebuffer(uint32_t layer) const
+    {
+        return framebuffers[layer];
+    }
+
+    [[nodiscard]] uint32_t get_resolution() const
+    {
+        return resolution;
+    }
+
+    [[nodiscard]] uint32_t get_layer_count() const
+    {
+        return layer_count;
+    }
+
+    // Every layer, with the comparison sampler
+    [[nodiscard]] const VkDescriptorImageInfo& get_descriptor_image_info() const
+    {
+        return descriptor_image_info;
+    }
+
+  private:
+    void create_render_pass();
+    void create_image();
+    void create_framebuffers();
+    void create_sampler();
+
+    GfxContext* gfx_context = nullptr;
+    uint32_t    resolution  = 0;
+    uint32_t    layer_count = 0;
+    VkFormat    format      = VK_FORMAT_UNDEFINED;
+
+    VkRenderPass   render_pass  = VK_NULL_HANDLE;
+    VkImage        image        = VK_NULL_HANDLE;
+    VkDeviceMemory image_memory = VK_NULL_HANDLE;
+    VkImageView    array_view   = VK_NULL_HANDLE;
+    VkSampler      sampler      = VK_NULL_HANDLE;
+
+    std::vector<VkImageView>   layer_views  = {};
+    std::vector<VkFramebuffer> framebuffers = {};
+
+    VkDescriptorImageInfo descriptor_image_info = {};
+};
@@ -6,6 +6,7 @@
 #include "vulkan/command_pool.h"
 
 #include <functional>
+#include <mutex>
 
 class Node;
 class SceneNode;
@@ -14,6 +15,7 @@ class DescriptorPool;
 class ImGuiInstance;
 class Framebuffer;
 class Swapchain;
+class Window;
 
 struct WindowParameters
 {
@@ -25,12 +27,23 @@ struct WindowParameters
 
 struct RenderContext
 {
-    bool            is_valid       = false;
-    VkCommandBuffer command_buffer = VK_NULL_HANDLE;
-    VkFramebuffer   framebuffer    = VK_NULL_HANDLE;
-    uint32_t        image_index    = 0;
-    uint32_t        res_x          = 0;
-    uint32_t        res_y          = 0;
+    bool            is_valid               = false;
+    VkCommandBuffer command_buffer         = VK_NULL_HANDLE; // Main thread secondary command buffer, executed after the submitted ones
+    VkCommandBuffer primary_command_buffer = VK_NULL_HANDLE; // Recorded before the render pass begins (compute, transfers...)
+    VkFramebuffer   framebuffer            = VK_NULL_HANDLE;
+    uint32_t        image_index            = 0;
+    uint32_t        res_x                  = 0;
+    uint32_t        res_y                  = 0;
+    Window*         window                 = nullptr;
+};
+
+// Fragment shader invocations of the main render pass, read back once the frame is done (pipeline statistics queries)
+struct FragmentStats
+{
+    bool     b_available                 = false; // Unsupported by the device otherwise
+    uint64_t invocations                 = 0;     // Last frame read
+    uint64_t invocations_with_prepass    = 0;     // Last frame read with the depth pre-pass
+    uint64_t invocations_without_prepass = 0;     // Last frame read without the depth pre-pass
 };
 
 class Window
@@ -38,6 +51,10 @@ class Window
     friend WindowBase;
 
   public:
+    // Subpasses of the frame's render pass : opaque depth first (empty when no depth pre-pass is submitted), then color
+    static constexpr uint32_t depth_prepass_subpass = 0;
+    static constexpr uint32_t color_subpass         = 1;
+
     Window(WindowParameters window_parameters = WindowParameters{});
     virtual ~Window();
 
@@ -113,11 +130,35 @@ class Window
     void          prepare_ui(RenderContext& render_context);
     void          render_data(RenderContext& render_context);
 
+    // Begin a secondary command buffer inheriting a subpass of the frame's render pass, from the calling thread's pool. Thread safe.
+    [[nodiscard]] VkCommandBuffer begin_secondary_command_buffer(const RenderContext& render_context, uint32_t subpass = color_subpass) const;
+
+    // Same for an offscreen render pass (shadow maps...), whose viewport covers the whole framebuffer. Thread safe.
+    [[nodiscard]] VkCommandBuffer begin_secondary_command_buffer(VkRenderPass in_render_pass, VkFramebuffer framebuffer, VkExtent2D extent, uint32_t subpass = 0) const;
+
+    // Ended color subpass secondary command buffers are executed in submission order. Main thread only.
+    void submit_secondary_command_buffers(const std::vector<VkCommandBuffer>& in_command_buffers);
+
+    // Same for the depth pre-pass subpass
+    void submit_depth_prepass_command_buffers(const std::vector<VkCommandBuffer>& in_command_buffers);
+
+    [[nodiscard]] const FragmentStats& get_fragment_stats() const
+    {
+        return fragment_stats;
+    }
+
+    // Call destroy once the frames in flight are done with the resources it destroys : when the fence of the current frame is waited again. Thread safe.
+    void defer_destruction(std::function<void()> destroy);
+
+    // Call every deferred destruction now. The device must be idle.
+    void flush_deferred_destructions();
+
   private:
     std::unique_ptr<GfxContext> gfx_context;
 
     GLFWwindow*                           window_handle;
     command_pool::Container*              command_pool;
+    command_pool::SecondaryContainer*     secondary_command_pool = nullptr;
     vulkan_utils::SwapchainSupportDetails swapchain_support_details;
     VkSurfaceFormatKHR                    swapchain_surface_format;
     VkPresentModeKHR                      swapchain_present_mode;
@@ -141,6 +182,22 @@ class Window
     VkRenderPass                 render_pass = VK_NULL_HANDLE;
     Framebuffer*                 back_buffer;
     std::vector<VkCommandBuffer> command_buffers;
+    std::vector<VkCommandBuffer> submitted_secondary_command_buffers;
+    std::vector<VkCommandBuffer> submitted_depth_prepass_command_buffers;
+
+    // One query per frame in flight, read once its fence is signaled
+    struct StatisticsQuery
+    {
+        bool b_recorded      = false;
+        bool b_depth_prepass = false;
+    };
+    VkQueryPool                  statistics_query_pool = VK_NULL_HANDLE;
+    std::vector<StatisticsQuery> statistics_queries    = {};
+    FragmentStats                fragment_stats        = {};
+
+    // Indexed by frame in flight, filled while this frame is the current one
+    std::mutex                                      deferred_destruction_lock;
+    std::vector<std::vector<std::function<void()>>> deferred_destructions = {};
 
     friend void framebuffer_size_callback(GLFWwindow* handle, int res_x, int res_y);
     void        create_window_surface();
@@ -148,8 +205,12 @@ class Window
     void        create_or_recreate_render_pass();
     void        create_command_buffer();
     void        create_fences_and_semaphores();
+    void        create_statistics_queries();
+    void        read_statistics_query(size_t frame_id);
+    void        run_deferred_destructions(size_t frame_id);
 
     void destroy_fences_and_semaphores();
+    void destroy_statistics_queries();
     void destroy_command_buffer();
     void destroy_render_pass();
     void destroy_window_surface();
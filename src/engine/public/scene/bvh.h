@@ -0,0 +1,223 @@
+#pragma once
+
+#include <cfloat>
+#include <cstdint>
+#include <glm/glm.hpp>
+#include <vector>
+
+struct Aabb
+{
+    glm::vec3 min = glm::vec3(FLT_MAX);
+    glm::vec3 max = glm::vec3(-FLT_MAX);
+
+    [[nodiscard]] bool is_valid() const
+    {
+        return min.x <= max.x && min.y <= max.y && min.z <= max.z;
+    }
+
+    void grow(const glm::vec3& point)
+    {
+        min = glm::min(min, point);
+        max = glm::max(max, point);
+    }
+
+    void grow(const Aabb& other)
+    {
+        min = glm::min(min, other.min);
+        max = glm::max(max, other.max);
+    }
+
+    [[nodiscard]] glm::vec3 get_center() const
+    {
+        return (min + max) * 0.5f;
+    }
+
+    [[nodiscard]] float get_surface_area() const
+    {
+        if (!is_valid())
+            return 0.f;
+        const glm::vec3 extent = max - min;
+        return 2.f * (extent.x * extent.y + extent.y * extent.z + extent.z * extent.x);
+    }
+
+    [[nodiscard]] bool overlaps(const Aabb& other) const
+    {
+        return min.x <= other.max.x && max.x >= other.min.x && min.y <= other.max.y && max.y >= other.min.y && min.z <= other.max.z && max.z >= other.min.z;
+    }
+
+    // Box containing the 8 transformed corners
+    [[nodiscard]] Aabb transformed(const glm::mat4& transform) const;
+};
+
+struct Ray
+{
+    glm::vec3 origin       = glm::vec3(0);
+    glm::vec3 direction    = glm::vec3(1, 0, 0);
+    float     max_distance = FLT_MAX; // In direction length units
+};
+
+/**
+ * Bounding volume hierarchy over a set of boxes, built with a binned surface area heuristic.
+ * Primitives only exist as indices into the bounds given to build() : the caller tests them from the traversal callbacks.
+ * refit() updates the node bounds of moved primitives without changing the tree, get_cost() tells when a rebuild pays off again.
+ */
+class Bvh
+{
+  public:
+    void build(const std::vector<Aabb>& primitive_bounds);
+
+    // Bounds must be given in the same order as in build()
+    void refit(const std::vector<Aabb>& primitive_bounds);
+
+    // Expected traversal cost relative to the root : compare with the cost right after build() to detect degraded refits
+    [[nodiscard]] float get_cost() const;
+
+    [[nodiscard]] bool is_empty() const
+    {
+        return nodes.empty();
+    }
+
+    [[nodiscard]] size_t get_memory_bytes() const
+    {
+        return nodes.size() * sizeof(BvhNode) + primitives.size() * sizeof(uint32_t);
+    }
+
+    [[nodiscard]] Aabb get_bounds() const
+    {
+        return nodes.empty() ? Aabb{} : nodes[0].bounds;
+    }
+
+    // Entry distance of the ray in the box, FLT_MAX if it misses or enters after max_distance
+    [[nodiscard]] static float intersect(const Aabb& box, const glm::vec3& origin, const glm::vec3& inverse_direction, float max_distance);
+
+    // Call visit(primitive, max_distance) for the primitives whose bounds the ray crosses, nearest nodes first. visit() may shorten max_distance.
+    template <typename Visit_T> void traverse(const Ray& ray, Visit_T&& visit) const
+    {
+        if (nodes.empty())
+            return;
+
+        const glm::vec3 inverse_direction = 1.f / ray.direction;
+        float           max_distance      = ray.max_distance;
+        if (intersect(nodes[0].bounds, ray.origin, inverse_direction, max_distance) == FLT_MAX)
+            return;
+
+        uint32_t stack[max_depth];
+        uint32_t stack_size = 0;
+        stack[stack_size++] = 0;
+        while (stack_size > 0)
+        {
+            const BvhNode& node = nodes[stack[--stack_size]];
+            if (node.count > 0)
+            {
+                for (uint32_t i = node.first; i < node.first + node.count; ++i)
+                    visit(primitives[i], max_distance);
+                continue;
+            }
+
+            const float left_distance  = intersect(nodes[node.first].bounds, ray.origin, inverse_direction, max_distance);
+            const float right_distance = intersect(nodes[node.first + 1].bounds, ray.origin, inverse_direction, max_distance);
+
+            // Push the farthest child first so the nearest one is visited first and shortens max_distance
+            if (left_distance <= right_distance)
+            {
+                if (right_distance != FLT_MAX)
+                    stack[stack_size++] = node.first + 1;
+                if (left_distance != FLT_MAX)
+                    stack[stack_size++] = node.first;
+            }
+            else
+            {
+                if (left_distance != FLT_MAX)
+                    stack[stack_size++] = node.first;
+                stack[stack_size++] = node.first + 1;
+            }
+        }
+    }
+
+    // Call visit(primitive) for the primitives whose bounds overlap the box
+    template <typename Visit_T> void traverse(const Aabb& box, Visit_T&& visit) const
+    {
+        if (nodes.empty() || !nodes[0].bounds.overlaps(box))
+            return;
+
+        uint32_t stack[max_depth];
+        uint32_t stack_size = 0;
+        stack[stack_size++] = 0;
+        while (stack_size > 0)
+        {
+            const BvhNode& node = nodes[stack[--stack_size]];
+            if (node.count > 0)
+            {
+                for (uint32_t i = node.first; i < node.first + node.count; ++i)
+                    visit(primitives[i]);
+                continue;
+            }
+            for (uint32_t child = node.first; child < node.first + 2; ++child)
+                if (nodes[child].bounds.overlaps(box))
+                    stack[stack_size++] = child;
+        }
+    }
+
+  private:
+    // Below max_sah_depth nodes are split at the median, which bounds the depth to max_sah_depth + log2(primitive count)
+    static constexpr uint32_t max_sah_depth  = 64;
+    static constexpr uint32_t max_depth      = 128;
+    static constexpr uint32_t max_leaf_size  = 4;
+    static constexpr uint32_t bin_count      = 12;
+    static constexpr float    traversal_cost = 1.f; // Relative to one primitive test
+
+    // Leaves hold count primitives from first, inner nodes have count = 0 and their two children at first and first + 1
+    struct BvhNode
+    {
+        Aabb     bounds = {};
+        uint32_t first  = 0;
+        uint32_t count  = 0;
+    };
+
+    std::vector<BvhNode>  nodes      = {};
+    std::vector<uint32_t> primitives = {};
+};
+
+/**
+ * Triangle bvh of a mesh, in mesh local space (bottom level of the scene spatial index).
+ */
+class MeshBvh
+{
+  public:
+    // Three indices into positions per triangle
+    void build(std::vector<glm::vec3> in_positions, std::vector<uint32_t> in_indices);
+
+    // Nearest triangle hit before distance (in ray direction length units), distance is shortened on hit
+    bool raycast(const Ray& ray, float& distance, uint32_t& out_triangle, glm::vec3& out_normal) const;
+
+    // True if the bounds of a triangle overlap the box
+    [[nodiscard]] bool overlaps(const Aabb& box) const;
+
+    [[nodiscard]] Aabb get_bounds() const
+    {
+        return bvh.get_bounds();
+    }
+
+    [[nodiscard]] uint32_t get_triangle_count() const
+    {
+        return static_cast<uint32_t>(indices.size() / 3);
+    }
+
+    [[nodiscard]] bool is_empty() const
+    {
+        return bvh.is_empty();
+    }
+
+    [[nodiscard]] size_t get_memory_bytes() const
+    {
+        return positions.size() * sizeof(glm::vec3) + indices.size() * sizeof(uint32_t) + bvh.get_memory_bytes();
+    }
+
+  private:
+    [[nodiscard]] Aabb get_triangle_bounds(uint32_t triangle) const;
+
+    // Indexed : a vertex shared by several triangles is stored once, triangle bounds are computed when tested
+    std::vector<glm::vec3> positions = {};
+    std::vector<uint32_t>  indices   = {};
+    Bvh                    bvh       = {};
+};
@@ -3,10 +3,13 @@
 #include <vector>
 #include <vulkan/vulkan_core.h>
 
+#include "assets/asset_id.h"
 #include "glm/glm.hpp"
 #include "glm/gtc/quaternion.hpp"
+#include "scene/node_pool.h"
 
 #include <memory>
+#include <type_traits>
 
 namespace glm
 {
@@ -15,6 +18,16 @@ typedef glm::vec<3, double, highp> dvec3;
 
 class Scene;
 
+// Nodes are ticked phase after phase : a phase is complete before the next one starts
+enum class ETickPhase
+{
+    PrePhysics,
+    Physics,
+    PostPhysics,
+    PreRender,
+    Count
+};
+
 class Node
 {
     friend class Scene;
@@ -30,6 +43,19 @@ class Node
         return render_scene;
     }
 
+    // Stays valid after the node is removed, Scene::find_node() then returns null
+    [[nodiscard]] const NodeHandle& get_handle() const
+    {
+        return handle;
+    }
+
+    // Hide in a child class to tick its nodes in another phase
+    static constexpr ETickPhase tick_phase = ETickPhase::PrePhysics;
+
+    /**
+     * Only node classes overriding tick() are registered for ticking, other nodes cost nothing.
+     * Nodes of the same class are ticked in parallel, after their ancestors of the same class : tick() must only modify the node and its children.
+     */
     virtual void tick(const double delta_second)
     {
     }
@@ -103,16 +129,50 @@ class Node
         recompute_transform();
     }
 
-    virtual void attach_to(const std::shared_ptr<Node>& new_parent_node, bool b_keep_world_transform = false);
+    // Set the three components with a single transform update
+    void set_relative_transform(const glm::dvec3& in_position, const glm::dquat& in_rotation, const glm::dvec3& in_scale)
+    {
+        rel_position = in_position;
+        rel_rotation = in_rotation;
+        rel_scale    = in_scale;
+        recompute_transform();
+    }
+
+    [[nodiscard]] Node* get_parent() const
+    {
+        return parent;
+    }
+
+    // Number of ancestors
+    [[nodiscard]] uint32_t get_depth() const
+    {
+        return depth;
+    }
+
+    // Assets this node references, saved in scene snapshots and given back to the node type factory on load
+    virtual void get_snapshot_assets(std::vector<AssetId>& out_assets) const
+    {
+    }
+
+    virtual void attach_to(Node* new_parent_node, bool b_keep_world_transform = false);
     virtual void detach(bool b_keep_world_transform);
 
   protected:
+    // Called after the world transform of this node changed
+    virtual void on_transform_changed()
+    {
+    }
+
   private:
     [[nodiscard]] bool ensure_node_can_be_attached(const Node* in_node) const;
     [[nodiscard]] bool is_node_in_hierarchy(const Node* in_node) const;
 
+    // Update the world transform of this node and of its children, iteratively
     void recompute_transform();
 
+    // Update the world transform and the depth of this node only, its parent must be up to date
+    void update_world_transform();
+
     void initialize_internal(Scene* in_scene, Node* in_parent);
 
     glm::dvec3         rel_position    = glm::dvec3(0.0);
@@ -126,7 +186,17 @@ class Node
 
     Node*              parent          = nullptr;
     std::vector<Node*> children        = {};
+    uint32_t           depth           = 0;
+
+    // Set by Scene::add_node(). Indices in the scene's node and tick lists, used for O(1) removal.
+    NodeHandle handle              = {};
+    uint32_t   scene_node_index    = UINT32_MAX;
+    uint32_t   rendered_node_index = UINT32_MAX;
+    uint32_t   tick_index          = UINT32_MAX;
 
     // Initialized in Scene constructor
     Scene* render_scene;
-};
\ No newline at end of file
+};
+
+// True if Node_T (or one of its parents) overrides Node::tick()
+template <typename Node_T> inline constexpr bool has_tick_v = !std::is_same_v<decltype(&Node_T::tick), void (Node::*)(double)>;
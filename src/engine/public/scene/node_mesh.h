@@ -12,7 +12,9 @@ class MeshNode : public PrimitiveNode
     {
     }
 
-    void render(RenderContext render_context) override;
+    bool get_render_record(RenderRecord& record) const override;
+    EAssetResolution resolve_assets() override;
+    void get_snapshot_assets(std::vector<AssetId>& out_assets) const override;
 
   private:
     TAssetPtr<MeshData> mesh;
@@ -0,0 +1,114 @@
+#pragma once
+
+#include <cstdint>
+#include <memory>
+#include <vector>
+
+class Node;
+
+// Generational reference to a pooled node : resolving it once the node was destroyed returns null
+struct NodeHandle
+{
+    uint32_t pool_id    = UINT32_MAX;
+    uint32_t slot       = 0;
+    uint32_t generation = 0;
+
+    [[nodiscard]] bool is_valid() const
+    {
+        return pool_id != UINT32_MAX;
+    }
+
+    bool operator==(const NodeHandle& other) const = default;
+};
+
+class NodePoolBase
+{
+  public:
+    virtual ~NodePoolBase() = default;
+
+    // Null if the slot is free or has been reused since
+    [[nodiscard]] virtual Node* get(uint32_t slot, uint32_t generation) const = 0;
+
+    // Call the node destructor and make the slot available
+    virtual void release(uint32_t slot) = 0;
+
+  protected:
+    [[nodiscard]] static uint32_t make_pool_id();
+};
+
+/**
+ * Contiguous storage for every node of a given class.
+ * Nodes are allocated in fixed size chunks so their address never changes (node hierarchies store raw pointers).
+ */
+template <typename Node_T> class TNodePool final : public NodePoolBase
+{
+  public:
+    // One id per node class, shared by every scene
+    [[nodiscard]] static uint32_t get_pool_id()
+    {
+        static const uint32_t pool_id = make_pool_id();
+        return pool_id;
+    }
+
+    ~TNodePool() override
+    {
+        for (uint32_t slot = 0; slot < alive.size(); ++slot)
+            if (alive[slot])
+                get_storage(slot)->~Node_T();
+    }
+
+    // Return uninitialized storage for a new node. The caller constructs the node in place.
+    [[nodiscard]] Node_T* allocate(uint32_t& out_slot, uint32_t& out_generation)
+    {
+        if (free_slots.empty())
+        {
+            const auto first_slot = static_cast<uint32_t>(alive.size());
+            chunks.emplace_back(std::make_unique<Chunk>());
+            alive.resize(alive.size() + chunk_size, false);
+            generations.resize(generations.size() + chunk_size, 0);
+            for (uint32_t i = chunk_size; i > 0; --i)
+                free_slots.emplace_back(first_slot + i - 1);
+        }
+
+        out_slot = free_slots.back();
+        free_slots.pop_back();
+        alive[out_slot] = true;
+        out_generation  = generations[out_slot];
+        return get_storage(out_slot);
+    }
+
+    [[nodiscard]] Node* get(uint32_t slot, uint32_t generation) const override
+    {
+        if (slot >= alive.size() || !alive[slot] || generations[slot] != generation)
+            return nullptr;
+        return get_storage(slot);
+    }
+
+    void release(uint32_t slot) override
+    {
+        if (slot >= alive.size() || !alive[slot])
+            return;
+        get_storage(slot)->~Node_T();
+        alive[slot] = false;
+        ++generations[slot];
+        free_slots.emplace_back(slot);
+    }
+
+  private:
+    static constexpr uint32_t chunk_size = 64;
+
+    struct Chunk
+    {
+        alignas(Node_T) uint8_t storage[sizeof(Node_T) * chunk_size];
+    };
+
+    [[nodiscard]] Node_T* get_storage(uint32_t slot) const
+    {
+        return reinterpret_cast<Node_T*>(chunks[slot / chunk_size]->storage) + slot % chunk_size;
+    }
+
+    std::vector<std::unique_ptr<Chunk>> chunks      = {};
+    std::vector<bool>                   alive       = {};
+    std::vector<uint32_t>               generations = {};
+    std::vector<uint32_t>               free_slots  = {};
+};
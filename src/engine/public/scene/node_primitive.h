@@ -4,17 +4,51 @@
 #include "rendering/window.h"
 
 class Scene;
+struct RenderRecord;
+
+enum class EAssetResolution
+{
+    Loading,  // One of the assets is not resident yet : resolved again at the next frames
+    Resolved,
+    Failed    // The assets can never be rendered together : the primitive is not registered
+};
 
 class PrimitiveNode : public Node
 {
+    friend class Scene;
+
   public:
     PrimitiveNode() = default;
     virtual ~PrimitiveNode() = default;
 
     void set_visible(bool b_visible);
 
-    virtual void render(RenderContext render_context) = 0;
-    
+    // Fill the record published to the render proxy : the renderer only reads published records, never the nodes. Return false if there is nothing to draw.
+    virtual bool get_render_record(RenderRecord& record) const
+    {
+        return false;
+    }
+
+    // Resolve the assets of the render record before it is registered
+    virtual EAssetResolution resolve_assets()
+    {
+        return EAssetResolution::Resolved;
+    }
+
+  protected:
+    // The render record will be published again at the end of the scene tick
+    void mark_render_record_dirty()
+    {
+        b_render_record_dirty = true;
+    }
+
+    void on_transform_changed() override
+    {
+        mark_render_record_dirty();
+    }
+
   private:
-    bool         is_visible    = false;
+    bool     is_visible            = false;
+    bool     b_render_record_dirty = false;
+    uint32_t proxy_id              = UINT32_MAX;
 };
\ No newline at end of file
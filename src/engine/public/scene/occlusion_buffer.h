@@ -0,0 +1,76 @@
+#pragma once
+
+#include "scene/bvh.h"
+
+#include <cstdint>
+#include <glm/glm.hpp>
+#include <vector>
+
+struct OcclusionStats
+{
+    size_t occluders          = 0;
+    size_t occluder_triangles = 0;
+    size_t occluded           = 0;
+};
+
+/**
+ * Low resolution depth buffer rasterized on the cpu from a few large occluders, used to skip the objects they hide before drawing them.
+ * Stores 1 / w per pixel (0 = nothing) : it is linear in screen space and the nearest occluder keeps the largest value.
+ * Rasterization is split in horizontal tiles executed on the job system, 4 pixels at a time with SSE2 when available.
+ * Occluders are sampled at pixel centers : an object visible through a gap thinner than a pixel can be culled.
+ */
+class OcclusionBuffer
+{
+  public:
+    // Width is rounded up to a multiple of 4
+    OcclusionBuffer(uint32_t in_width, uint32_t in_height);
+
+    // Clear the buffer and the occluders
+    void begin(const glm::mat4& in_view_projection);
+
+    // Queue the triangles (3 local space positions each) of an occluder. Not thread safe.
+    void add_occluder(const glm::mat4& transform, const std::vector<glm::vec3>& triangle_positions);
+
+    // Rasterize the queued occluders
+    void rasterize();
+
+    // True if the local space box is entirely behind the rasterized occluders. Can be called concurrently.
+    [[nodiscard]] bool is_occluded(const Aabb& bounds, const glm::mat4& transform) const;
+
+    [[nodiscard]] uint32_t get_width() const
+    {
+        return width;
+    }
+
+    [[nodiscard]] uint32_t get_height() const
+    {
+        return height;
+    }
+
+    [[nodiscard]] const float* get_depth() const
+    {
+        return depth.data();
+    }
+
+  private:
+    static constexpr uint32_t tile_height = 8;
+
+    // Pixel space vertices, counter clockwise
+    struct ScreenTriangle
+    {
+        glm::vec2 positions[3] = {};
+        float     inv_w[3]     = {};
+        int32_t   min_x        = 0;
+        int32_t   max_x        = 0;
+        int32_t   min_y        = 0;
+        int32_t   max_y        = 0;
+    };
+
+    void rasterize_tile(int32_t tile_min_y, int32_t tile_max_y);
+
+    uint32_t                    width           = 0;
+    uint32_t                    height          = 0;
+    glm::mat4                   view_projection = glm::mat4(1.0);
+    std::vector<float>          depth           = {};
+    std::vector<ScreenTriangle> triangles       = {};
+};
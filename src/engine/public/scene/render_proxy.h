@@ -0,0 +1,141 @@
+#pragma once
+
+#include <bit>
+#include <cstdint>
+#include <glm/glm.hpp>
+#include <vector>
+
+class Material;
+class MeshData;
+
+// Plain copy of what the renderer needs to draw a primitive : the render side never reads nodes
+struct RenderRecord
+{
+    Material* material  = nullptr;
+    MeshData* mesh      = nullptr;
+    glm::mat4 transform = glm::mat4(1.0);
+
+    // Transform at the start of the last simulation step, used to interpolate between steps
+    glm::mat4 previous_transform = glm::mat4(1.0);
+};
+
+// Plain copy of the camera the scene is rendered from
+struct RenderView
+{
+    glm::dvec3 location        = glm::dvec3(0.0);
+    glm::dvec3 forward         = glm::dvec3(1, 0, 0);
+    glm::dvec3 up              = glm::dvec3(0, 0, -1);
+    float      field_of_view   = 45.f;
+    float      near_clip_plane = 0.1f;
+    float      far_clip_plane  = 1000000.f;
+};
+
+/**
+ * Densely packed render records, double buffered between the game side and the render side.
+ * The game side adds, updates and removes records through stable proxy ids, then publish() copies the changed records to the render side.
+ * publish() is the only synchronization point : simulation and rendering can run on different threads as long as it is not concurrent with either.
+ * Change bits track the dense records modified since the render side last consumed them, so only those need to be uploaded.
+ */
+class RenderProxy
+{
+  public:
+    // Game side : return a stable proxy id. The previous transform of a new record is its transform.
+    [[nodiscard]] uint32_t add_record(const RenderRecord& record);
+
+    // Keep the previous transform of the record, it is only advanced by begin_step()
+    void update_record(uint32_t proxy_id, const RenderRecord& record);
+
+    // Simulation step boundary : records moved during the last step start the new one from their current transform
+    void begin_step();
+
+    // The last record is moved into the hole to keep the records packed
+    void remove_record(uint32_t proxy_id);
+
+    // Game side : the view at the end of the last simulation step. The first view after reset_view() is not interpolated from the previous one.
+    void set_view(const RenderView& view);
+    void reset_view();
+
+    // Frame boundary : copy the changed records and the view to the render side
+    void publish();
+
+    // Render side : false until a view was published
+    [[nodiscard]] bool has_view() const
+    {
+        return b_render_has_view;
+    }
+
+    // Render side : the view between the start and the end of the last simulation step
+    [[nodiscard]] RenderView get_view(float alpha) const;
+
+    // Render side
+    [[nodiscard]] size_t get_record_count() const
+    {
+        return render_records.size();
+    }
+
+    [[nodiscard]] const RenderRecord& get_record(size_t index) const
+    {
+        return render_records[index];
+    }
+
+    [[nodiscard]] uint32_t get_proxy_id(size_t index) const
+    {
+        return render_proxy_ids[index];
+    }
+
+    // Proxy ids are lower than this value
+    [[nodiscard]] size_t get_proxy_id_capacity() const
+    {
+        return render_proxy_id_capacity;
+    }
+
+    // Call callback(first, count) for each run of records changed since the last call, then clear the change bits
+    template <typename Callback_T> void consume_changes(Callback_T&& callback)
+    {
+        size_t run_begin = 0;
+        size_t run_end   = 0;
+        for (size_t word = 0; word < render_changes.size(); ++word)
+        {
+            for (uint64_t bits = render_changes[word]; bits != 0; bits &= bits - 1)
+            {
+                const size_t index = word * 64 + std::countr_zero(bits);
+                if (index >= render_records.size())
+                    break;
+                if (index != run_end)
+                {
+                    if (run_end > run_begin)
+                        callback(run_begin, run_end - run_begin);
+                    run_begin = index;
+                }
+                run_end = index + 1;
+            }
+            render_changes[word] = 0;
+        }
+        if (run_end > run_begin)
+            callback(run_begin, run_end - run_begin);
+    }
+
+  private:
+    void mark_changed(uint32_t dense_index);
+    void mark_step_changed(uint32_t dense_index, bool b_changed);
+
+    // Game side
+    std::vector<RenderRecord> game_records   = {};
+    std::vector<uint32_t>     dense_to_proxy = {};
+    std::vector<uint32_t>     proxy_to_dense = {};
+    std::vector<uint32_t>     free_proxy_ids = {};
+    std::vector<uint64_t>     game_changes   = {};
+    std::vector<uint64_t>     step_changes   = {};
+    RenderView                game_view          = {};
+    RenderView                game_previous_view = {};
+    bool                      b_game_has_view    = false;
+
+    // Render side
+    std::vector<RenderRecord> render_records           = {};
+    std::vector<uint32_t>     render_proxy_ids         = {};
+    std::vector<uint64_t>     render_changes           = {};
+    size_t                    render_proxy_id_capacity = 0;
+    RenderView                render_view              = {};
+    RenderView                render_previous_view     = {};
+    bool                      b_render_has_view        = false;
+};
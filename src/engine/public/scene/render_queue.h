@@ -0,0 +1,150 @@
+#pragma once
+
+#include <glm/glm.hpp>
+#include <vector>
+#include <vulkan/vulkan_core.h>
+
+class Material;
+class MeshData;
+struct RenderContext;
+enum class EMaterialPass;
+
+/**
+ * A single draw submitted to the render queue.
+ * Invalid items (no material or no mesh) are sorted at the end of the queue and never recorded.
+ */
+struct DrawItem
+{
+    Material* material     = nullptr;
+    MeshData* mesh         = nullptr;
+    glm::mat4 transform    = glm::mat4(1.0);
+    float     depth        = 0.f; // Squared distance to the camera
+    uint32_t  lod          = 0; // Level of detail of the mesh to draw
+    uint32_t  object_index = 0; // Index of the transform in the object buffer
+};
+
+// View parameters used to select the level of detail of each drawn mesh
+struct LodContext
+{
+    glm::vec3 camera_location = glm::vec3(0);
+    float     pixels_per_unit = 0.f;   // Projected size in pixels of a unit length at a distance of 1
+    float     max_pixel_error = 1.f;   // Largest acceptable projected simplification error
+    float     hysteresis      = 0.25f; // Margin required to switch to a coarser lod
+    float     min_distance    = 0.01f; // Clamp the distance of primitives containing the camera
+};
+
+struct RenderQueueStats
+{
+    size_t items           = 0;
+    size_t draws           = 0;
+    size_t draws_saved     = 0;
+    size_t binds           = 0;
+    size_t binds_saved     = 0;
+    size_t command_buffers = 0;
+    size_t triangles       = 0; // Upper bound when instances are culled on the gpu
+    size_t prepass_draws   = 0; // Depth pre-pass draws, not counted in draws
+};
+
+// Consecutive sorted items sharing material, mesh and lod, drawn with a single instanced draw
+struct DrawBatch
+{
+    uint32_t first_instance = 0;
+    uint32_t instance_count = 0;
+};
+
+// When set, batch i is drawn from the i-th VkDrawIndexedIndirectCommand / draw count (written by the gpu culling pass)
+struct IndirectDrawBuffers
+{
+    VkBuffer draw_commands = VK_NULL_HANDLE;
+    VkBuffer draw_counts   = VK_NULL_HANDLE;
+};
+
+/**
+ * Collect draw items, sort them by state (pipeline, descriptor set, mesh, depth) and record them while skipping redundant binds.
+ * Consecutive items sharing material, mesh and lod are drawn as a single instanced draw.
+ * Sorted item i is drawn as instance i : the instance buffer maps it to its object_index in the object buffer.
+ * Large queues are split in contiguous ranges of batches recorded by workers into secondary command buffers.
+ * With the depth pre-pass, batches are first drawn to depth only and front to back, then shaded with an equal depth test.
+ */
+class RenderQueue
+{
+  public:
+    /**
+     * Sort key layout (most significant first) :
+     * [63..52] material (pipeline and descriptor sets) | [51..27] mesh | [26..24] lod | [23..0] depth
+     * Ids are truncated : a collision only costs an extra bind, record() always compares the real handles.
+     * Mesh render ids are recycled so they fit : items of a mesh stay contiguous, which instanced batching relies on.
+     */
+    [[nodiscard]] static uint64_t make_sort_key(const DrawItem& item);
+
+    // Clear the queue and resize it to item_count invalid items.
+    void reset(size_t item_count);
+
+    // Can be called concurrently as long as each thread writes a different index.
+    void set_item(size_t index, const DrawItem& item);
+
+    // Sort the items and build the draw batches
+    void sort();
+
+    // Update the descriptor sets of every material used this frame (once per material)
+    void prepare(uint32_t image_index) const;
+
+    void record(const RenderContext& render_context, const IndirectDrawBuffers& indirect_buffers = {}, bool b_depth_prepass = false);
+
+    [[nodiscard]] size_t get_item_count() const
+    {
+        return items.size();
+    }
+
+    [[nodiscard]] const DrawItem& get_item(size_t index) const
+    {
+        return items[index];
+    }
+
+    // Number of valid items, only meaningful after sort()
+    [[nodiscard]] size_t get_sorted_count() const
+    {
+        return sorted_count;
+    }
+
+    [[nodiscard]] const DrawItem& get_sorted_item(size_t sorted_index) const
+    {
+        return items[sorted_indices[sorted_index]];
+    }
+
+    [[nodiscard]] size_t get_batch_count() const
+    {
+        return batches.size();
+    }
+
+    [[nodiscard]] const DrawBatch& get_batch(size_t batch_index) const
+    {
+        return batches[batch_index];
+    }
+
+    [[nodiscard]] const RenderQueueStats& get_stats() const
+    {
+        return stats;
+    }
+
+    // Below this amount of batches, a worker is not worth a secondary command buffer
+    static constexpr size_t min_batches_per_command_buffer = 64;
+
+  private:
+    // Record every batch in the subpass of the pass, split across workers. Batches are recorded in batch_order when set.
+    void record_pass(const RenderContext& render_context, const IndirectDrawBuffers& indirect_buffers, EMaterialPass pass, const uint32_t* batch_order, RenderQueueStats& out_stats);
+
+    // Record batches [first_batch, last_batch[ of the order, bind states are tracked per command buffer
+    void record_batches(VkCommandBuffer command_buffer, uint32_t image_index, size_t first_batch, size_t last_batch, const IndirectDrawBuffers& indirect_buffers, EMaterialPass pass, const uint32_t* batch_order,
+                        RenderQueueStats& out_stats) const;
+
+    std::vector<DrawItem>  items          = {};
+    std::vector<uint64_t>  keys           = {};
+    std::vector<uint32_t>  sorted_indices = {};
+    std::vector<uint64_t>  key_scratch    = {};
+    std::vector<uint32_t>  index_scratch  = {};
+    std::vector<DrawBatch> batches        = {};
+    std::vector<uint32_t>  prepass_order  = {}; // Batch indices, nearest first
+    size_t                 sorted_count   = 0;
+    RenderQueueStats       stats          = {};
+};
@@ -2,92 +2,129 @@
 
 #include "assets/asset_ptr.h"
 #include "rendering/window.h"
+#include "scene/node_pool.h"
+#include "scene/occlusion_buffer.h"
+#include "scene/render_proxy.h"
+#include "scene/render_queue.h"
+#include "scene/scene_snapshot.h"
+#include "scene/shadow_renderer.h"
+#include "scene/spatial_index.h"
 
 #include "assets/asset_uniform_buffer.h"
 #include <cpputils/logger.hpp>
 
+#include <filesystem>
 #include <glm/glm.hpp>
 #include <memory>
+#include <string_view>
+#include <type_traits>
+#include <unordered_map>
 #include <vector>
 
 class AssetManager;
 class Camera;
+class ComputeMaterial;
+class Shader;
 class ShaderBuffer;
 class Node;
 class PrimitiveNode;
 
 struct CameraData
 {
-    glm::mat4 world_projection = glm::mat4(1.0);
-    glm::mat4 view_matrix      = glm::mat4(1.0);
-    glm::vec3 camera_location  = glm::vec3(0, 0, 0);
+    glm::mat4 world_projection    = glm::mat4(1.0);
+    glm::mat4 view_matrix         = glm::mat4(1.0);
+    glm::vec3 camera_location     = glm::vec3(0, 0, 0);
+    float     interpolation_alpha = 1.f;
 };
 
-#define ENTITY_SIZE 256
-
-template <const size_t type_size> using Entity = uint8_t[type_size];
-
-class RenderProxy
-{
-    int add_entity()
-    {
-        return 0; // entity_handle 
-    }
-
-    void remove_entity(int entity_handle)
-    {
-        
-    }
-
-    Entity<256> entity_data[64];
-    bool        data_update_status[64];
-    size_t      entity_count = 64;
-    std::unordered_map<int, int> index_map;
-};
-
-class RenderProxyECS
-{
-  public:
-  private:
-    RenderProxy entities    = {};
-    VkBuffer    ssbo_handle = VK_NULL_HANDLE;
-};
+// Create a node of a registered type from the assets it saved in a snapshot. Return null if the assets are not usable.
+using NodeFactory = Node* (*)(Scene& scene, AssetManager* asset_manager, const AssetId* assets, uint32_t asset_count);
 
 class Scene
 {
+    friend class Node;
     friend class PrimitiveNode;
 
   public:
-    Scene(AssetManager* asset_manager);
+    // Without an asset manager the scene has no render resources and can't be rendered (tools, benchmarks)
+    Scene(AssetManager* in_asset_manager);
+    ~Scene();
 
+    // Tick the node classes overriding Node::tick() phase by phase, as one fixed simulation step.
+    // Can run on a worker while the previous frame renders : nodes must not be added or removed from tick() or while it runs.
     void tick(const double delta_second);
+
+    // Frame boundary : make the state of the last simulation step visible to render_scene(). Must not run concurrently with tick().
+    // Called by the engine between the frames for the scenes with an asset manager.
+    void publish_render_records();
+
     void render_scene(RenderContext render_context);
 
-    template <typename Node_T, typename... Args_T> std::shared_ptr<Node_T> add_node(Args_T&&... arguments)
+    // Position of the rendered frame between the previous and the last simulation step, in [0, 1]
+    void set_interpolation_alpha(float alpha)
     {
-        Node_T* node_storage       = static_cast<Node_T*>(std::malloc(sizeof(Node_T)));
-        node_storage->render_scene = this;
+        interpolation_alpha = alpha;
+    }
+
+    // Nodes are stored in per class pools and owned by the scene : the returned pointer is valid until the node is removed
+    template <typename Node_T, typename... Args_T> Node_T* add_node(Args_T&&... arguments)
+    {
+        static_assert(std::is_base_of_v<Node, Node_T>, "scene nodes should inherit from Node");
+
+        const uint32_t pool_id = TNodePool<Node_T>::get_pool_id();
+        if (node_pools.size() <= pool_id)
+            node_pools.resize(pool_id + 1);
+        if (!node_pools[pool_id])
+            node_pools[pool_id] = std::make_unique<TNodePool<Node_T>>();
 
-        std::shared_ptr<Node_T> node_ptr(node_storage);
+        NodeHandle handle = {.pool_id = pool_id};
+        Node_T*    node   = static_cast<TNodePool<Node_T>*>(node_pools[pool_id].get())->allocate(handle.slot, handle.generation);
 
-        if (std::is_base_of<PrimitiveNode, Node_T>::value)
+        node->render_scene = this;
+        new (node) Node_T(std::forward<Args_T>(arguments)...);
+
+        if (!node->render_scene)
         {
-            rendered_nodes.emplace_back(std::dynamic_pointer_cast<PrimitiveNode>(node_ptr));
+            LOG_ERROR("don't call Node() constructor in children class : %s", typeid(Node_T).name());
         }
 
-        new (node_storage) Node_T(std::forward<Args_T>(arguments)...);
+        node->handle           = handle;
+        node->scene_node_index = static_cast<uint32_t>(scene_nodes.size());
+        scene_nodes.emplace_back(node);
 
-        if (!node_storage->render_scene)
+        if constexpr (std::is_base_of_v<PrimitiveNode, Node_T>)
         {
-            LOG_ERROR("don't call Node() constructor in children class : %s", typeid(Node_T).name());
+            node->rendered_node_index = static_cast<uint32_t>(rendered_nodes.size());
+            rendered_nodes.emplace_back(node);
+            register_render_record(node);
         }
 
-        scene_nodes.emplace_back(std::dynamic_pointer_cast<Node>(node_ptr));
+        if constexpr (has_tick_v<Node_T>)
+            register_tick(node, pool_id, Node_T::tick_phase);
+
+        return node;
+    }
+
+    /**
+     * Remove the node and its children from the scene in O(1) per node.
+     * Nodes stop being ticked and rendered immediately but are only destroyed once the frames in flight are done with them.
+     */
+    void remove_node(Node* node);
 
-        return node_ptr;
+    // Null if the node was removed
+    [[nodiscard]] Node* find_node(const NodeHandle& handle) const;
+
+    template <typename Node_T> [[nodiscard]] Node_T* find_node(const NodeHandle& handle) const
+    {
+        return dynamic_cast<Node_T*>(find_node(handle));
     }
 
-    void set_camera(std::shared_ptr<Camera> new_camera);
+    [[nodiscard]] size_t get_node_count() const
+    {
+        return scene_nodes.size();
+    }
+
+    void set_camera(Camera* new_camera);
 
     [[nodiscard]] TAssetPtr<ShaderBuffer> get_scene_uniform_buffer() const
     {
@@ -99,13 +136,219 @@ class Scene
         return global_model_ssbo;
     }
 
+    // Instance index to object index, read by the vertex shader
+    [[nodiscard]] TAssetPtr<ShaderBuffer> get_instance_ssbo() const
+    {
+        return global_instance_ssbo;
+    }
+
+    // Create the frustum culling compute pass. Draws then go through vkCmdDrawIndexedIndirectCount when gpu culling is enabled.
+    void init_gpu_culling(const TAssetPtr<Shader>& culling_shader);
+
+    void set_gpu_culling(bool b_enabled)
+    {
+        b_gpu_culling = b_enabled;
+    }
+
+    [[nodiscard]] bool is_gpu_culling_enabled() const
+    {
+        return b_gpu_culling;
+    }
+
+    // Draw the queue to depth only front to back before shading it : each visible pixel is shaded once. Fragment invocations are measured by Window::get_fragment_stats().
+    void set_depth_prepass(bool b_enabled)
+    {
+        b_depth_prepass = b_enabled;
+    }
+
+    [[nodiscard]] bool is_depth_prepass_enabled() const
+    {
+        return b_depth_prepass;
+    }
+
+    // Largest simplification error (in pixels) tolerated when selecting mesh lods
+    void set_lod_max_pixel_error(float max_pixel_error)
+    {
+        lod_max_pixel_error = max_pixel_error;
+    }
+
+    [[nodiscard]] float get_lod_max_pixel_error() const
+    {
+        return lod_max_pixel_error;
+    }
+
+    // Skip the objects hidden behind the largest meshes on screen, tested on the cpu before the draws are emitted
+    void set_occlusion_culling(bool b_enabled)
+    {
+        b_occlusion_culling = b_enabled;
+    }
+
+    [[nodiscard]] bool is_occlusion_culling_enabled() const
+    {
+        return b_occlusion_culling;
+    }
+
+    // Occlusion statistics of the last recorded frame
+    [[nodiscard]] const OcclusionStats& get_occlusion_stats() const
+    {
+        return occlusion_stats;
+    }
+
+    [[nodiscard]] const OcclusionBuffer& get_occlusion_buffer() const
+    {
+        return occlusion_buffer;
+    }
+
+    /**
+     * Create the cascaded shadow maps of the sun, rendered before the main pass from the shadow vertex shader.
+     * Materials receive the shadows by binding get_shadow_uniform_buffer() and sampling get_shadow_map_image_info().
+     */
+    void init_shadows(const TAssetPtr<Shader>& shadow_vertex_shader);
+
+    // Toward the sun
+    void set_sun_direction(const glm::vec3& direction);
+
+    // Null until init_shadows()
+    [[nodiscard]] TAssetPtr<ShaderBuffer> get_shadow_uniform_buffer() const;
+
+    // The cascades array with its depth comparison sampler
+    [[nodiscard]] VkDescriptorImageInfo get_shadow_map_image_info() const;
+
+    // Shadow statistics of the last recorded frame
+    [[nodiscard]] const ShadowStats& get_shadow_stats() const;
+
+    /**
+     * Attach a whole subtree in one pass, for importers. parents[i] is the index in nodes of the parent of nodes[i], lower than i, or UINT32_MAX to attach nodes[i] to root_parent (can be null).
+     * The nodes must be detached and without children : the batch is validated once and each world transform is computed once.
+     */
+    bool attach_hierarchy(const std::vector<Node*>& nodes, const std::vector<uint32_t>& parents, Node* root_parent = nullptr);
+
+    /**
+     * Make Node_T nodes savable in snapshots. type_name identifies the class in the files : it must not change once snapshots exist.
+     * Classes constructible without arguments don't need a factory.
+     */
+    template <typename Node_T> void register_node_type(std::string_view type_name, NodeFactory factory = nullptr)
+    {
+        static_assert(std::is_base_of_v<Node, Node_T>, "scene nodes should inherit from Node");
+        if constexpr (std::is_default_constructible_v<Node_T>)
+        {
+            if (!factory)
+                factory = [](Scene& scene, AssetManager*, const AssetId*, uint32_t) -> Node* { return scene.add_node<Node_T>(); };
+        }
+        if (!factory)
+        {
+            LOG_ERROR("node type %s needs a factory", std::string(type_name).c_str());
+            return;
+        }
+
+        const uint32_t pool_id = TNodePool<Node_T>::get_pool_id();
+        if (node_types.size() <= pool_id)
+            node_types.resize(pool_id + 1);
+        node_types[pool_id] = {.type = scene_snapshot::hash_type_name(type_name), .factory = factory};
+        node_factories[node_types[pool_id].type] = factory;
+    }
+
+    // Save the hierarchy, relative transforms and asset references of every node. Nodes of unregistered types are saved as Node.
+    bool save_snapshot(const std::filesystem::path& file_path) const;
+
+    // Add the nodes of a snapshot to the scene and return its root nodes. The referenced assets must already exist.
+    std::vector<Node*> load_snapshot(const std::filesystem::path& file_path);
+
+    // Raycasts and overlap queries against the scene meshes, up to date with the start of the current simulation step.
+    // Safe to query from tick() and between the frames, not while the scene publishes.
+    [[nodiscard]] const SpatialIndex& get_spatial_index() const
+    {
+        return spatial_index;
+    }
+
     [[nodiscard]] glm::dmat4 make_projection_matrix(const RenderContext& render_context) const;
 
+    // Statistics of the last recorded frame
+    [[nodiscard]] const RenderQueueStats& get_render_stats() const
+    {
+        return render_queue.get_stats();
+    }
+
   private:
+    [[nodiscard]] bool is_gpu_culling_available(const RenderContext& render_context) const;
+    void               dispatch_gpu_culling(const RenderContext& render_context, const glm::mat4& view_projection);
+
+    // Select the records covering the most screen space and rasterize them in the occlusion buffer
+    void rasterize_occluders(const glm::mat4& view_projection, const glm::vec3& camera_location);
+
+    AssetManager*           asset_manager         = nullptr;
     TAssetPtr<ShaderBuffer> camera_uniform_buffer = nullptr;
     TAssetPtr<ShaderBuffer> global_model_ssbo = nullptr;
-    std::shared_ptr<Camera>  enabled_camera        = nullptr;
+    TAssetPtr<ShaderBuffer> global_instance_ssbo  = nullptr;
+    Camera*                 enabled_camera        = nullptr;
+
+    float lod_max_pixel_error = 1.f;
+    float interpolation_alpha = 1.f;
+    bool  b_depth_prepass     = false;
+
+    bool                       b_gpu_culling          = true;
+    TAssetPtr<ComputeMaterial> culling_material       = nullptr;
+    TAssetPtr<ShaderBuffer>    culling_uniform_buffer = nullptr;
+    TAssetPtr<ShaderBuffer>    cull_object_ssbo       = nullptr;
+    TAssetPtr<ShaderBuffer>    draw_command_ssbo      = nullptr;
+    TAssetPtr<ShaderBuffer>    draw_count_ssbo        = nullptr;
+
+    bool            b_occlusion_culling = true;
+    OcclusionBuffer occlusion_buffer;
+    OcclusionStats  occlusion_stats = {};
+
+    std::unique_ptr<ShadowRenderer> shadow_renderer = nullptr;
+
+    // Nodes of a class overriding tick(), ordered by hierarchy level : nodes of a level are independent and ticked in parallel
+    struct TickBatch
+    {
+        ETickPhase          phase      = ETickPhase::PrePhysics;
+        std::vector<Node*>  nodes      = {};
+        std::vector<Node*>  scheduled  = {};
+        std::vector<size_t> level_ends = {};
+        bool                b_dirty    = true;
+    };
+
+    void register_render_record(PrimitiveNode* primitive);
+    void update_render_records();
+
+    // Register the records of the primitives whose assets finished loading
+    void register_loaded_primitives();
+
+    void register_tick(Node* node, uint32_t pool_id, ETickPhase phase);
+    void schedule_tick_batch(TickBatch& batch, uint32_t pool_id);
+
+    // Destroy the nodes removed before the oldest frame in flight
+    void destroy_removed_nodes(bool b_force);
+
+    struct RemovedNode
+    {
+        NodeHandle handle;
+        uint64_t   frame = 0;
+    };
+
+    std::vector<std::unique_ptr<NodePoolBase>> node_pools;
+    std::vector<Node*>                         scene_nodes;
+    std::vector<PrimitiveNode*>                rendered_nodes;
+    std::vector<RemovedNode>                   removed_nodes;
+    std::vector<NodeHandle>                    loading_primitives; // Waiting for their assets to be resident before being registered
+    uint64_t                                   frame_index = 0;
+
+    std::vector<TickBatch> tick_batches           = {}; // Indexed by node pool id
+    bool                   b_tick_hierarchy_dirty = false;
+
+    RenderProxy           render_proxy = {};
+    std::vector<uint32_t> render_lods  = {}; // Selected lod per proxy id, kept between frames for the hysteresis
+    RenderQueue           render_queue = {};
+
+    SpatialIndex spatial_index = {}; // Instances are indexed by render proxy id
+
+    struct NodeType
+    {
+        uint64_t    type    = 0;
+        NodeFactory factory = nullptr;
+    };
 
-    std::vector<std::shared_ptr<Node>>          scene_nodes;
-    std::vector<std::shared_ptr<PrimitiveNode>> rendered_nodes;
+    std::vector<NodeType>                     node_types     = {}; // Indexed by node pool id
+    std::unordered_map<uint64_t, NodeFactory> node_factories = {}; // Indexed by type name hash
 };
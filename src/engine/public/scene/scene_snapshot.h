@@ -0,0 +1,51 @@
+#pragma once
+
+#include <cstdint>
+#include <string_view>
+
+/**
+ * Binary scene snapshot layout. Everything is little endian plain data, so a mapped snapshot is read in place.
+ * Nodes are stored parents first : rebuilding the hierarchy and the world transforms is a single linear pass.
+ * Bump version whenever a record changes, older snapshots are rejected.
+ */
+namespace scene_snapshot
+{
+inline constexpr uint32_t magic   = 0x50414E53; // "SNAP"
+inline constexpr uint32_t version = 2;
+
+struct Header
+{
+    uint32_t magic        = scene_snapshot::magic;
+    uint32_t version      = scene_snapshot::version;
+    uint32_t node_count   = 0;
+    uint32_t asset_count  = 0;
+    uint64_t nodes_offset = 0; // NodeRecord[node_count]
+    uint64_t asset_offset = 0; // uint64_t asset ids[asset_count]
+};
+
+struct NodeRecord
+{
+    uint64_t type        = 0;          // Hash of the registered node type name
+    uint32_t parent      = UINT32_MAX; // Index of an earlier record, UINT32_MAX for roots
+    uint32_t first_asset = 0;
+    uint32_t asset_count = 0;
+    uint32_t padding     = 0;
+    double   position[3] = {};
+    double   rotation[4] = {}; // w, x, y, z
+    double   scale[3]    = {};
+};
+
+static_assert(sizeof(Header) % 8 == 0 && sizeof(NodeRecord) % 8 == 0, "snapshot records must keep the 8 bytes alignment of the mapping");
+
+// FNV-1a : stable across compilers and runs, unlike std::hash
+constexpr uint64_t hash_type_name(std::string_view type_name)
+{
+    uint64_t hash = 0xcbf29ce484222325;
+    for (const char c : type_name)
+    {
+        hash ^= static_cast<uint8_t>(c);
+        hash *= 0x100000001b3;
+    }
+    return hash;
+}
+} // namespace scene_snapshot
@@ -0,0 +1,138 @@
+#pragma once
+
+#include "assets/asset_ptr.h"
+#include "scene/render_proxy.h"
+
+#include <glm/glm.hpp>
+#include <memory>
+#include <vector>
+#include <vulkan/vulkan_core.h>
+
+class AssetManager;
+class MeshData;
+class Shader;
+class ShaderBuffer;
+class ShadowMap;
+class ShadowMaterial;
+struct RenderContext;
+
+// Read by the shadow pass and by the materials sampling the shadow map (std140)
+struct ShadowData
+{
+    glm::mat4 cascade_view_projection[4] = {};
+    glm::vec4 cascade_splits             = glm::vec4(0);          // View depth where each cascade ends
+    glm::vec4 sun_direction              = glm::vec4(0, 0, 1, 0); // xyz : toward the sun
+    uint32_t  cascade_count              = 0;
+    uint32_t  padding[3]                 = {};
+};
+
+struct ShadowStats
+{
+    size_t cascades_rendered = 0;
+    size_t casters           = 0; // Instances drawn in the rendered cascades
+    size_t draws             = 0;
+};
+
+// Camera the cascades are fitted to
+struct ShadowView
+{
+    glm::vec3 location        = glm::vec3(0);
+    glm::vec3 forward         = glm::vec3(1, 0, 0);
+    glm::vec3 right           = glm::vec3(0, 1, 0);
+    glm::vec3 up              = glm::vec3(0, 0, 1);
+    float     tan_half_fov    = 1.f; // Vertical
+    float     aspect_ratio    = 1.f;
+    float     near_clip_plane = 0.1f;
+    float     far_clip_plane  = 1000.f;
+};
+
+/**
+ * Sun shadows as cascaded shadow maps : the view frustum is split in depth ranges, each covered by an orthographic cascade.
+ * Cascades are fitted around the bounding sphere of their range with a margin and snapped to their texels : they are only refitted
+ * once the camera moved past the margin, and only rendered again when refitted or when a caster inside them changed.
+ * Casters are culled per cascade with their bounding sphere, then each cascade is recorded on a worker in its own secondary command buffer.
+ */
+class ShadowRenderer
+{
+  public:
+    static constexpr uint32_t max_cascades = 4;
+
+    ShadowRenderer(AssetManager* asset_manager, const TAssetPtr<Shader>& vertex_shader, const TAssetPtr<ShaderBuffer>& camera_uniform_buffer, const TAssetPtr<ShaderBuffer>& model_ssbo);
+    ~ShadowRenderer();
+
+    // Toward the sun
+    void set_sun_direction(const glm::vec3& direction);
+
+    [[nodiscard]] const glm::vec3& get_sun_direction() const
+    {
+        return sun_direction;
+    }
+
+    // Record i changed since the last frame : the cascades overlapping its old or new bounds are rendered again
+    void mark_record_changed(size_t record_index, const RenderRecord& record);
+
+    // Refit the cascades to the view and record the passes of the dirty ones in the primary command buffer. Must be called outside of a render pass.
+    void render(const RenderContext& render_context, const RenderProxy& render_proxy, const std::vector<uint32_t>& render_lods, const ShadowView& view);
+
+    [[nodiscard]] TAssetPtr<ShaderBuffer> get_uniform_buffer() const
+    {
+        return shadow_uniform_buffer;
+    }
+
+    // Cascades array, sampled with depth comparison
+    [[nodiscard]] const VkDescriptorImageInfo& get_shadow_map_image_info() const;
+
+    [[nodiscard]] const ShadowStats& get_stats() const
+    {
+        return stats;
+    }
+
+  private:
+    struct Cascade
+    {
+        glm::vec3 center          = glm::vec3(0); // Snapped to the texel grid
+        float     radius          = 0.f;          // Margin included, 0 until fitted
+        float     depth_range     = 0.f;
+        glm::mat4 view_projection = glm::mat4(1.0);
+        bool      b_dirty         = true;
+    };
+
+    // Consecutive casters sharing mesh and lod
+    struct ShadowBatch
+    {
+        MeshData* mesh           = nullptr;
+        uint32_t  lod            = 0;
+        uint32_t  first_instance = 0;
+        uint32_t  instance_count = 0;
+    };
+
+    // World bounding spheres of a record at its two last simulation steps, where its shadow is drawn between
+    struct CasterBounds
+    {
+        glm::vec4 sphere          = glm::vec4(0);
+        glm::vec4 previous_sphere = glm::vec4(0);
+        bool      b_moving        = false;
+    };
+
+    void fit_cascades(const ShadowView& view);
+
+    // Mark the cascades overlapping these bounds to be rendered again
+    void mark_dirty(const CasterBounds& bounds);
+
+    [[nodiscard]] bool overlaps(const Cascade& cascade, const CasterBounds& bounds) const;
+
+    std::unique_ptr<ShadowMap> shadow_map;
+    TAssetPtr<ShadowMaterial>  shadow_material        = nullptr;
+    TAssetPtr<ShaderBuffer>    shadow_uniform_buffer  = nullptr;
+    TAssetPtr<ShaderBuffer>    shadow_instance_buffer = nullptr;
+
+    glm::vec3                 sun_direction = glm::normalize(glm::vec3(-1, 1, 1));
+    ShadowData                shadow_data   = {};
+    std::vector<Cascade>      cascades      = {};
+    std::vector<CasterBounds> caster_bounds = {}; // Per record, as they were last rendered
+    bool                      b_all_dirty   = true;
+
+    std::vector<std::vector<ShadowBatch>> cascade_batches = {};
+    std::vector<uint32_t>                 instance_ids    = {}; // Cascade c uses [c * record count, (c + 1) * record count[
+    ShadowStats                           stats           = {};
+};
@@ -0,0 +1,74 @@
+#pragma once
+
+#include "scene/bvh.h"
+#include "scene/node_pool.h"
+
+#include <cstdint>
+#include <glm/glm.hpp>
+#include <vector>
+
+struct RayHit
+{
+    NodeHandle node     = {};
+    uint32_t   triangle = UINT32_MAX;
+    float      distance = FLT_MAX; // In ray direction length units
+    glm::vec3  position = glm::vec3(0);
+    glm::vec3  normal   = glm::vec3(0); // World space, unit length
+
+    [[nodiscard]] bool is_valid() const
+    {
+        return node.is_valid();
+    }
+};
+
+/**
+ * Ray and box queries against the triangles of the scene meshes.
+ * Each mesh owns a local space triangle bvh (bottom level), the index is a bvh over the world bounds of the mesh instances (top level).
+ * Moving instances only refits the top level, which is rebuilt when instances are added or removed or when the refitted tree degraded too much.
+ * Queries are const and can run concurrently, but not while instances are modified or update() runs.
+ */
+class SpatialIndex
+{
+  public:
+    // Add or move the instance id (ids are reused and should stay dense)
+    void set_instance(uint32_t id, NodeHandle node, const MeshBvh* mesh, const glm::mat4& transform);
+    void remove_instance(uint32_t id);
+
+    // Apply the pending instance modifications to the top level bvh
+    void update();
+
+    // Nearest hit along the ray. Return false if nothing was hit.
+    bool raycast(const Ray& ray, RayHit& out_hit) const;
+
+    // Append the nodes having a triangle whose bounds overlap the box
+    void overlap_box(const Aabb& box, std::vector<NodeHandle>& out_nodes) const;
+
+    // Run independent queries in parallel on the job system
+    void raycast_batch(const std::vector<Ray>& rays, std::vector<RayHit>& out_hits) const;
+    void overlap_box_batch(const std::vector<Aabb>& boxes, std::vector<std::vector<NodeHandle>>& out_nodes) const;
+
+    [[nodiscard]] size_t get_instance_count() const
+    {
+        return instance_ids.size();
+    }
+
+  private:
+    // A refitted tree more than this ratio more expensive than when it was built is rebuilt
+    static constexpr float max_refit_cost_ratio = 2.f;
+
+    struct Instance
+    {
+        NodeHandle     node           = {};
+        const MeshBvh* mesh           = nullptr; // Null if the id is free
+        glm::mat4      local_to_world = glm::mat4(1.0);
+        glm::mat4      world_to_local = glm::mat4(1.0);
+    };
+
+    std::vector<Instance> instances       = {}; // Indexed by id
+    std::vector<uint32_t> instance_ids    = {}; // Top level primitive to instance id
+    std::vector<Aabb>     instance_bounds = {}; // Top level primitive world bounds
+    Bvh                   top_level       = {};
+    float                 built_cost      = 0.f;
+    bool                  b_rebuild       = false;
+    bool                  b_refit         = false;
+};
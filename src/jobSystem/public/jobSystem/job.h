@@ -79,11 +79,15 @@ class IJobTask
 
     void wait()
     {
-        while (auto task = children_pool.pop())
+        // Only workers help executing the children : the main thread has no current task to restore
+        if (Worker::get())
         {
-            Worker::get()->current_task = task;
-            task->execute();
-            Worker::get()->current_task = task->parent_task;
+            while (auto task = children_pool.pop())
+            {
+                Worker::get()->current_task = task;
+                task->execute();
+                Worker::get()->current_task = task->parent_task;
+            }
         }
         completion_lock.wait();
         child_lock.wait();
@@ -2,6 +2,7 @@
 
 #include "job.h"
 #include "worker.h"
+#include <algorithm>
 #include <memory>
 
 namespace job_system
@@ -38,4 +39,50 @@ inline void wait_children()
         }
     }
 }
+
+/**
+ * Call func(index) for each index in [0, count[.
+ * The range is split in batches of batch_size executed on workers, the first batch is executed on the calling thread.
+ * Blocks until every batch is complete.
+ */
+template <class Lambda> void parallel_for(const size_t count, Lambda&& func, const size_t batch_size = 64)
+{
+    if (count <= batch_size || Worker::get_worker_count() == 0)
+    {
+        for (size_t i = 0; i < count; ++i)
+            func(i);
+        return;
+    }
+
+    std::vector<std::shared_ptr<IJobTask>> batches;
+    batches.reserve(count / batch_size);
+    for (size_t begin = batch_size; begin < count; begin += batch_size)
+    {
+        const size_t end = std::min(begin + batch_size, count);
+        batches.emplace_back(new_job([&func, begin, end] {
+            for (size_t i = begin; i < end; ++i)
+                func(i);
+        }));
+    }
+
+    for (size_t i = 0; i < batch_size; ++i)
+        func(i);
+
+    // When called from a worker, batches are children of the current task : execute the ones nobody stole yet
+    if (auto* worker = Worker::get())
+    {
+        if (auto task = worker->get_current_task())
+        {
+            while (auto child = task->steal_task())
+            {
+                worker->current_task = child;
+                child->execute();
+                worker->current_task = child->parent_task;
+            }
+        }
+    }
+
+    for (const auto& batch : batches)
+        batch->wait();
+}
 } // namespace job_system
@@ -0,0 +1,75 @@
+#include "cpputils/logger.hpp"
+#include "scene/node_base.h"
+#include "scene/scene.h"
+
+#include <chrono>
+#include <random>
+
+static constexpr uint32_t node_count = 50000;
+
+// Parent index of each node : a random wide tree, or a single chain as deep as the node count
+static std::vector<uint32_t> make_parents(bool b_chain)
+{
+    std::mt19937          random(42);
+    std::vector<uint32_t> parents(node_count, UINT32_MAX);
+    for (uint32_t i = 1; i < node_count; ++i)
+        parents[i] = b_chain ? i - 1 : std::uniform_int_distribution<uint32_t>(0, i - 1)(random);
+    return parents;
+}
+
+static std::vector<Node*> add_nodes(Scene& scene)
+{
+    std::vector<Node*> nodes(node_count);
+    for (uint32_t i = 0; i < node_count; ++i)
+    {
+        nodes[i] = scene.add_node<Node>();
+        nodes[i]->set_relative_transform(glm::dvec3(1, 0, 0), glm::dquat(), glm::dvec3(1));
+    }
+    return nodes;
+}
+
+template <typename Lambda_T> static double measure_ms(Lambda_T&& lambda)
+{
+    const auto start = std::chrono::steady_clock::now();
+    lambda();
+    return std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+}
+
+static void run(const char* name, bool b_chain)
+{
+    const std::vector<uint32_t> parents = make_parents(b_chain);
+
+    // One attach_to() per node, in the order an importer creates them
+    {
+        Scene              scene(nullptr);
+        std::vector<Node*> nodes = add_nodes(scene);
+
+        const double attach_ms = measure_ms([&] {
+            for (uint32_t i = 1; i < node_count; ++i)
+                nodes[i]->attach_to(nodes[parents[i]]);
+        });
+        const double move_ms = measure_ms([&] { nodes[0]->set_relative_position(glm::dvec3(0, 1, 0)); });
+        LOG_INFO("%s : attach_to %.2f ms, moving the root %.2f ms, deepest node at depth %u", name, attach_ms, move_ms, nodes[node_count - 1]->get_depth());
+    }
+
+    // The whole hierarchy at once
+    {
+        Scene              scene(nullptr);
+        std::vector<Node*> nodes = add_nodes(scene);
+
+        bool         b_attached = false;
+        const double attach_ms  = measure_ms([&] { b_attached = scene.attach_hierarchy(nodes, parents); });
+        if (!b_attached)
+            LOG_FATAL("%s : attach_hierarchy failed", name);
+        LOG_INFO("%s : attach_hierarchy %.2f ms", name, attach_ms);
+    }
+}
+
+int main(int argc, char* argv[])
+{
+    Logger::get().enable_logs(Logger::LOG_LEVEL_TRACE | Logger::LOG_LEVEL_DEBUG | Logger::LOG_LEVEL_INFO);
+
+    LOG_INFO("hierarchy of %u nodes", node_count);
+    run("random tree", false);
+    run("chain", true);
+}
@@ -6,7 +6,7 @@
 #include "scene/node_camera.h"
 
 
-CameraBasicController::CameraBasicController(const std::shared_ptr<Camera>& in_camera, InputManager* input_manager) : controlled_camera(in_camera)
+CameraBasicController::CameraBasicController(Camera* in_camera, InputManager* input_manager) : controlled_camera(in_camera)
 {
     input_manager->add_input(InputAction("camera_move_forward", {keyboard::key_w}));
     input_manager->add_input(InputAction("camera_move_backward", {keyboard::key_s}));
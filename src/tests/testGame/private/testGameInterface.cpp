@@ -24,27 +24,37 @@ void TestGameInterface::load_resources()
 {
     root_scene = std::make_unique<Scene>(get_asset_manager());
 
+    // Unreferenced meshes stay cached until they exceed this budget
+    get_asset_manager()->set_budget<MeshData>({.gpu_bytes = 512ull * 1024 * 1024});
+
 
     // Create shaders
     const TAssetPtr<Shader> vertex_shader   = get_asset_manager()->create<Shader>("test_vertex_shader", "data/test.vs.glsl", EShaderStage::VertexShader);
     const TAssetPtr<Shader> fragment_shader = get_asset_manager()->create<Shader>("test_fragment_shader", "data/test.fs.glsl", EShaderStage::FragmentShader);
 
+    // Cascaded sun shadows, sampled by the material
+    root_scene->init_shadows(get_asset_manager()->create<Shader>("shadow_vertex_shader", "data/shadow.vs.glsl", EShaderStage::VertexShader));
+
     // create material parameters
     const ShaderStageData vertex_stage{
         .shader         = vertex_shader,
         .uniform_buffer  = {root_scene->get_scene_uniform_buffer()},
-        .storage_buffers = {root_scene->get_model_ssbo()},
+        .storage_buffers = {root_scene->get_model_ssbo(), root_scene->get_instance_ssbo()},
     };
     const ShaderStageData fragment_stage{
         .shader         = fragment_shader,
-        .uniform_buffer = {root_scene->get_scene_uniform_buffer()},
+        .uniform_buffer = {root_scene->get_scene_uniform_buffer(), root_scene->get_shadow_uniform_buffer()},
+        .sampled_images = {SampledImage{.name = "shadowMap", .image_info = root_scene->get_shadow_map_image_info()}},
     };
 
-    // create material
-    const TAssetPtr<Material> material = get_asset_manager()->create<Material>("test_material", vertex_stage, fragment_stage);
+    // create material : referenced for the lifetime of the game, the meshes importing it only hold its id until they resolve it
+    test_material = get_asset_manager()->create<Material>("test_material", vertex_stage, fragment_stage);
+
+    // Frustum culling on the gpu
+    root_scene->init_gpu_culling(get_asset_manager()->create<Shader>("gpu_culling_compute_shader", "data/culling.cs.glsl", EShaderStage::ComputeShader));
 
 
-    auto camera = root_scene->add_node<Camera>();
+    camera = root_scene->add_node<Camera>();
 
     root_scene->set_camera(camera);
 
@@ -65,14 +75,16 @@ void TestGameInterface::pre_shutdown()
 
 void TestGameInterface::unload_resources()
 {
+    // The scene references its assets : it must be destroyed before the asset manager
+    controller    = nullptr;
+    camera        = nullptr;
+    root_scene    = nullptr;
+    test_material.clear();
 }
 
 void TestGameInterface::render_scene(RenderContext render_context)
 {
-    if (auto mat = TAssetPtr<Material>(get_asset_manager(), "test_material"))
-        mat->update_descriptor_sets(render_context.image_index);
-    else
-        LOG_ERROR("default material is not valid");
+    root_scene->set_interpolation_alpha(static_cast<float>(get_simulation_alpha()));
     root_scene->render_scene(render_context);
 }
 
@@ -94,9 +106,31 @@ void TestGameInterface::render_ui()
                 new ProfilerWindow(this, "profiler");
             if (ImGui::MenuItem("content browser"))
                 new ContentBrowser(this, "content browser");
+            if (ImGui::MenuItem("gpu culling", nullptr, root_scene->is_gpu_culling_enabled()))
+                root_scene->set_gpu_culling(!root_scene->is_gpu_culling_enabled());
+            if (ImGui::MenuItem("occlusion culling", nullptr, root_scene->is_occlusion_culling_enabled()))
+                root_scene->set_occlusion_culling(!root_scene->is_occlusion_culling_enabled());
+            if (ImGui::MenuItem("depth pre-pass", nullptr, root_scene->is_depth_prepass_enabled()))
+                root_scene->set_depth_prepass(!root_scene->is_depth_prepass_enabled());
+            if (ImGui::MenuItem("save scene snapshot"))
+                b_save_snapshot = true;
+            if (ImGui::MenuItem("load scene snapshot"))
+                b_load_snapshot = true;
             ImGui::EndMenu();
         }
         ImGui::Text("%lf fps", 1.0 / get_delta_second());
+        ImGui::Text("simulation steps : %u (alpha %.2lf)", get_simulation_steps(), get_simulation_alpha());
+        const RenderQueueStats& render_stats = root_scene->get_render_stats();
+        ImGui::Text("draws : %zu (saved %zu) | binds : %zu (saved %zu) | triangles : %zu", render_stats.draws, render_stats.draws_saved, render_stats.binds, render_stats.binds_saved, render_stats.triangles);
+        const OcclusionStats& occlusion_stats = root_scene->get_occlusion_stats();
+        ImGui::Text("occluders : %zu (%zu triangles) | occluded : %zu", occlusion_stats.occluders, occlusion_stats.occluder_triangles, occlusion_stats.occluded);
+        const FragmentStats& fragment_stats = get_window()->get_fragment_stats();
+        if (fragment_stats.b_available)
+            ImGui::Text("fragments : %llu | with pre-pass : %llu | without : %llu", static_cast<unsigned long long>(fragment_stats.invocations), static_cast<unsigned long long>(fragment_stats.invocations_with_prepass),
+                        static_cast<unsigned long long>(fragment_stats.invocations_without_prepass));
+        const ShadowStats& shadow_stats = root_scene->get_shadow_stats();
+        ImGui::Text("shadow cascades rendered : %zu | casters : %zu | draws : %zu", shadow_stats.cascades_rendered, shadow_stats.casters, shadow_stats.draws);
+        ImGui::Text("ground : %.2f", ground_distance);
         ImGui::EndMainMenuBar();
     }
 }
@@ -107,8 +141,21 @@ void TestGameInterface::render_hud()
 
 void TestGameInterface::pre_draw()
 {
-    root_scene->tick(0);
-    TAssetPtr<Material> material(get_asset_manager(), "test_material");
+    if (b_save_snapshot)
+        root_scene->save_snapshot("data/sponza.snapshot");
+    if (b_load_snapshot)
+        root_scene->load_snapshot("data/sponza.snapshot");
+    b_save_snapshot = false;
+    b_load_snapshot = false;
+
+    // The spatial index can't be queried while the simulation runs
+    RayHit hit;
+    ground_distance = root_scene->get_spatial_index().raycast(Ray{.origin = glm::vec3(camera->get_world_position()), .direction = glm::vec3(0, 0, -1)}, hit) ? hit.distance : -1.f;
+}
+
+void TestGameInterface::simulation_tick(double fixed_delta_second)
+{
+    root_scene->tick(fixed_delta_second);
 }
 
 void TestGameInterface::post_draw()
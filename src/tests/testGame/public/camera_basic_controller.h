@@ -8,10 +8,10 @@ class Camera;
 class CameraBasicController
 {
   public:
-    CameraBasicController(const std::shared_ptr<Camera>& in_camera, InputManager* input_manager);
+    CameraBasicController(Camera* in_camera, InputManager* input_manager);
 
   private:
-    std::shared_ptr<Camera> controlled_camera;
+    Camera* controlled_camera = nullptr;
     double                  movement_speed = 1000.0;
 
     double pitch = 0.0;
@@ -1,4 +1,5 @@
 #pragma once
+#include "assets/asset_material.h"
 #include "camera_basic_controller.h"
 #include "engine_interface.h"
 #include "scene/scene.h"
@@ -17,6 +18,7 @@ protected:
     void render_ui() override;
     void render_hud() override;
     void pre_draw() override;
+    void simulation_tick(double fixed_delta_second) override;
     void post_draw() override;
 
     std::unique_ptr<Scene> root_scene;
@@ -24,5 +26,12 @@ protected:
 private:
 
     std::unique_ptr<CameraBasicController> controller;
+    Camera*                                camera          = nullptr;
+    TAssetPtr<Material>                    test_material   = {};
+    float                                  ground_distance = -1.f; // Below the camera, negative if there is no ground
+
+    // Scene snapshots are saved and loaded between the frames, when the simulation is not running
+    bool b_save_snapshot = false;
+    bool b_load_snapshot = false;
 };
 